@@ -0,0 +1,435 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncLogger.h"
+#include "GlobalState.h"
+#include "logging.h"
+#include <cstring>
+#include <cstdio>
+#include <inttypes.h> // PRI stuff
+#include <sched.h> // sched_yield
+#include <unistd.h> // write, isatty
+
+namespace libtas {
+
+AsyncLogger::Slot AsyncLogger::slots[AsyncLogger::nb_slots];
+std::atomic<size_t> AsyncLogger::write_pos(0);
+size_t AsyncLogger::read_pos = 0;
+std::atomic_flag AsyncLogger::write_lock = ATOMIC_FLAG_INIT;
+pthread_t AsyncLogger::writer_thread;
+sem_t AsyncLogger::pending;
+std::atomic<bool> AsyncLogger::running(false);
+
+void AsyncLogger::start()
+{
+    if (running.load(std::memory_order_relaxed))
+        return;
+
+    static bool inited = false;
+    if (!inited) {
+        for (size_t i = 0; i < nb_slots; i++)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+        sem_init(&pending, 0, 0);
+        NATIVECALL(pthread_atfork(nullptr, nullptr, atforkChild));
+        inited = true;
+    }
+
+    running = true;
+    int ret;
+    NATIVECALL(ret = pthread_create(&writer_thread, nullptr, writerLoop, nullptr));
+    if (ret != 0)
+        running = false;
+}
+
+void AsyncLogger::stop()
+{
+    if (running.exchange(false)) {
+        sem_post(&pending);
+        NATIVECALL(pthread_join(writer_thread, nullptr));
+    }
+
+    write(nullptr, 0);
+}
+
+bool AsyncLogger::push(const LogHeader& header, const char* fmt, va_list args)
+{
+    if (!running.load(std::memory_order_acquire))
+        return false;
+
+    /* Reserve a slot */
+    size_t pos = write_pos.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots[pos % nb_slots];
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+        ptrdiff_t dif = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+        if (dif == 0) {
+            if (write_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0) {
+            /* Queue is full */
+            return false;
+        }
+        else {
+            pos = write_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->header = header;
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    bool stored = storeArgs(*slot, fmt, args_copy);
+    va_end(args_copy);
+
+    /* The slot is already reserved, so we must still release it. An empty
+     * slot is skipped by the writer */
+    slot->fmt = stored ? fmt : nullptr;
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    /* Safe to call from a signal handler */
+    sem_post(&pending);
+    return stored;
+}
+
+bool AsyncLogger::storeArgs(Slot& slot, const char* fmt, va_list args)
+{
+    int nbargs = 0;
+    int strpos = 0;
+
+    for (const char* c = fmt; *c; c++) {
+        if (*c != '%')
+            continue;
+
+        c++;
+        if (*c == '%')
+            continue;
+
+        /* Flags */
+        while (*c && strchr("-+ #0'", *c))
+            c++;
+
+        /* Width and precision, which may be given as arguments */
+        for (int part = 0; part < 2; part++) {
+            if (*c == '*') {
+                if (nbargs == max_args)
+                    return false;
+                slot.types[nbargs] = ARG_INT;
+                slot.args[nbargs++].i = va_arg(args, int);
+                c++;
+            }
+            else {
+                while (*c >= '0' && *c <= '9')
+                    c++;
+            }
+            if ((part == 0) && (*c == '.'))
+                c++;
+            else
+                break;
+        }
+
+        /* Length modifier */
+        ArgType type = ARG_INT;
+        bool ldouble = false;
+        switch (*c) {
+            case 'h':
+                c++;
+                if (*c == 'h') c++;
+                break;
+            case 'l':
+                c++;
+                type = ARG_LONG;
+                if (*c == 'l') {
+                    c++;
+                    type = ARG_LLONG;
+                }
+                break;
+            case 'q':
+                c++;
+                type = ARG_LLONG;
+                break;
+            case 'j':
+                c++;
+                type = ARG_INTMAX;
+                break;
+            case 'z':
+                c++;
+                type = ARG_SIZE;
+                break;
+            case 't':
+                c++;
+                type = ARG_PTRDIFF;
+                break;
+            case 'L':
+                c++;
+                ldouble = true;
+                break;
+        }
+
+        if (nbargs == max_args)
+            return false;
+
+        Arg& arg = slot.args[nbargs];
+        switch (*c) {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+                switch (type) {
+                    case ARG_LONG: arg.i = va_arg(args, long); break;
+                    case ARG_LLONG: arg.i = va_arg(args, long long); break;
+                    case ARG_INTMAX: arg.i = va_arg(args, intmax_t); break;
+                    case ARG_SIZE: arg.i = va_arg(args, size_t); break;
+                    case ARG_PTRDIFF: arg.i = va_arg(args, ptrdiff_t); break;
+                    default: arg.i = va_arg(args, int); break;
+                }
+                break;
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                if (ldouble) {
+                    type = ARG_LDOUBLE;
+                    arg.ld = va_arg(args, long double);
+                }
+                else {
+                    type = ARG_DOUBLE;
+                    arg.d = va_arg(args, double);
+                }
+                break;
+            case 'p':
+                type = ARG_PTR;
+                arg.p = va_arg(args, const void*);
+                break;
+            case 's': {
+                if (type != ARG_INT)
+                    return false;
+                type = ARG_STR;
+
+                /* The string may not exist anymore when the message is
+                 * formatted, so we copy it */
+                const char* str = va_arg(args, const char*);
+                if (!str) {
+                    arg.str = -1;
+                    break;
+                }
+                size_t len = strlen(str);
+                if (strpos + len + 1 > static_cast<size_t>(strings_size))
+                    return false;
+                memcpy(slot.strings + strpos, str, len + 1);
+                arg.str = strpos;
+                strpos += len + 1;
+                break;
+            }
+            default:
+                /* Conversions such as %n or %m must be done by the caller */
+                return false;
+        }
+
+        slot.types[nbargs++] = type;
+    }
+
+    return true;
+}
+
+int AsyncLogger::formatHeader(char* s, int maxsize, const LogHeader& header)
+{
+    /* We only print colors if displayed on a terminal */
+    static int isTerm = -1;
+    if (isTerm == -1)
+        isTerm = isatty(/*cerr*/ 2);
+
+    const char* color = "";
+    if (isTerm) {
+        if (header.lcf & LCF_ERROR)
+            /* Write the header text in red */
+            color = ANSI_COLOR_RED;
+        else if (header.lcf & LCF_WARNING)
+            /* Write the header text in light red */
+            color = ANSI_COLOR_LIGHT_RED;
+        else
+            /* Write the header text in white */
+            color = ANSI_COLOR_LIGHT_GRAY;
+    }
+
+    int size = snprintf(s, maxsize, "%s[libTAS f:%" PRIu64 "] Thread %d %s %s%s",
+        color, header.framecount, header.tid, header.thread,
+        isTerm?ANSI_COLOR_RESET:"", (header.lcf & LCF_ERROR)?"ERROR: ":"");
+
+    if (size < 0)
+        return 0;
+    return (size < maxsize) ? size : maxsize - 1;
+}
+
+/* Print one conversion with its stored width and precision arguments */
+template<typename T>
+static int formatArg(char* s, int maxsize, const char* spec, const int* stars, int nbstars, T value)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+    switch (nbstars) {
+        case 0:
+            return snprintf(s, maxsize, spec, value);
+        case 1:
+            return snprintf(s, maxsize, spec, stars[0], value);
+        default:
+            return snprintf(s, maxsize, spec, stars[0], stars[1], value);
+    }
+#pragma GCC diagnostic pop
+}
+
+int AsyncLogger::formatSlot(const Slot& slot, char* s)
+{
+    /* Keep room for the line return */
+    const int maxsize = max_size - 1;
+    int size = formatHeader(s, maxsize, slot.header);
+
+    /* Print each conversion separately, using the stored arguments */
+    char spec[32];
+    int argi = 0;
+    const char* c = slot.fmt;
+    while (*c && (size < maxsize - 1)) {
+        if (*c != '%') {
+            s[size++] = *c++;
+            continue;
+        }
+        if (c[1] == '%') {
+            s[size++] = '%';
+            c += 2;
+            continue;
+        }
+
+        /* Conversion specification, which was already checked when storing */
+        const char* end = c + 1;
+        while (!strchr("diouxXceEfFgGaAps", *end))
+            end++;
+        int speclen = end - c + 1;
+        if (speclen >= static_cast<int>(sizeof(spec)))
+            break;
+        memcpy(spec, c, speclen);
+        spec[speclen] = '\0';
+        c = end + 1;
+
+        int stars[2];
+        int nbstars = 0;
+        for (int i = 1; i < speclen; i++)
+            if (spec[i] == '*')
+                stars[nbstars++] = slot.args[argi++].i;
+
+        const Arg& arg = slot.args[argi];
+        int len = 0;
+        switch (slot.types[argi]) {
+            case ARG_INT: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, static_cast<int>(arg.i)); break;
+            case ARG_LONG: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, static_cast<long>(arg.i)); break;
+            case ARG_LLONG: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, arg.i); break;
+            case ARG_INTMAX: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, static_cast<intmax_t>(arg.i)); break;
+            case ARG_SIZE: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, static_cast<size_t>(arg.i)); break;
+            case ARG_PTRDIFF: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, static_cast<ptrdiff_t>(arg.i)); break;
+            case ARG_DOUBLE: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, arg.d); break;
+            case ARG_LDOUBLE: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, arg.ld); break;
+            case ARG_PTR: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, arg.p); break;
+            case ARG_STR: len = formatArg(s + size, maxsize - size, spec, stars, nbstars, (arg.str < 0) ? nullptr : slot.strings + arg.str); break;
+        }
+        argi++;
+
+        if (len < 0)
+            len = 0;
+        size += len;
+        if (size > maxsize - 1)
+            size = maxsize - 1;
+    }
+
+    s[size++] = '\n';
+    return size;
+}
+
+bool AsyncLogger::pop()
+{
+    Slot& slot = slots[read_pos % nb_slots];
+    if (slot.seq.load(std::memory_order_acquire) != read_pos + 1) {
+        /* Queue is empty, or the next message is still being written */
+        return false;
+    }
+
+    /* Messages that could not be stored are written by their caller */
+    if (slot.fmt) {
+        char s[max_size];
+        int size = formatSlot(slot, s);
+        ::write(2, s, size);
+    }
+
+    slot.seq.store(read_pos + nb_slots, std::memory_order_release);
+    read_pos++;
+    return true;
+}
+
+void AsyncLogger::write(const char* msg, int len)
+{
+    /* If we interrupted our own thread while writing (from a signal
+     * handler), we cannot wait for the lock */
+    static thread_local bool writing = false;
+    if (writing) {
+        if (msg)
+            ::write(2, msg, len);
+        return;
+    }
+
+    /* The lock may be held by a thread that was suspended for a savestate,
+     * so we don't wait forever and print the message anyway */
+    bool locked = false;
+    for (int i = 0; i < 1000; i++) {
+        if (!write_lock.test_and_set(std::memory_order_acquire)) {
+            locked = true;
+            break;
+        }
+        NATIVECALL(sched_yield());
+    }
+
+    if (!locked) {
+        if (msg)
+            ::write(2, msg, len);
+        return;
+    }
+
+    writing = true;
+
+    while (pop()) {}
+    if (msg)
+        ::write(2, msg, len);
+
+    writing = false;
+    write_lock.clear(std::memory_order_release);
+}
+
+void AsyncLogger::atforkChild()
+{
+    /* The writer thread does not exist in the forked process */
+    running = false;
+    write_lock.clear();
+}
+
+void* AsyncLogger::writerLoop(void* arg)
+{
+    /* This thread is not known by the game, so all our calls must be native */
+    GlobalNative gn;
+
+    while (running.load(std::memory_order_acquire)) {
+        sem_wait(&pending);
+        write(nullptr, 0);
+    }
+
+    return nullptr;
+}
+
+}
@@ -0,0 +1,160 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_ASYNCLOGGER_H_INCL
+#define LIBTAS_ASYNCLOGGER_H_INCL
+
+#include "../shared/lcf.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdarg>
+#include <cstdint>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/types.h>
+
+namespace libtas {
+/* Context of a log message, taken by the calling thread */
+struct LogHeader {
+    LogCategoryFlag lcf;
+    uint64_t framecount;
+    pid_t tid;
+
+    /* Kind of thread, must be a string literal */
+    const char* thread;
+};
+
+/* Writer of log messages on a separate thread, so that formatting messages
+ * and printing them to a terminal does not slow down the game when verbose
+ * logging is enabled.
+ *
+ * The calling thread only copies the format pointer and the raw arguments
+ * (and the content of string arguments) into a bounded lock-free queue of
+ * fixed-size slots, which does not allocate or lock, so it can be used from
+ * signal handlers and during checkpointing. Messages are formatted by the
+ * writer thread. When the writer thread is not running, the queue is full
+ * or the message cannot be stored, the caller formats and writes the
+ * message itself.
+ */
+class AsyncLogger
+{
+    public:
+        /* Start the writer thread if it is not running. Must be called
+         * from a context where creating a thread is safe */
+        static void start();
+
+        /* Write all queued messages and stop the writer thread. This must
+         * be done before savestates, because the thread is not known by
+         * the thread manager */
+        static void stop();
+
+        /* Queue a message to be formatted later. The format must be a
+         * string literal, because only its pointer is stored.
+         * @return false if the message was not queued
+         */
+        static bool push(const LogHeader& header, const char* fmt, va_list args);
+
+        /* Write a message immediately from the calling thread, after all
+         * queued messages */
+        static void write(const char* msg, int len);
+
+        /* Print the header of a log message.
+         * @return the length of the header
+         */
+        static int formatHeader(char* s, int maxsize, const LogHeader& header);
+
+        /* Maximum size of a formatted message */
+        static const int max_size = 2048;
+
+    private:
+        static const int max_args = 16;
+        static const int strings_size = 1024;
+        static const size_t nb_slots = 128;
+
+        /* Type of each stored argument, to pass it back to snprintf */
+        enum ArgType : uint8_t {
+            ARG_INT,
+            ARG_LONG,
+            ARG_LLONG,
+            ARG_INTMAX,
+            ARG_SIZE,
+            ARG_PTRDIFF,
+            ARG_DOUBLE,
+            ARG_LDOUBLE,
+            ARG_PTR,
+            ARG_STR,
+        };
+
+        union Arg {
+            long long i;
+            double d;
+            long double ld;
+            const void* p;
+
+            /* Offset of a string inside the slot, or -1 for nullptr */
+            int str;
+        };
+
+        struct Slot {
+            /* Position in the queue that this slot is ready for: `pos` to
+             * be written, `pos+1` to be read */
+            std::atomic<size_t> seq;
+            LogHeader header;
+            const char* fmt;
+            Arg args[max_args];
+            ArgType types[max_args];
+
+            /* Content of string arguments */
+            char strings[strings_size];
+        };
+
+        static Slot slots[nb_slots];
+        static std::atomic<size_t> write_pos;
+        static size_t read_pos;
+
+        /* Only one thread at a time writes messages, so that messages of
+         * each thread are printed in order */
+        static std::atomic_flag write_lock;
+
+        /* Store the arguments of a message into a slot.
+         * @return false if some arguments are not supported, or do not fit
+         */
+        static bool storeArgs(Slot& slot, const char* fmt, va_list args);
+
+        /* Format a queued message, with its header and line return.
+         * @return the length of the message
+         */
+        static int formatSlot(const Slot& slot, char* s);
+
+        /* Write the next queued message, must be called with the lock.
+         * @return false if there is none
+         */
+        static bool pop();
+
+        static void* writerLoop(void* arg);
+
+        static void atforkChild();
+
+        static pthread_t writer_thread;
+        static sem_t pending;
+        static std::atomic<bool> running;
+};
+}
+
+#endif
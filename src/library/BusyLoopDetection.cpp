@@ -34,6 +34,11 @@
 #include <sstream>
 #include <string.h>
 #include <stdint.h>
+#include <algorithm> // std::upper_bound
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "GlobalState.h"
 #include "checkpoint/ProcSelfMaps.h"
 #include "checkpoint/ProcMapsArea.h"
@@ -76,6 +81,205 @@ void BusyLoopDetection::toHash(intptr_t addr)
     hash = hash * 33 + addr;
 }
 
+/* Contribution of a stack frame to the hash, and its description for the
+ * time trace. Hashing a frame is equivalent to `hash = hash * mul + add` */
+struct FrameSymbol {
+    uint64_t mul = 1;
+    uint64_t add = 0;
+    std::string trace;
+
+    void toHash(const char* string)
+    {
+        for (const char* c = string; *c != '\0'; c++) {
+            mul *= 33;
+            add = add * 33 + *c;
+        }
+    }
+
+    void toHash(intptr_t addr)
+    {
+        mul *= 33;
+        add = add * 33 + addr;
+    }
+};
+
+/* Symbolization of each return address, so that `dladdr()` is only called
+ * once per address. Containers are built on first use, because libraries
+ * may be loaded before our static constructors are run */
+static std::unordered_map<void*, FrameSymbol>& getSymbolCache() {
+    static std::unordered_map<void*, FrameSymbol> symbol_cache;
+    return symbol_cache;
+}
+
+/* Snapshot of the memory mappings, sorted by address, used for addresses that
+ * do not belong to any library */
+static std::vector<std::pair<void*, void*>>& getMemoryAreas() {
+    static std::vector<std::pair<void*, void*>> memory_areas;
+    return memory_areas;
+}
+static bool memory_areas_valid = false;
+
+/* Set when a library is loaded, from any thread. The caches are only
+ * cleared by the main thread, which is the only one using them */
+static std::atomic<bool> symbols_dirty(false);
+
+/* Hashes of the stack traces that were already sent to the program */
+static std::unordered_set<uint64_t>& getSentTraces() {
+    static std::unordered_set<uint64_t> sent_traces;
+    return sent_traces;
+}
+
+/* Number of time calls of each call site during the current frame */
+struct TraceCount {
+    int type;
+    uint32_t count;
+    std::string trace; // stack trace, only if never sent before
+};
+static std::unordered_map<uint64_t, TraceCount>& getFrameTraces() {
+    static std::unordered_map<uint64_t, TraceCount> frame_traces;
+    return frame_traces;
+}
+
+static void refreshMemoryAreas()
+{
+    auto& memory_areas = getMemoryAreas();
+    memory_areas.clear();
+    ProcSelfMaps procSelfMaps;
+    Area area;
+    while (procSelfMaps.getNextArea(&area))
+        memory_areas.emplace_back(area.addr, area.endAddr);
+    memory_areas_valid = true;
+}
+
+/* Return the start of the memory mapping containing an address, or nullptr */
+static void* findMemoryArea(void* address)
+{
+    bool refreshed = false;
+    if (!memory_areas_valid) {
+        refreshMemoryAreas();
+        refreshed = true;
+    }
+
+    const auto& memory_areas = getMemoryAreas();
+    while (true) {
+        auto it = std::upper_bound(memory_areas.begin(), memory_areas.end(), address,
+            [](void* addr, const std::pair<void*, void*>& area) {return addr < area.first;});
+        if ((it != memory_areas.begin()) && (address < (--it)->second))
+            return it->first;
+
+        /* The address may belong to a new mapping */
+        if (refreshed)
+            return nullptr;
+        refreshMemoryAreas();
+        refreshed = true;
+    }
+}
+
+static const FrameSymbol& symbolize(void* address, const char* ld_path)
+{
+    auto& symbol_cache = getSymbolCache();
+    auto it = symbol_cache.find(address);
+    if (it != symbol_cache.end())
+        return it->second;
+
+    FrameSymbol& sym = symbol_cache[address];
+
+    /* We don't need the whole `backtrace_symbols()` feature, only some information,
+     * so this is a simplified implementation of this function. */
+    std::ostringstream oss;
+
+    Dl_info info;
+    int status = dladdr(address, &info);
+    if (status && info.dli_fname != NULL && info.dli_fname[0] != '\0') {
+        /* Check if the program or library is provided by the game,
+         * using the content of LD_LIBRARY_PATH
+         */
+        bool isGameLibrary = false;
+        /* Putting executable base addresses directly, because I'm lazy... */
+        if (info.dli_fbase == (void*)0x400000 || info.dli_fbase == (void*)0x8048000)
+            isGameLibrary = true;
+        else if (ld_path) {
+            isGameLibrary = strstr(info.dli_fname, ld_path);
+        }
+
+        if (isGameLibrary) {
+            /* Hash the file name */
+            const char* filename = strrchr(info.dli_fname, '/');
+            sym.toHash(filename? ++filename : info.dli_fname);
+
+            /* Hash the address offset */
+            if (info.dli_fbase && (address >= info.dli_fbase))
+                sym.toHash(reinterpret_cast<intptr_t>(address) - reinterpret_cast<intptr_t>(info.dli_fbase));
+        }
+        else {
+            /* We should be safe to push the function called inside the library.
+             * everything else may change (even library name) */
+            if (info.dli_sname != NULL) {
+                sym.toHash(info.dli_sname);
+            }
+        }
+
+        /* Building stack trace string */
+        oss << info.dli_fname;
+
+        if (info.dli_sname == NULL)
+            info.dli_saddr = info.dli_fbase;
+
+        if (info.dli_sname != NULL || info.dli_saddr != 0) {
+            oss << "(" << (info.dli_sname ? info.dli_sname : "");
+            if (info.dli_saddr != 0) {
+                if (address >= (void *)info.dli_saddr) {
+                    oss << '+' << std::hex << (reinterpret_cast<intptr_t>(address) - reinterpret_cast<intptr_t>(info.dli_saddr));
+                }
+                else {
+                    oss << '-' << std::hex << (reinterpret_cast<intptr_t>(info.dli_saddr) - reinterpret_cast<intptr_t>(address));
+                }
+            }
+            oss << ")";
+        }
+        oss << " ";
+    }
+    else {
+        /* Executed code comes from some anonymous mapping, which is often
+         * the sign of JIT execution. For now, we trust that the code always
+         * has the same offset from the beginning of the mapped section. */
+        void* area_addr = findMemoryArea(address);
+        if (area_addr)
+            sym.toHash(reinterpret_cast<intptr_t>(address) - reinterpret_cast<intptr_t>(area_addr));
+    }
+    oss << "[" << address << "]\n";
+    sym.trace = oss.str();
+
+    return sym;
+}
+
+void BusyLoopDetection::invalidateSymbols()
+{
+    symbols_dirty.store(true, std::memory_order_relaxed);
+}
+
+void BusyLoopDetection::sendTraces(uint64_t frame)
+{
+    /* Frames without any time call are also sent, so that they can be
+     * compared with other runs of the same frame */
+    auto& frame_traces = getFrameTraces();
+    if (!shared_config.time_trace && frame_traces.empty())
+        return;
+
+    sendMessage(MSGB_GETTIME_TRACES);
+    sendData(&frame, sizeof(uint64_t));
+    int size = frame_traces.size();
+    sendData(&size, sizeof(int));
+    for (auto& ft : frame_traces) {
+        sendData(&ft.second.type, sizeof(int));
+        sendData(&ft.first, sizeof(uint64_t));
+        sendData(&ft.second.count, sizeof(uint32_t));
+        sendString(ft.second.trace);
+    }
+
+    frame_traces.clear();
+}
+
 void BusyLoopDetection::increment(int type)
 {
     if (!shared_config.busyloop_detection && !shared_config.time_trace)
@@ -91,6 +295,12 @@ void BusyLoopDetection::increment(int type)
 
     GlobalState::setNative(true);
 
+    /* A library was loaded, so cached symbols may be wrong */
+    if (symbols_dirty.exchange(false, std::memory_order_relaxed)) {
+        getSymbolCache().clear();
+        memory_areas_valid = false;
+    }
+
     resetHash();
 
     toHash(static_cast<intptr_t>(type));
@@ -101,8 +311,10 @@ void BusyLoopDetection::increment(int type)
     /* Get the ld_library_path content */
     /* The env name was modified in libTAS init function */
     static char* ld_path = nullptr;
+    static bool ld_path_init = false;
 
-    if (ld_path == nullptr) {
+    if (!ld_path_init) {
+        ld_path_init = true;
         const char* ld = "DD_LIBRARY_PATH=";
         for (int i=0; environ[i]; i++) {
             if (strstr(environ[i], ld) == environ[i]) {
@@ -115,92 +327,25 @@ void BusyLoopDetection::increment(int type)
         }
     }
 
-    /* We don't need the whole `backtrace_symbols()` feature, only some information,
-     * so this is a simplified implementation of this function. */
-    std::ostringstream oss;
-
     /* Start the stack at frame 3 to skip this, DeterministicTimer::getTicks() and gettime() */
+    const FrameSymbol* symbols[MAX_STACK_SIZE];
     for (int cnt = 3; cnt < n; ++cnt) {
-        Dl_info info;
-        int status = dladdr(addresses[cnt], &info);
-        if (status && info.dli_fname != NULL && info.dli_fname[0] != '\0') {
-            /* Check if the program or library is provided by the game,
-             * using the content of LD_LIBRARY_PATH
-             */
-            bool isGameLibrary = false;
-            /* Putting executable base addresses directly, because I'm lazy... */
-            if (info.dli_fbase == (void*)0x400000 || info.dli_fbase == (void*)0x8048000)
-                isGameLibrary = true;
-            else if (ld_path) {
-                isGameLibrary = strstr(info.dli_fname, ld_path);
-            }
-
-            if (isGameLibrary) {
-                /* Hash the file name */
-                const char* filename = strrchr(info.dli_fname, '/');
-                toHash(filename? ++filename : info.dli_fname);
-
-                /* Hash the address offset */
-                if (info.dli_fbase && (addresses[cnt] >= info.dli_fbase))
-                    toHash(reinterpret_cast<intptr_t>(addresses[cnt]) - reinterpret_cast<intptr_t>(info.dli_fbase));
-            }
-            else {
-                /* We should be safe to push the function called inside the library.
-                 * everything else may change (even library name) */
-                if (info.dli_sname != NULL) {
-                    toHash(info.dli_sname);
-                }
-            }
-
-            /* Building stack trace string */
-            if (shared_config.time_trace) {
-                oss << info.dli_fname;
-
-                if (info.dli_sname == NULL)
-                    info.dli_saddr = info.dli_fbase;
-
-                if (info.dli_sname != NULL || info.dli_saddr != 0) {
-                    oss << "(" << (info.dli_sname ? info.dli_sname : "");
-                    if (info.dli_saddr != 0) {
-                        if (addresses[cnt] >= (void *)info.dli_saddr) {
-                            oss << '+' << std::hex << (reinterpret_cast<intptr_t>(addresses[cnt]) - reinterpret_cast<intptr_t>(info.dli_saddr));
-                        }
-                        else {
-                            oss << '-' << std::hex << (reinterpret_cast<intptr_t>(info.dli_saddr) - reinterpret_cast<intptr_t>(addresses[cnt]));
-                        }
-                    }
-                    oss << ")";
-                }
-                oss << " ";
-            }
-        }
-        else {
-            /* Executed code comes from some anonymous mapping, which is often
-             * the sign of JIT execution. For now, we trust that the code always
-             * has the same offset from the beginning of the mapped section. */
-
-            /* Find the corresponding memory area */
-            ProcSelfMaps procSelfMaps;
-            Area area;
-            while (procSelfMaps.getNextArea(&area)) {
-                if ((addresses[cnt] >= area.addr) && (addresses[cnt] < area.endAddr)) {
-                    toHash(reinterpret_cast<intptr_t>(addresses[cnt]) - reinterpret_cast<intptr_t>(area.addr));
-                    break;
-                }
-            }
-        }
-        if (shared_config.time_trace) {
-            oss << "[" << addresses[cnt] << "]\n";
-        }
+        symbols[cnt] = &symbolize(addresses[cnt], ld_path);
+        hash = hash * symbols[cnt]->mul + symbols[cnt]->add;
     }
 
     if (shared_config.time_trace) {
-        lockSocket();
-        sendMessage(MSGB_GETTIME_BACKTRACE);
-        sendData(&type, sizeof(int));
-        sendData(&hash, sizeof(uint64_t));
-        sendString(oss.str());
-        unlockSocket();
+        /* Count the call, the program receives all counts at the end of the
+         * frame. Only send the stack trace the first time, the program
+         * already knows the stack trace of a hash that was sent before */
+        TraceCount& tc = getFrameTraces()[hash];
+        if (tc.count++ == 0) {
+            tc.type = type;
+            if (getSentTraces().insert(hash).second) {
+                for (int cnt = 3; cnt < n; ++cnt)
+                    tc.trace += symbols[cnt]->trace;
+            }
+        }
     }
     GlobalState::setNative(false);
 
@@ -34,9 +34,18 @@ void toHash(const char* string);
 
 void toHash(intptr_t addr);
 
+/* Discard cached symbols and memory mappings, called when a library is
+ * loaded. This can be called from any thread, the caches are cleared by the
+ * main thread on the next time call */
+void invalidateSymbols();
+
 /* Update the state after a time call was made */
 void increment(int type);
 
+/* Send the number of time calls of each call site during the last frame.
+ * Must be called with the socket locked */
+void sendTraces(uint64_t frame);
+
 }
 }
 
@@ -0,0 +1,113 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_EVENTRING_H_INCL
+#define LIBTAS_EVENTRING_H_INCL
+
+#include <bitset>
+#include <climits>
+#include <cstddef>
+
+namespace libtas {
+/* Fixed-capacity queue of events, stored inline in a circular array, used
+ * by our replacements of the SDL, Xlib and xcb event queues. Events are
+ * ordered from the oldest (index 0) to the most recent.
+ *
+ * N must be a power of two.
+ */
+template<typename T, size_t N>
+class EventRing
+{
+    static_assert((N & (N - 1)) == 0, "EventRing capacity must be a power of two");
+
+    public:
+        size_t size() const {return tail - head;}
+        bool empty() const {return tail == head;}
+        bool full() const {return size() == N;}
+
+        /* Access the i-th oldest event */
+        T& operator[](size_t i) {return slots[(head + i) & (N - 1)];}
+        const T& operator[](size_t i) const {return slots[(head + i) & (N - 1)];}
+
+        /* Insert an event at the end of the queue.
+         * @return false if the queue is full
+         */
+        bool push(const T& event)
+        {
+            if (full())
+                return false;
+            slots[tail++ & (N - 1)] = event;
+            return true;
+        }
+
+        /* Remove the oldest event */
+        void pop() {head++;}
+
+        void clear() {head = tail = 0;}
+
+        /* Remove the events, from the oldest, for which remove(event) returns
+         * true, up to a maximum number of events, and keep the order of the
+         * other events. Remaining events are moved towards the end of the
+         * queue, so that removing the oldest events does not copy anything.
+         * @return the number of removed events
+         */
+        template<typename Predicate>
+        int removeIf(Predicate remove, int max = INT_MAX)
+        {
+            std::bitset<N> removed;
+            int count = 0;
+            size_t last = 0;
+            size_t s = size();
+
+            for (size_t i = 0; (i < s) && (count < max); i++) {
+                if (remove((*this)[i])) {
+                    removed.set(i);
+                    count++;
+                    last = i;
+                }
+            }
+
+            if (count == 0)
+                return 0;
+
+            /* Compact the events before the last removed one */
+            size_t w = last + 1;
+            for (size_t i = last + 1; i-- > 0;) {
+                if (!removed.test(i)) {
+                    w--;
+                    if (w != i)
+                        (*this)[w] = (*this)[i];
+                }
+            }
+            head += w;
+
+            return count;
+        }
+
+    private:
+        T slots[N];
+
+        /* Total number of events inserted and removed */
+        size_t head = 0;
+        size_t tail = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FrameProfiler.h"
+#include "GlobalState.h"
+#include "logging.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace libtas {
+
+static bool checked = false;
+static int profile_fd = -1;
+
+/* Are we inside a measured frame boundary */
+static bool active = false;
+
+static struct timespec begin_time;
+static struct timespec last_time;
+static int64_t phase_times[FrameProfiler::NB_PHASES];
+
+static int64_t elapsed(const struct timespec& from, const struct timespec& to)
+{
+    return (to.tv_sec - from.tv_sec) * 1000000000LL + (to.tv_nsec - from.tv_nsec);
+}
+
+void FrameProfiler::start()
+{
+    if (!checked) {
+        checked = true;
+
+        const char* path;
+        NATIVECALL(path = getenv("LIBTAS_PROFILE_FILE"));
+        if (path && path[0]) {
+            NATIVECALL(profile_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+            if (profile_fd < 0) {
+                debuglogstdio(LCF_ERROR, "Could not open profile file %s", path);
+            }
+            else {
+                static const char header[] = "frame,sync,timer,audio,socket,savestate,capture,hud,encode,draw,events,total\n";
+                ssize_t ret;
+                NATIVECALL(ret = write(profile_fd, header, sizeof(header) - 1));
+                (void) ret;
+            }
+        }
+    }
+
+    if (profile_fd < 0)
+        return;
+
+    active = true;
+    for (int p = 0; p < NB_PHASES; p++)
+        phase_times[p] = 0;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &begin_time));
+    last_time = begin_time;
+}
+
+void FrameProfiler::mark(Phase phase)
+{
+    if (!active)
+        return;
+
+    struct timespec current_time;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &current_time));
+    phase_times[phase] += elapsed(last_time, current_time);
+    last_time = current_time;
+}
+
+void FrameProfiler::end(uint64_t framecount)
+{
+    if (!active)
+        return;
+    active = false;
+
+    struct timespec current_time;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &current_time));
+
+    char line[512];
+    int len = snprintf(line, sizeof(line), "%llu", static_cast<unsigned long long>(framecount));
+    for (int p = 0; p < NB_PHASES; p++)
+        len += snprintf(line + len, sizeof(line) - len, ",%lld", static_cast<long long>(phase_times[p]));
+    len += snprintf(line + len, sizeof(line) - len, ",%lld\n", static_cast<long long>(elapsed(begin_time, current_time)));
+
+    ssize_t ret;
+    NATIVECALL(ret = write(profile_fd, line, len));
+    (void) ret;
+}
+
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_FRAMEPROFILER_H_INCL
+#define LIBTAS_FRAMEPROFILER_H_INCL
+
+#include <cstdint>
+
+namespace libtas {
+/* Measure the time spent in each phase of the frame boundary, so that the
+ * overhead of libTAS can be tracked separately from the work of the game.
+ *
+ * Profiling is enabled by setting the LIBTAS_PROFILE_FILE environment
+ * variable to the path of a file, in which timings of each frame boundary
+ * are written in CSV format, in nanoseconds.
+ */
+namespace FrameProfiler
+{
+    enum Phase {
+        SYNC, // waiting for the game threads and events
+        TIMER, // deterministic timer, including sleeping
+        AUDIO, // audio mixing
+        SOCKET, // exchanging messages with the program
+        SAVESTATE, // saving states
+        CAPTURE, // saving and restoring the screen
+        HUD, // drawing the HUD
+        ENCODE, // encoding audio and video
+        DRAW, // the draw command of the game
+        EVENTS, // generating input events
+        NB_PHASES
+    };
+
+    /* Start measuring a frame boundary */
+    void start();
+
+    /* Add the time since the previous mark to a phase */
+    void mark(Phase phase);
+
+    /* Write the timings of the frame boundary */
+    void end(uint64_t framecount);
+}
+}
+
+#endif
@@ -31,6 +31,8 @@
 
 #include <SDL2/SDL.h>
 #include <vector>
+#include <memory> // std::shared_ptr
+#include <functional> // std::function
 #include <cstring> // memcpy
 #define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
@@ -86,6 +88,12 @@ DECLARE_ORIG_POINTER(glDisable)
 DECLARE_ORIG_POINTER(glIsEnabled)
 DECLARE_ORIG_POINTER(glGetIntegerv)
 DECLARE_ORIG_POINTER(glGetError)
+DECLARE_ORIG_POINTER(glGenBuffers)
+DECLARE_ORIG_POINTER(glBindBuffer)
+DECLARE_ORIG_POINTER(glBufferData)
+DECLARE_ORIG_POINTER(glMapBufferRange)
+DECLARE_ORIG_POINTER(glUnmapBuffer)
+DECLARE_ORIG_POINTER(glDeleteBuffers)
 DECLARE_ORIG_POINTER(VdpOutputSurfaceGetParameters)
 DECLARE_ORIG_POINTER(VdpOutputSurfaceCreate)
 DECLARE_ORIG_POINTER(VdpOutputSurfaceDestroy)
@@ -116,11 +124,17 @@ DEFINE_ORIG_POINTER(XGetGeometry)
 
 static bool inited = false;
 
-/* Stored pixel array for use with the video encoder */
+/* Stored pixel array, used as the screen surface for XShm */
 static std::vector<uint8_t> winpixels;
 
-/* Single line of pixels to swap GL array that has different reference point */
-static std::vector<uint8_t> gllinepixels;
+/* Pool of pixel buffers for frames that are copied from the backend, so that
+ * consumers can keep a frame without copying it, and without allocating a
+ * new buffer each frame */
+#define FRAME_POOL_SIZE 4
+static std::vector<std::vector<uint8_t>*> framepool;
+
+/* Last captured frame, returned on non-draw frames */
+static std::shared_ptr<ScreenCapture::Frame> lastFrame;
 
 /* Video dimensions */
 static int width, height, pitch;
@@ -133,6 +147,16 @@ static GLuint screenFBO = 0;
 /* OpenGL render buffer */
 static GLuint screenRBO = 0;
 
+/* Ring of OpenGL pixel buffers for asynchronous transfers of the screen. A
+ * transfer is queued at one frame and mapped at a later frame, so that the
+ * CPU does not wait for the GPU to finish rendering. */
+#define PBO_RING_SIZE 3
+static GLuint screenPBOs[PBO_RING_SIZE] = {0};
+
+/* Index of the oldest queued transfer, and number of queued transfers */
+static int pboReadIndex = 0;
+static int pboQueued = 0;
+
 /* SDL1 screen surface */
 static SDL1::SDL_Surface* screenSDL1Surf = nullptr;
 
@@ -336,7 +360,31 @@ void ScreenCapture::initScreenSurface()
         if ((error = orig::glGetError()) != GL_NO_ERROR)
             debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBindFramebuffer failed with error %d", error);
 
-        gllinepixels.resize(pitch);
+        /* Generate the pixel buffers used for asynchronous transfers */
+        LINK_NAMESPACE(glGenBuffers, "GL");
+        LINK_NAMESPACE(glBindBuffer, "GL");
+        LINK_NAMESPACE(glBufferData, "GL");
+
+        GLint pack_buffer;
+        orig::glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pack_buffer);
+
+        if (screenPBOs[0] == 0) {
+            orig::glGenBuffers(PBO_RING_SIZE, screenPBOs);
+            if ((error = orig::glGetError()) != GL_NO_ERROR)
+                debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glGenBuffers failed with error %d", error);
+        }
+
+        for (int i=0; i<PBO_RING_SIZE; i++) {
+            orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, screenPBOs[i]);
+            orig::glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+            if ((error = orig::glGetError()) != GL_NO_ERROR)
+                debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBufferData failed with error %d", error);
+        }
+
+        orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffer);
+
+        pboReadIndex = 0;
+        pboQueued = 0;
     }
 
     else if (game_info.video & GameInfo::SDL1) {
@@ -399,10 +447,109 @@ void ScreenCapture::initScreenSurface()
 }
 
 
+/* Take a buffer from the pool, or allocate a new one */
+static std::vector<uint8_t>* takePoolBuffer()
+{
+    if (framepool.empty())
+        return new std::vector<uint8_t>(size);
+
+    std::vector<uint8_t>* buf = framepool.back();
+    framepool.pop_back();
+    return buf;
+}
+
+ScreenCapture::Frame::~Frame()
+{
+    if (release)
+        release();
+
+    /* The buffer goes back to the pool, unless the screen was resized in
+     * between */
+    if (buffer) {
+        if ((buffer->size() == size) && (framepool.size() < FRAME_POOL_SIZE))
+            framepool.push_back(buffer);
+        else
+            delete buffer;
+    }
+}
+
+/* Build a frame whose pixels will be copied into a pool buffer */
+static std::shared_ptr<ScreenCapture::Frame> allocPoolFrame()
+{
+    std::shared_ptr<ScreenCapture::Frame> frame = std::make_shared<ScreenCapture::Frame>();
+    frame->buffer = takePoolBuffer();
+    frame->pixels = frame->buffer->data();
+    return frame;
+}
+
+/* Build a frame that directly references memory from the backend, which is
+ * released by `release` if not empty. If the memory does not have the
+ * expected pitch, the pixels are copied into a pool buffer instead. */
+static std::shared_ptr<ScreenCapture::Frame> makeBackendFrame(uint8_t* data, int data_pitch, std::function<void()> release)
+{
+    if (data_pitch == pitch) {
+        std::shared_ptr<ScreenCapture::Frame> frame = std::make_shared<ScreenCapture::Frame>();
+        frame->pixels = data;
+        frame->release = release;
+        return frame;
+    }
+
+    std::shared_ptr<ScreenCapture::Frame> frame = allocPoolFrame();
+    for (int line = 0; line < height; line++) {
+        memcpy(frame->pixels + line*pitch, data + line*data_pitch, pitch);
+    }
+    if (release)
+        release();
+    return frame;
+}
+
+/* Stop referencing the backend memory from the last frame, before this
+ * memory is written or copied. If the frame is still needed, by a consumer
+ * or by us if `keep` is set, its pixels are first copied into a pool buffer. */
+static void detachLastFrame(bool keep)
+{
+    if (!lastFrame || lastFrame->buffer)
+        return;
+
+    if (!keep && (lastFrame.use_count() == 1)) {
+        lastFrame.reset();
+        return;
+    }
+
+    lastFrame->buffer = takePoolBuffer();
+    memcpy(lastFrame->buffer->data(), lastFrame->pixels, size);
+    lastFrame->pixels = lastFrame->buffer->data();
+
+    if (lastFrame->release) {
+        lastFrame->release();
+        lastFrame->release = nullptr;
+    }
+}
+
+/* Return the last captured frame */
+static std::shared_ptr<ScreenCapture::Frame> getLastFrame()
+{
+    if (lastFrame)
+        return lastFrame;
+
+    /* No frame was captured yet, return our zero-filled array */
+    std::shared_ptr<ScreenCapture::Frame> frame = std::make_shared<ScreenCapture::Frame>();
+    frame->pixels = winpixels.data();
+    return frame;
+}
+
+static void clearFramePool()
+{
+    lastFrame.reset();
+    for (auto buf : framepool)
+        delete buf;
+    framepool.clear();
+}
+
 void ScreenCapture::fini()
 {
     winpixels.clear();
-    gllinepixels.clear();
+    clearFramePool();
 
     destroyScreenSurface();
 
@@ -422,6 +569,14 @@ void ScreenCapture::destroyScreenSurface()
         orig::glDeleteRenderbuffers(1, &screenRBO);
         screenRBO = 0;
     }
+    if (screenPBOs[0] != 0) {
+        LINK_NAMESPACE(glDeleteBuffers, "GL");
+        orig::glDeleteBuffers(PBO_RING_SIZE, screenPBOs);
+        for (int i=0; i<PBO_RING_SIZE; i++)
+            screenPBOs[i] = 0;
+    }
+    /* Any queued transfer is lost */
+    pboQueued = 0;
 
     /* Delete the SDL1 screen surface */
     if (screenSDL1Surf) {
@@ -478,6 +633,15 @@ void ScreenCapture::resize(int w, int h)
         return;
     }
 
+    /* Close the current dump before destroying the surfaces, so that frames
+     * still being transferred are flushed with the old dimensions */
+    if (avencoder) {
+        avencoder.reset(nullptr);
+    }
+
+    /* The last frame may reference the surfaces */
+    clearFramePool();
+
     destroyScreenSurface();
 
     width = w;
@@ -489,7 +653,7 @@ void ScreenCapture::resize(int w, int h)
 
     initScreenSurface();
 
-    /* We need to close the dumping if needed, and open a new one */
+    /* We need to open a new dump if needed */
     if (shared_config.av_dumping) {
         avencoder.reset(new AVEncoder());
     }
@@ -512,6 +676,11 @@ int ScreenCapture::getSize()
     return size;
 }
 
+int ScreenCapture::getPixelSize()
+{
+    return pixelSize;
+}
+
 const char* ScreenCapture::getPixelFormat()
 {
     MYASSERT(inited)
@@ -630,6 +799,9 @@ int ScreenCapture::copyScreenToSurface()
 
     GlobalNative gn;
 
+    /* Our surface is about to be overwritten */
+    detachLastFrame(false);
+
     if (game_info.video & GameInfo::VDPAU) {
         /* Copy to our screen surface */
         VdpStatus status = orig::VdpOutputSurfaceRenderOutputSurface(screenVDPAUSurf, nullptr, vdp::vdpSurface, nullptr, nullptr, nullptr, 0);
@@ -708,7 +880,10 @@ int ScreenCapture::copyScreenToSurface()
         if ((error = orig::glGetError()) != GL_NO_ERROR)
             debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBindFramebuffer failed with error %d", error);
 
-        orig::glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        /* Flip the image vertically during the blit, because OpenGL has a
+         * different reference point. The stored surface is top to bottom,
+         * so that pixels can be read without any processing. */
+        orig::glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
         if ((error = orig::glGetError()) != GL_NO_ERROR)
             debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBlitFramebuffer failed with error %d", error);
 
@@ -913,59 +1088,66 @@ int ScreenCapture::copyScreenToSurface()
     return size;
 }
 
-int ScreenCapture::getPixelsFromSurface(uint8_t **pixels, bool draw)
+int ScreenCapture::getPixelsFromSurface(std::shared_ptr<Frame>& frame, bool draw)
 {
-    if (!inited)
-        return 0;
-
-    if (pixels) {
-        *pixels = winpixels.data();
+    /* Our surface only changes on draw frames */
+    if (!inited || !draw) {
+        frame = getLastFrame();
+        return inited ? size : 0;
     }
 
-    if (!draw)
-        return size;
-
     GlobalNative gn;
 
     if (game_info.video & GameInfo::VDPAU) {
         /* Copy pixels */
-        void* const pix = reinterpret_cast<void* const>(winpixels.data());
+        std::shared_ptr<Frame> pool_frame = allocPoolFrame();
+        void* const pix = reinterpret_cast<void* const>(pool_frame->pixels);
         unsigned int pp = pitch;
         VdpStatus status = orig::VdpOutputSurfaceGetBitsNative(screenVDPAUSurf, nullptr, &pix, &pp);
         if (status != VDP_STATUS_OK) {
             debuglogstdio(LCF_WINDOW | LCF_ERROR, "VdpOutputSurfaceGetBitsNative failed with status %d", status);
         }
+        frame = lastFrame = pool_frame;
     }
 
     else if (game_info.video & GameInfo::SDL2_RENDERER) {
         LINK_NAMESPACE_SDL2(SDL_LockTexture);
         LINK_NAMESPACE_SDL2(SDL_UnlockTexture);
 
-        /* Access the texture and copy pixels */
+        /* Access the texture, which stays locked while the frame references it */
         void* tex_pixels;
         int tex_pitch;
-        orig::SDL_LockTexture(screenSDLTex, nullptr, &tex_pixels, &tex_pitch);
-        memcpy(winpixels.data(), tex_pixels, size);
-        orig::SDL_UnlockTexture(screenSDLTex);
+        if (orig::SDL_LockTexture(screenSDLTex, nullptr, &tex_pixels, &tex_pitch) < 0) {
+            debuglogstdio(LCF_DUMP | LCF_SDL | LCF_ERROR, "SDL_LockTexture failed: %s", orig::SDL_GetError());
+            frame = getLastFrame();
+            return size;
+        }
+        SDL_Texture* tex = screenSDLTex;
+        frame = lastFrame = makeBackendFrame(static_cast<uint8_t*>(tex_pixels), tex_pitch, [tex] () {
+            GlobalNative gn;
+            orig::SDL_UnlockTexture(tex);
+        });
     }
 
     else if (game_info.video & GameInfo::SDL2_SURFACE) {
         /* We must lock the surface before accessing the raw pixels */
-        if (SDL_MUSTLOCK(screenSDL2Surf))
-            orig::SDL_LockSurface(screenSDL2Surf);
-
-        /* I know memcpy is not recommended for vectors... */
-        memcpy(winpixels.data(), screenSDL2Surf->pixels, size);
+        SDL_Surface* surf = screenSDL2Surf;
+        std::function<void()> release;
+        if (SDL_MUSTLOCK(surf)) {
+            orig::SDL_LockSurface(surf);
+            release = [surf] () {
+                GlobalNative gn;
+                orig::SDL_UnlockSurface(surf);
+            };
+        }
 
-        /* Unlock surface */
-        if (SDL_MUSTLOCK(screenSDL2Surf))
-            orig::SDL_UnlockSurface(screenSDL2Surf);
+        frame = lastFrame = makeBackendFrame(static_cast<uint8_t*>(surf->pixels), surf->pitch, release);
     }
 
     else if (game_info.video & GameInfo::OPENGL) {
         LINK_NAMESPACE(glReadPixels, "GL");
         LINK_NAMESPACE(glBindFramebuffer, "GL");
-        LINK_NAMESPACE(glBlitFramebuffer, "GL");
+        LINK_NAMESPACE(glBindBuffer, "GL");
         LINK_NAMESPACE(glEnable, "GL");
         LINK_NAMESPACE(glDisable, "GL");
         LINK_NAMESPACE(glIsEnabled, "GL");
@@ -978,9 +1160,10 @@ int ScreenCapture::getPixelsFromSurface(uint8_t **pixels, bool draw)
         if (isFramebufferSrgb)
             orig::glDisable(GL_FRAMEBUFFER_SRGB);
 
-        /* Copy the original read framebuffer */
-        GLint read_buffer;
+        /* Copy the original read framebuffer and pack buffer */
+        GLint read_buffer, pack_buffer;
         orig::glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_buffer);
+        orig::glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pack_buffer);
 
         orig::glGetError();
 
@@ -988,48 +1171,52 @@ int ScreenCapture::getPixelsFromSurface(uint8_t **pixels, bool draw)
         if ((error = orig::glGetError()) != GL_NO_ERROR)
             debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBindFramebuffer failed with error %d", error);
 
-        orig::glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, winpixels.data());
+        /* Make sure that pixels are written into our array */
+        if (pack_buffer != 0)
+            orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        std::shared_ptr<Frame> pool_frame = allocPoolFrame();
+        orig::glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pool_frame->pixels);
         if ((error = orig::glGetError()) != GL_NO_ERROR)
             debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glReadPixels failed with error %d", error);
 
+        if (pack_buffer != 0)
+            orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffer);
+
         orig::glBindFramebuffer(GL_READ_FRAMEBUFFER, read_buffer);
         if ((error = orig::glGetError()) != GL_NO_ERROR)
             debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBindFramebuffer failed with error %d", error);
 
-        /*
-         * Flip image horizontally in place
-         * This is because OpenGL has a different reference point
-         * Code taken from http://stackoverflow.com/questions/5862097/sdl-opengl-screenshot-is-black
-         */
-        for (int line = 0; line < (height/2); line++) {
-            int pos1 = line * pitch;
-            int pos2 = (height-line-1) * pitch;
-            memcpy(gllinepixels.data(), &winpixels[pos1], pitch);
-            memcpy(&winpixels[pos1], &winpixels[pos2], pitch);
-            memcpy(&winpixels[pos2], gllinepixels.data(), pitch);
-        }
-
         if (isFramebufferSrgb)
             orig::glEnable(GL_FRAMEBUFFER_SRGB);
+
+        frame = lastFrame = pool_frame;
     }
 
     else if (game_info.video & GameInfo::SDL1) {
-        /* We must lock the surface before accessing the raw pixels */
-        int ret = orig::SDL1_LockSurface(screenSDL1Surf);
-        if (ret != 0) {
-            debuglogstdio(LCF_DUMP | LCF_ERROR, "Could not lock SDL surface");
-            return -1;
+        /* We must lock the surface before accessing the raw pixels, if
+         * required (same as the SDL_MUSTLOCK macro) */
+        SDL1::SDL_Surface* surf = screenSDL1Surf;
+        std::function<void()> release;
+        if (surf->offset || (surf->flags & (SDL1::SDL1_HWSURFACE | SDL1::SDL1_ASYNCBLIT | SDL1::SDL1_RLEACCEL))) {
+            int ret = orig::SDL1_LockSurface(surf);
+            if (ret != 0) {
+                debuglogstdio(LCF_DUMP | LCF_ERROR, "Could not lock SDL surface");
+                frame = getLastFrame();
+                return -1;
+            }
+            release = [surf] () {
+                GlobalNative gn;
+                orig::SDL1_UnlockSurface(surf);
+            };
         }
 
-        /* I know memcpy is not recommended for vectors... */
-        memcpy(winpixels.data(), screenSDL1Surf->pixels, size);
-
-        /* Unlock surface */
-        orig::SDL1_UnlockSurface(screenSDL1Surf);
+        frame = lastFrame = makeBackendFrame(static_cast<uint8_t*>(surf->pixels), surf->pitch, release);
     }
 
     else if (game_info.video & GameInfo::XSHM) {
-        /* Nothing to do here, the surface is already stored in the pixel array */
+        /* The surface is already stored in the pixel array */
+        frame = lastFrame = makeBackendFrame(winpixels.data(), pitch, nullptr);
     }
 
     else if (game_info.video & GameInfo::VULKAN) {
@@ -1044,20 +1231,122 @@ int ScreenCapture::getPixelsFromSurface(uint8_t **pixels, bool draw)
 		VkSubresourceLayout subResourceLayout;
 		orig::vkGetImageSubresourceLayout(vk::device, vkScreenImage, &subResource, &subResourceLayout);
 
-		/* Map image memory so we can start copying from it */
-		const char* data;
+		/* Map image memory, which stays mapped while the frame references it */
+		uint8_t* data;
         if ((res = orig::vkMapMemory(vk::device, vkScreenImageMemory, 0, VK_WHOLE_SIZE, 0, (void**)&data)) != VK_SUCCESS) {
-            debuglogstdio(LCF_VULKAN | LCF_ERROR, "vkEndCommandBuffer failed with error %d", res);
+            debuglogstdio(LCF_VULKAN | LCF_ERROR, "vkMapMemory failed with error %d", res);
+            frame = getLastFrame();
+            return size;
         }
 		data += subResourceLayout.offset;
-        memcpy(winpixels.data(), data, size);
-        
-        orig::vkUnmapMemory(vk::device, vkScreenImageMemory);
+
+        VkDeviceMemory memory = vkScreenImageMemory;
+        frame = lastFrame = makeBackendFrame(data, subResourceLayout.rowPitch, [memory] () {
+            GlobalNative gn;
+            orig::vkUnmapMemory(vk::device, memory);
+        });
     }
     
     return size;
 }
 
+bool ScreenCapture::queuePixelsFromSurface()
+{
+    if (!inited)
+        return false;
+
+    if (!(game_info.video & GameInfo::OPENGL))
+        return false;
+
+    if ((screenPBOs[0] == 0) || (pboQueued == PBO_RING_SIZE))
+        return false;
+
+    LINK_NAMESPACE(glReadPixels, "GL");
+    LINK_NAMESPACE(glBindFramebuffer, "GL");
+    LINK_NAMESPACE(glBindBuffer, "GL");
+    LINK_NAMESPACE(glGetIntegerv, "GL");
+
+    GlobalNative gn;
+
+    GLenum error;
+
+    /* Copy the original read framebuffer and pack buffer */
+    GLint read_buffer, pack_buffer;
+    orig::glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_buffer);
+    orig::glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pack_buffer);
+
+    orig::glGetError();
+
+    orig::glBindFramebuffer(GL_READ_FRAMEBUFFER, screenFBO);
+    if ((error = orig::glGetError()) != GL_NO_ERROR)
+        debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBindFramebuffer failed with error %d", error);
+
+    int index = (pboReadIndex + pboQueued) % PBO_RING_SIZE;
+    orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, screenPBOs[index]);
+    if ((error = orig::glGetError()) != GL_NO_ERROR)
+        debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBindBuffer failed with error %d", error);
+
+    /* With a pack buffer bound, this only queues the transfer and returns */
+    orig::glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    if ((error = orig::glGetError()) != GL_NO_ERROR)
+        debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glReadPixels failed with error %d", error);
+
+    orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffer);
+
+    orig::glBindFramebuffer(GL_READ_FRAMEBUFFER, read_buffer);
+    if ((error = orig::glGetError()) != GL_NO_ERROR)
+        debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBindFramebuffer failed with error %d", error);
+
+    pboQueued++;
+    return true;
+}
+
+int ScreenCapture::getQueuedPixels(std::shared_ptr<Frame>& frame)
+{
+    /* If the transfer was lost, we return the last frame */
+    if (!inited || (pboQueued == 0)) {
+        frame = getLastFrame();
+        return inited ? size : 0;
+    }
+
+    LINK_NAMESPACE(glBindBuffer, "GL");
+    LINK_NAMESPACE(glMapBufferRange, "GL");
+    LINK_NAMESPACE(glUnmapBuffer, "GL");
+    LINK_NAMESPACE(glGetIntegerv, "GL");
+
+    GlobalNative gn;
+
+    GLenum error;
+
+    GLint pack_buffer;
+    orig::glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pack_buffer);
+
+    orig::glGetError();
+
+    orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, screenPBOs[pboReadIndex]);
+
+    /* This only blocks if the transfer is not finished yet. Pixels are
+     * copied into a pool buffer, so that the pixel buffer can be reused
+     * while the frame is still referenced. */
+    std::shared_ptr<Frame> pool_frame = allocPoolFrame();
+    void* data = orig::glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (data) {
+        memcpy(pool_frame->pixels, data, size);
+        orig::glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else if ((error = orig::glGetError()) != GL_NO_ERROR) {
+        debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glMapBufferRange failed with error %d", error);
+    }
+
+    orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffer);
+
+    pboReadIndex = (pboReadIndex + 1) % PBO_RING_SIZE;
+    pboQueued--;
+
+    frame = lastFrame = pool_frame;
+    return size;
+}
+
 int ScreenCapture::copySurfaceToScreen()
 {
     if (!inited)
@@ -1065,6 +1354,11 @@ int ScreenCapture::copySurfaceToScreen()
 
     GlobalNative gn;
 
+    /* Our surface or texture must be unlocked before being copied. The last
+     * frame is kept, because it is returned on the following non-draw frames */
+    if (lastFrame && lastFrame->release)
+        detachLastFrame(true);
+
     if (game_info.video & GameInfo::VDPAU) {
         VdpStatus status = orig::VdpOutputSurfaceRenderOutputSurface(vdp::vdpSurface, nullptr, screenVDPAUSurf, nullptr, nullptr, nullptr, 0);
         if (status != VDP_STATUS_OK) {
@@ -1130,7 +1424,8 @@ int ScreenCapture::copySurfaceToScreen()
         if ((error = orig::glGetError()) != GL_NO_ERROR)
             debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBindFramebuffer failed with error %d", error);
 
-        orig::glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        /* Flip back the stored surface */
+        orig::glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
         if ((error = orig::glGetError()) != GL_NO_ERROR)
             debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBlitFramebuffer failed with error %d", error);
 
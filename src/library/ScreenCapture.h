@@ -21,11 +21,34 @@
 #define LIBTAS_SCREENCAPTURE_H_INCL
 
 #include <stdint.h>
+#include <memory>
+#include <vector>
+#include <functional>
 
 namespace libtas {
 
 namespace ScreenCapture {
 
+/* A captured frame, shared between the screen capture and its consumers.
+ * Pixels either directly reference the backend memory (surface, locked
+ * texture or mapped image), or a buffer from a pool. If a consumer still
+ * holds a frame when the backend memory is needed again, the pixels are
+ * copied into a pool buffer at that point, so `pixels` must be read again
+ * after each call to this module. */
+struct Frame {
+    ~Frame();
+
+    /* Pixels of the frame */
+    uint8_t* pixels = nullptr;
+
+    /* Pool buffer holding the pixels, or nullptr if the pixels reference
+     * the backend memory */
+    std::vector<uint8_t>* buffer = nullptr;
+
+    /* Release the backend memory, if needed */
+    std::function<void()> release;
+};
+
 /* Initiate the internal variables and buffers, and get the screen dimensions
  * @return 0 if successful or -1 if an error occured
  */
@@ -51,6 +74,9 @@ void getDimensions(int& w, int& h);
 /* Get the size of the pixel array */
 int getSize();
 
+/* Get the number of bytes per pixel */
+int getPixelSize();
+
 /* Get the pixel format as an string used by nut muxer. */
 const char* getPixelFormat();
 
@@ -58,9 +84,24 @@ const char* getPixelFormat();
  * This surface is optimized for rendering, so it may be stored on GPU. */
 int copyScreenToSurface();
 
-/* Transfer pixels from the screen buffer/surface/texture into an array, pointed by `pixels`
+/* Get the pixels from the screen buffer/surface/texture into a frame, pointed
+ * by `frame`. When the backend allows it, the frame directly references the
+ * backend memory without any copy. Otherwise, pixels are copied into a
+ * buffer from a pool. On non-draw frames, the last frame is returned.
  * Returns the size of the array. */
-int getPixelsFromSurface(uint8_t **pixels, bool draw);
+int getPixelsFromSurface(std::shared_ptr<Frame>& frame, bool draw);
+
+/* Start an asynchronous transfer of the pixels from the screen
+ * buffer/surface/texture. Only supported for OpenGL, where transfers are
+ * queued in a ring of pixel buffers.
+ * Returns false if the transfer could not be queued, in which case
+ * `getPixelsFromSurface()` must be used instead. */
+bool queuePixelsFromSurface();
+
+/* Get the pixels of the oldest queued transfer into a frame from the pool,
+ * pointed by `frame`. If the transfer was lost (screen was resized or
+ * closed), the last frame is returned. Returns the size of the array. */
+int getQueuedPixels(std::shared_ptr<Frame>& frame);
 
 /* Copy back the stored screen buffer/surface/texture into the screen. */
 int copySurfaceToScreen();
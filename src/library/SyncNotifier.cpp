@@ -0,0 +1,100 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SyncNotifier.h"
+#include "logging.h"
+#include "GlobalState.h"
+#include <algorithm>
+#include <chrono>
+
+namespace libtas {
+
+/* Notifiers are global objects, so this must not depend on the order of
+ * static initialization. It is zero-initialized before any constructor. */
+SyncNotifier* SyncNotifier::first;
+
+SyncNotifier::SyncNotifier(const char* n) : name(n), sequence(0), waiters(0), frame_wait(0)
+{
+    next = first;
+    first = this;
+}
+
+void SyncNotifier::notify()
+{
+    sequence++;
+    if (waiters.load() == 0)
+        return;
+
+    GlobalNative gn;
+
+    /* Taking the lock ensures that a thread that just checked its condition
+     * is either waiting on the condition variable, or will see the new
+     * sequence number */
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    cond.notify_all();
+}
+
+bool SyncNotifier::wait(std::function<bool()> condition, int timeout_ms)
+{
+    if (condition())
+        return true;
+
+    /* Time and condition variable calls are hooked, we need the real ones */
+    GlobalNative gn;
+
+    auto start = std::chrono::steady_clock::now();
+    auto timeout = std::chrono::milliseconds(timeout_ms);
+    int delay_us = 10;
+    bool ret = true;
+
+    waiters++;
+
+    while (true) {
+        unsigned int seq = sequence.load();
+        if (condition())
+            break;
+
+        if ((std::chrono::steady_clock::now() - start) >= timeout) {
+            ret = false;
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, std::chrono::microseconds(delay_us), [this, seq]{ return sequence.load() != seq; });
+        delay_us = std::min(2 * delay_us, 1000);
+    }
+
+    waiters--;
+
+    frame_wait += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return ret;
+}
+
+void SyncNotifier::reportWaits()
+{
+    for (SyncNotifier* notifier = first; notifier != nullptr; notifier = notifier->next) {
+        int64_t wait = notifier->frame_wait.exchange(0);
+        if (wait > 0)
+            debuglogstdio(LCF_WAIT, "Waited %d us on %s during the frame", static_cast<int>(wait / 1000), notifier->name);
+    }
+}
+
+}
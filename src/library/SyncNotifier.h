@@ -0,0 +1,82 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SYNCNOTIFIER_H_INCL
+#define LIBTAS_SYNCNOTIFIER_H_INCL
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace libtas {
+/* Notification that a state shared between threads has changed, used when
+ * our code must wait for the game to process something (events, audio
+ * samples). The thread that changes the state calls notify(), and the
+ * waiting thread checks its condition each time it is notified.
+ *
+ * The condition is never checked while holding the notifier lock, so it can
+ * take other locks without risking a deadlock with the notifying thread.
+ * When nobody notifies (e.g. a pipe that is read by the game), the condition
+ * is still checked periodically, with an increasing delay.
+ *
+ * The time spent waiting is accumulated for each notifier and reported at
+ * each frame.
+ */
+class SyncNotifier
+{
+    public:
+        SyncNotifier(const char* name);
+
+        /* Wake up the threads waiting on this notifier */
+        void notify();
+
+        /* Wait until the condition becomes true.
+         * @return false if the timeout expired
+         */
+        bool wait(std::function<bool()> condition, int timeout_ms);
+
+        /* Log the time spent waiting during the frame on each notifier, and
+         * reset it */
+        static void reportWaits();
+
+    private:
+        const char* name;
+
+        std::mutex mutex;
+        std::condition_variable cond;
+
+        /* Incremented on each notification */
+        std::atomic<unsigned int> sequence;
+
+        /* Number of waiting threads, so that notifying is cheap when
+         * nobody waits */
+        std::atomic<int> waiters;
+
+        /* Time spent waiting during the current frame, in nanoseconds */
+        std::atomic<int64_t> frame_wait;
+
+        /* List of all notifiers */
+        SyncNotifier* next;
+        static SyncNotifier* first;
+};
+}
+
+#endif
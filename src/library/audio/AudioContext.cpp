@@ -20,6 +20,7 @@
 #include "../logging.h"
 #include "AudioContext.h"
 #include "AudioPlayer.h"
+#include "AudioMixer.h"
 #include "../global.h" // shared_config
 
 #include <stdint.h>
@@ -83,113 +84,53 @@ void AudioContext::init(void)
 
 int AudioContext::createBuffer(void)
 {
-    if (buffers.size() >= MAXBUFFERS)
+    /* Recycle a deleted buffer if possible, or create a new one */
+    auto ab = buffers.create(MAXBUFFERS);
+    if (!ab)
         return -1;
 
-    /* Check if we can recycle a deleted buffer */
-    if (!buffers_pool.empty()) {
-        buffers.push_front(buffers_pool.front());
-        buffers_pool.pop_front();
-        return buffers.front()->id;
-    }
-
-    /* If not, we create a new buffer.
-     * The next available id equals the size of the buffer list + 1
-     * (ids must start by 1, because 0 is reserved for no buffer)
-     */
-    auto newab = std::make_shared<AudioBuffer>();
-    newab->id = buffers.size() + 1;
-    buffers.push_front(newab);
-    return newab->id;
+    return ab->id;
 }
 
 void AudioContext::deleteBuffer(int id)
 {
-    buffers.remove_if([id,this](std::shared_ptr<AudioBuffer> const& buffer)
-        {
-            if (buffer->id == id) {
-                /* Push the deleted buffer into the pool */
-                buffers_pool.push_front(buffer);
-                return true;
-            }
-            return false;
-        });
+    buffers.remove(id);
 }
 
 bool AudioContext::isBuffer(int id)
 {
-    for (auto const& buffer : buffers) {
-        if (buffer->id == id)
-            return true;
-    }
-
-    return false;
+    return buffers.contains(id);
 }
 
 std::shared_ptr<AudioBuffer> AudioContext::getBuffer(int id)
 {
-    for (auto& buffer : buffers) {
-        if (buffer->id == id)
-            return buffer;
-    }
-
-    return nullptr;
+    return buffers.get(id);
 }
 
 int AudioContext::createSource(void)
 {
-    if (sources.size() >= MAXSOURCES)
+    /* Recycle a deleted source if possible, or create a new one */
+    auto as = sources.create(MAXSOURCES);
+    if (!as)
         return -1;
 
-    /* Check if we can recycle a deleted source */
-    if (!sources_pool.empty()) {
-        sources.push_front(sources_pool.front());
-        sources_pool.pop_front();
-        sources.front()->init();
-        return sources.front()->id;
-    }
-
-    /* If not, we create a new source.
-     * The next available id equals the size of the source list + 1
-     * (ids must start by 1, because 0 is reserved for no source)
-     */
-    auto newas = std::make_shared<AudioSource>();
-    newas->id = sources.size() + 1;
-    sources.push_front(newas);
-    return newas->id;
+    as->init();
+    return as->id;
 }
 
 void AudioContext::deleteSource(int id)
 {
-    sources.remove_if([id,this](std::shared_ptr<AudioSource> const& source)
-        {
-            if (source->id == id) {
-                /* Push the deleted source into the pool */
-                sources_pool.push_front(source);
-                return true;
-            }
-            return false;
-        });
+    sources.remove(id);
 }
 
 bool AudioContext::isSource(int id)
 {
-    for (auto& source : sources) {
-        if (source->id == id)
-            return true;
-    }
-
-    return false;
+    return sources.contains(id);
 }
 
 std::shared_ptr<AudioSource> AudioContext::getSource(int id)
 {
-    for (auto& source : sources) {
-        if (source->id == id)
-            return source;
-    }
-
-    return nullptr;
+    return sources.get(id);
 }
 
 void AudioContext::mixAllSources(int nbSamples)
@@ -218,40 +159,67 @@ void AudioContext::mixAllSources(struct timespec ticks)
     if (outBitDepth == 16) // Signed 16-bit samples
         outSamples.assign(outBytes, 0);
 
+    mixBus.assign(outNbSamples * outNbChannels, 0);
+
     pthread_t mix_thread = ThreadManager::getThreadId();
 
-    for (auto& source : sources) {
+    /* Sources may be deleted by the game while we wait below, which moves
+     * another source into the freed slot. We iterate over a copy of the
+     * sources, and skip the ones deleted in between */
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        mixSources.assign(sources.begin(), sources.end());
+    }
+
+    for (const std::shared_ptr<AudioSource>& source : mixSources) {
+
         /* If an audio source is filled asynchronously, and we will underrun,
          * try to wait until the source is filled.
          */
 
-        audiocontext.mutex.lock();
         if ((source->source == AudioSource::SOURCE_STREAMING_CONTINUOUS) &&
             audio_thread &&
-            (mix_thread != audio_thread) &&
-            source->willEnd(ticks)) {
+            (mix_thread != audio_thread)) {
 
-            debuglogstdio(LCF_SOUND | LCF_WARNING, "Audio mixing will underrun, waiting for the game to send audio samples");
-            int i;
-            for (i=0; i<1000; i++) {
+            bool willEnd;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                willEnd = source->willEnd(ticks);
+            }
 
-                audiocontext.mutex.unlock();
-                NATIVECALL(usleep(100));
-                audiocontext.mutex.lock();
+            if (willEnd) {
+                debuglogstdio(LCF_SOUND | LCF_WARNING, "Audio mixing will underrun, waiting for the game to send audio samples");
+                bool filled = sourceFilled.wait([this, &source, ticks]{
+                    std::lock_guard<std::mutex> lock(mutex);
+                    return !source->willEnd(ticks);
+                }, 100);
 
-                if (!source->willEnd(ticks))
-                    break;
-            }
-            if (i == 1000) {
-                debuglogstdio(LCF_SOUND | LCF_WARNING, "    Timeout");
+                if (!filled) {
+                    debuglogstdio(LCF_SOUND | LCF_WARNING, "    Timeout");
+                }
             }
         }
-        audiocontext.mutex.unlock();
 
         std::lock_guard<std::mutex> lock(mutex);
-        source->mixWith(ticks, &outSamples[0], outBytes, outBitDepth, outNbChannels, outFrequency, outVolume);
+        if (sources.get(source->id) != source)
+            continue;
+
+        source->mixWith(ticks, mixBus.data(), outNbSamples, outNbChannels, outFrequency, outVolume);
     }
 
+    mixSources.clear();
+
+    /* Clamp the mix only once, so that saturation does not depend on the
+     * order of sources */
+    int nbSaturate = 0;
+    if (outBitDepth == 8)
+        nbSaturate = AudioMixer::convertU8(mixBus.data(), outSamples.data(), mixBus.size());
+    if (outBitDepth == 16)
+        nbSaturate = AudioMixer::convertS16(mixBus.data(), reinterpret_cast<int16_t*>(outSamples.data()), mixBus.size());
+
+    if (nbSaturate > 0)
+        debuglogstdio(LCF_SOUND | LCF_WARNING, "Saturation during mixing for %d samples", nbSaturate);
+
     if (!audiocontext.isLoopback && !shared_config.audio_mute) {
         /* Play the music */
         AudioPlayer::play(*this);
@@ -22,10 +22,11 @@
 
 #include <vector>
 #include <memory>
-#include <list>
 #include <mutex>
 #include "AudioBuffer.h"
 #include "AudioSource.h"
+#include "SlotMap.h"
+#include "../SyncNotifier.h"
 
 namespace libtas {
 /* This class stores a set of audio sources and audio buffers, and
@@ -60,6 +61,10 @@ class AudioContext
         /* Mixed buffer during a frame */
         std::vector<uint8_t> outSamples;
 
+        /* Sum of all sources during a frame, as 32-bit signed 16-bit samples,
+         * before being clamped and converted into outSamples */
+        std::vector<int32_t> mixBus;
+
         /* Size of the mixed buffer in samples */
         int outNbSamples;
 
@@ -106,13 +111,17 @@ class AudioContext
         /* Game thread that fills audio buffer */
         pthread_t audio_thread;
 
+        /* Notify that the game pushed samples to a streaming source */
+        SyncNotifier sourceFilled{"audio"};
+
     private:
-        std::list<std::shared_ptr<AudioBuffer>> buffers;
-        std::list<std::shared_ptr<AudioSource>> sources;
+        /* Buffers and sources indexed by id. Deleted objects are kept
+         * there to be recycled */
+        SlotMap<AudioBuffer> buffers;
+        SlotMap<AudioSource> sources;
 
-        /* Extra buffers and sources that have been deleted and can be recycled */
-        std::list<std::shared_ptr<AudioBuffer>> buffers_pool;
-        std::list<std::shared_ptr<AudioSource>> sources_pool;
+        /* Sources being mixed during a frame */
+        std::vector<std::shared_ptr<AudioSource>> mixSources;
 };
 
 extern AudioContext audiocontext;
@@ -0,0 +1,156 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AudioMixer.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace libtas {
+
+void AudioMixer::mixS16(int32_t* bus, const int16_t* samples, int count, int nbChannels, int lvol, int rvol)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    /* Compute (s * vol) >> 16 exactly using 16-bit multiplications. The low
+     * 16 bits of the volume are multiplied as a signed value, so we must
+     * add back the sample when this value is negative, or when the volume
+     * is exactly 65536. */
+    int lvol_lo = static_cast<int16_t>(lvol & 0xffff);
+    int rvol_lo = static_cast<int16_t>(((nbChannels == 2) ? rvol : lvol) & 0xffff);
+    int lmask = (lvol >= 32768) ? 0xffff : 0;
+    int rmask = (((nbChannels == 2) ? rvol : lvol) >= 32768) ? 0xffff : 0;
+
+    const __m128i vol = _mm_setr_epi16(lvol_lo, rvol_lo, lvol_lo, rvol_lo, lvol_lo, rvol_lo, lvol_lo, rvol_lo);
+    const __m128i mask = _mm_setr_epi16(lmask, rmask, lmask, rmask, lmask, rmask, lmask, rmask);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        __m128i m = _mm_add_epi16(_mm_mulhi_epi16(s, vol), _mm_and_si128(s, mask));
+
+        /* Sign-extend to 32-bit and accumulate */
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(m, m), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(m, m), 16);
+        __m128i* b = reinterpret_cast<__m128i*>(bus + i);
+        _mm_storeu_si128(b, _mm_add_epi32(_mm_loadu_si128(b), lo));
+        _mm_storeu_si128(b + 1, _mm_add_epi32(_mm_loadu_si128(b + 1), hi));
+    }
+#endif
+
+    /* Remaining samples. Blocks of 8 values always start on a left channel */
+    for (; i < count; i++) {
+        int v = ((nbChannels == 2) && (i & 1)) ? rvol : lvol;
+        bus[i] += (samples[i] * v) >> 16;
+    }
+}
+
+int AudioMixer::convertS16(const int32_t* bus, int16_t* out, int count)
+{
+    int nbSaturate = 0;
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i max = _mm_set1_epi32(INT16_MAX);
+    const __m128i min = _mm_set1_epi32(INT16_MIN);
+    __m128i saturated = _mm_setzero_si128();
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bus + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bus + i + 4));
+
+        /* Count saturated values, comparisons give -1 when true */
+        saturated = _mm_sub_epi32(saturated, _mm_cmpgt_epi32(lo, max));
+        saturated = _mm_sub_epi32(saturated, _mm_cmplt_epi32(lo, min));
+        saturated = _mm_sub_epi32(saturated, _mm_cmpgt_epi32(hi, max));
+        saturated = _mm_sub_epi32(saturated, _mm_cmplt_epi32(hi, min));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(lo, hi));
+    }
+
+    int32_t sat[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sat), saturated);
+    nbSaturate = sat[0] + sat[1] + sat[2] + sat[3];
+#endif
+
+    for (; i < count; i++) {
+        int v = bus[i];
+        if (v > INT16_MAX) {
+            v = INT16_MAX;
+            nbSaturate++;
+        }
+        else if (v < INT16_MIN) {
+            v = INT16_MIN;
+            nbSaturate++;
+        }
+        out[i] = v;
+    }
+
+    return nbSaturate;
+}
+
+int AudioMixer::convertU8(const int32_t* bus, uint8_t* out, int count)
+{
+    int nbSaturate = 0;
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i max = _mm_set1_epi32(INT16_MAX);
+    const __m128i min = _mm_set1_epi32(INT16_MIN);
+    const __m128i offset = _mm_set1_epi8(static_cast<char>(0x80));
+    __m128i saturated = _mm_setzero_si128();
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v[4];
+        for (int j = 0; j < 4; j++) {
+            v[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bus + i + 4*j));
+            saturated = _mm_sub_epi32(saturated, _mm_cmpgt_epi32(v[j], max));
+            saturated = _mm_sub_epi32(saturated, _mm_cmplt_epi32(v[j], min));
+        }
+
+        /* Saturate to 16-bit, keep the high byte, and convert to unsigned */
+        __m128i a = _mm_srai_epi16(_mm_packs_epi32(v[0], v[1]), 8);
+        __m128i b = _mm_srai_epi16(_mm_packs_epi32(v[2], v[3]), 8);
+        __m128i r = _mm_xor_si128(_mm_packs_epi16(a, b), offset);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), r);
+    }
+
+    int32_t sat[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sat), saturated);
+    nbSaturate = sat[0] + sat[1] + sat[2] + sat[3];
+#endif
+
+    for (; i < count; i++) {
+        int v = bus[i];
+        if (v > INT16_MAX) {
+            v = INT16_MAX;
+            nbSaturate++;
+        }
+        else if (v < INT16_MIN) {
+            v = INT16_MIN;
+            nbSaturate++;
+        }
+        out[i] = static_cast<uint8_t>((v >> 8) + 128);
+    }
+
+    return nbSaturate;
+}
+
+}
@@ -0,0 +1,58 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_AUDIOMIXER_H_INCL
+#define LIBTAS_AUDIOMIXER_H_INCL
+
+#include <cstdint>
+
+namespace libtas {
+/* Mixing kernels of the audio context.
+ *
+ * All sources are accumulated into a 32-bit integer bus of signed 16-bit
+ * samples, and the bus is clamped only once when converted into the output
+ * format. Integer accumulation makes the result independent of the order
+ * of sources, and saturation only depends on the final sum.
+ */
+namespace AudioMixer
+{
+    /* Add signed 16-bit samples into the bus, multiplied by a volume for
+     * each channel, expressed in 16.16 fixed-point (65536 is full volume).
+     * @param bus          Mixing bus, of size `count`
+     * @param samples      Interleaved samples to mix, of size `count`
+     * @param count        Number of values (samples times channels)
+     * @param nbChannels   Number of interleaved channels
+     * @param lvol         Volume of the left (or only) channel
+     * @param rvol         Volume of the right channel
+     */
+    void mixS16(int32_t* bus, const int16_t* samples, int count, int nbChannels, int lvol, int rvol);
+
+    /* Convert the bus into signed 16-bit samples.
+     * @return the number of values that were saturated
+     */
+    int convertS16(const int32_t* bus, int16_t* out, int count);
+
+    /* Convert the bus into unsigned 8-bit samples.
+     * @return the number of values that were saturated
+     */
+    int convertU8(const int32_t* bus, uint8_t* out, int count);
+}
+}
+
+#endif
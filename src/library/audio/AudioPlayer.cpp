@@ -22,13 +22,112 @@
 #include "../logging.h"
 #include "../global.h" // shared_config
 #include "../GlobalState.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <csignal> // kill
+#include <ctime>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 //#include "../hook.h"
 
 namespace libtas {
 
+AudioPlayer::SharedState* AudioPlayer::shared = nullptr;
+char* AudioPlayer::ring = nullptr;
+int AudioPlayer::reported_underruns = 0;
+int AudioPlayer::reported_overruns = 0;
 snd_pcm_t *AudioPlayer::phandle;
-AudioPlayer::APStatus AudioPlayer::status = STATUS_UNINIT;
-std::vector<char> AudioPlayer::silence;
+snd_pcm_uframes_t AudioPlayer::period_size;
+
+void AudioPlayer::initProcess()
+{
+    if (shared)
+        return;
+
+    void* addr;
+    NATIVECALL(addr = mmap(nullptr, shared_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    MYASSERT(addr != MAP_FAILED)
+
+    shared = new (addr) SharedState();
+    shared->status = STATUS_UNINIT;
+    shared->running = false;
+    shared->session = 0;
+    shared->session_done = 0;
+    shared->player_pid = 0;
+    NATIVECALL(shared->owner_pid = getpid());
+    sem_init(&shared->wakeup, 1, 0);
+    ring = static_cast<char*>(addr) + sizeof(SharedState);
+
+    /* Start the playback process. We fork twice so that it is not a child
+     * of the game, which could wait for it. */
+    pid_t pid;
+    NATIVECALL(pid = fork());
+    if (pid == -1) {
+        debuglogstdio(LCF_SOUND | LCF_ERROR, "Could not create audio playback process");
+        shared->status = STATUS_ERROR;
+        return;
+    }
+
+    if (pid == 0) {
+        GlobalNative gn;
+        if (fork() == 0)
+            playerMain();
+        _exit(0);
+    }
+
+    NATIVECALL(waitpid(pid, nullptr, 0));
+}
+
+void AudioPlayer::playerMain()
+{
+    is_fork = true;
+    shared->player_pid = getpid();
+
+    while (true) {
+        /* Stop if the game has exited */
+        if (kill(shared->owner_pid, 0) != 0)
+            _exit(0);
+
+        unsigned int session = shared->session.load(std::memory_order_acquire);
+        if (session == shared->session_done.load(std::memory_order_relaxed)) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 100000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            sem_timedwait(&shared->wakeup, &ts);
+            continue;
+        }
+
+        /* Playback may have been stopped before we noticed it started */
+        if (shared->running.load(std::memory_order_acquire)) {
+            shared_config.includeFlags = shared->includeFlags;
+            shared_config.excludeFlags = shared->excludeFlags;
+
+            if (init(shared->format, shared->nbChannels, static_cast<unsigned int>(shared->frequency))) {
+                playbackLoop();
+                snd_pcm_close(phandle);
+            }
+            else {
+                shared->status = STATUS_ERROR;
+                shared->running = false;
+            }
+        }
+
+        /* Acknowledge that the device is closed */
+        shared->session_done.store(session, std::memory_order_release);
+    }
+}
+
+bool AudioPlayer::isSharedMemory(const void* addr, size_t size)
+{
+    return shared && (addr == shared) && (size == shared_size);
+}
 
 bool AudioPlayer::init(snd_pcm_format_t format, int nbChannels, unsigned int frequency)
 {
@@ -74,7 +173,7 @@ bool AudioPlayer::init(snd_pcm_format_t format, int nbChannels, unsigned int fre
         return false;
     }
 
-    snd_pcm_uframes_t buffer_size = (shared_config.framerate_num>0)?(2*frequency*shared_config.framerate_den/shared_config.framerate_num):(2*frequency/30);
+    snd_pcm_uframes_t buffer_size = shared->bufferSize;
     debuglogstdio(LCF_SOUND, "  Buffer size is %d", buffer_size);
     if (snd_pcm_hw_params_set_buffer_size_near(phandle, hw_params, &buffer_size) < 0) {
         debuglogstdio(LCF_SOUND | LCF_ERROR, "  snd_pcm_hw_params_set_rate_near failed");
@@ -87,6 +186,11 @@ bool AudioPlayer::init(snd_pcm_format_t format, int nbChannels, unsigned int fre
         return false;
     }
 
+    if (snd_pcm_hw_params_get_period_size(hw_params, &period_size, &dir) < 0) {
+        debuglogstdio(LCF_SOUND | LCF_ERROR, "  snd_pcm_hw_params_get_period_size failed");
+        return false;
+    }
+
     if (snd_pcm_prepare(phandle) < 0) {
         debuglogstdio(LCF_SOUND | LCF_ERROR, "  snd_pcm_prepare failed");
         return false;
@@ -94,82 +198,208 @@ bool AudioPlayer::init(snd_pcm_format_t format, int nbChannels, unsigned int fre
 
     snd_pcm_hw_params_free(hw_params);
 
+    /* The playback thread waits on the device with a timeout, so that it
+     * can be stopped quickly */
+    if (snd_pcm_nonblock(phandle, 1) < 0) {
+        debuglogstdio(LCF_SOUND | LCF_ERROR, "  snd_pcm_nonblock failed");
+        return false;
+    }
+
     return true;
 }
 
+void AudioPlayer::playbackLoop()
+{
+    const size_t capacity = shared->capacity;
+    const int alignSize = shared->alignSize;
+
+    /* Number of samples to accumulate before starting to write to the
+     * device. It grows each time the device underruns, and slowly shrinks
+     * when playback is stable. */
+    snd_pcm_uframes_t max_latency = capacity / (2 * alignSize);
+    snd_pcm_uframes_t latency = std::min(period_size, max_latency);
+    int stable_samples = 0;
+    bool starting = true;
+    int loops = 0;
+
+    while (shared->running.load(std::memory_order_acquire)) {
+        /* Stop if the game has exited */
+        if ((++loops % 100) == 0) {
+            if (kill(shared->owner_pid, 0) != 0)
+                break;
+        }
+
+        size_t rpos = shared->ring_read.load(std::memory_order_relaxed);
+        size_t fill = shared->ring_write.load(std::memory_order_acquire) - rpos;
+
+        if ((fill == 0) || (starting && (fill < latency * alignSize))) {
+            usleep(1000);
+            continue;
+        }
+        starting = false;
+
+        /* Wait for space in the device buffer */
+        if (snd_pcm_wait(phandle, 10) == 0)
+            continue;
+
+        size_t offset = rpos % capacity;
+        size_t size = std::min(fill, capacity - offset);
+        snd_pcm_sframes_t frames = snd_pcm_writei(phandle, &ring[offset], size / alignSize);
+
+        if (frames == -EAGAIN)
+            continue;
+
+        if ((frames == -EPIPE) || (frames == -ESTRPIPE)) {
+            shared->underruns++;
+            if (snd_pcm_recover(phandle, frames, 1) < 0) {
+                usleep(1000);
+                continue;
+            }
+
+            /* Buffer more samples before starting again */
+            latency = std::min(latency + period_size, max_latency);
+            stable_samples = 0;
+            starting = true;
+            continue;
+        }
+
+        if (frames < 0) {
+            usleep(1000);
+            continue;
+        }
+
+        shared->ring_read.store(rpos + frames * alignSize, std::memory_order_release);
+
+        /* Decrease the latency after 10 seconds without underrun */
+        stable_samples += frames;
+        if (stable_samples > 10 * shared->frequency) {
+            stable_samples = 0;
+            if (latency > period_size)
+                latency -= period_size;
+        }
+    }
+}
+
 bool AudioPlayer::play(AudioContext& ac)
 {
-    if (status == STATUS_UNINIT) {
+    /* Only the game process controls playback, not its forks */
+    pid_t pid;
+    NATIVECALL(pid = getpid());
+    if (pid != shared->owner_pid)
+        return false;
+
+    /* Restart playback if the format has changed */
+    if ((shared->status == STATUS_OK) &&
+        ((shared->nbChannels != ac.outNbChannels) ||
+         (shared->frequency != ac.outFrequency) ||
+         (shared->alignSize != ac.outAlignSize)))
+        close();
+
+    if (shared->status == STATUS_UNINIT) {
+        debuglogstdio(LCF_SOUND, "Start audio playback");
+
         snd_pcm_format_t format;
         if (ac.outBitDepth == 8)
             format = SND_PCM_FORMAT_U8;
         if (ac.outBitDepth == 16)
             format = SND_PCM_FORMAT_S16_LE;
-        if (!init(format, ac.outNbChannels, static_cast<unsigned int>(ac.outFrequency))) {
-            status = STATUS_ERROR;
-            return false;
-        }
 
-        /* Build a 50 ms silence buffer */
-        int sil_bytes = static_cast<int>(0.05 * ac.outFrequency) * ac.outAlignSize;
-
-        if (ac.outBitDepth == 8) {
-            silence.assign(sil_bytes, -128);
-        }
-        if (ac.outBitDepth == 16) {
-            silence.assign(sil_bytes, 0x00);
-        }
-        
-        status = STATUS_OK;
+        shared->format = format;
+        shared->nbChannels = ac.outNbChannels;
+        shared->frequency = ac.outFrequency;
+        shared->alignSize = ac.outAlignSize;
+        shared->bufferSize = (shared_config.framerate_num>0)?(2*ac.outFrequency*shared_config.framerate_den/shared_config.framerate_num):(2*ac.outFrequency/30);
+        shared->includeFlags = shared_config.includeFlags;
+        shared->excludeFlags = shared_config.excludeFlags;
+
+        /* Build a ring buffer of 500 ms, or as large as the shared memory */
+        size_t max_samples = (shared_size - sizeof(SharedState)) / ac.outAlignSize;
+        size_t ring_samples = std::min(static_cast<size_t>(ac.outFrequency / 2), max_samples);
+        shared->capacity = ring_samples * ac.outAlignSize;
+        shared->ring_write = 0;
+        shared->ring_read = 0;
+        shared->underruns = 0;
+        shared->overruns = 0;
+        reported_underruns = 0;
+        reported_overruns = 0;
+
+        /* The playback process reports an error if it cannot open the
+         * device */
+        shared->status = STATUS_OK;
+        shared->running = true;
+        shared->session.fetch_add(1, std::memory_order_release);
+        sem_post(&shared->wakeup);
     }
 
-    if (status == STATUS_ERROR)
+    if (shared->status == STATUS_ERROR)
         return false;
 
     if (shared_config.fastforward)
         return true;
 
     debuglogstdio(LCF_SOUND, "Play an audio frame");
-    int err;
-    {
-        GlobalNative gn;
-        err = snd_pcm_writei(phandle, ac.outSamples.data(), ac.outNbSamples);
-    }
-	if (err < 0) {
-		if (err == -EPIPE) {
-			debuglogstdio(LCF_SOUND, "  Underrun");
-            {
-                GlobalNative gn;
-	            err = snd_pcm_prepare(phandle);
-            }
-			if (err < 0) {
-				debuglogstdio(LCF_SOUND | LCF_ERROR, "  Can't recovery from underrun, prepare failed: %s", snd_strerror(err));
-			    return false;
-            }
-            else {
-                {
-                    GlobalNative gn;
-                    /* Send silence bytes first */
-                    snd_pcm_writei(phandle, silence.data(), silence.size()/ac.outAlignSize);
-                    snd_pcm_writei(phandle, ac.outSamples.data(), ac.outNbSamples);
-                }
-            }
-		}
-		else {
-			debuglogstdio(LCF_SOUND | LCF_ERROR, "  snd_pcm_writei() failed: %s", snd_strerror (err));
-			return false;
-		}
-	}
+
+    /* Push the samples into the ring. If the playback process is late, we
+     * drop the samples that do not fit. */
+    const size_t capacity = shared->capacity;
+    const int alignSize = shared->alignSize;
+    size_t wpos = shared->ring_write.load(std::memory_order_relaxed);
+    size_t available = capacity - (wpos - shared->ring_read.load(std::memory_order_acquire));
+    size_t size = ac.outNbSamples * alignSize;
+    if (size > available) {
+        shared->overruns += (size - available) / alignSize;
+        size = available - (available % alignSize);
+    }
+
+    const char* samples = reinterpret_cast<const char*>(ac.outSamples.data());
+    size_t offset = wpos % capacity;
+    size_t first = std::min(size, capacity - offset);
+    memcpy(&ring[offset], samples, first);
+    memcpy(&ring[0], samples + first, size - first);
+    shared->ring_write.store(wpos + size, std::memory_order_release);
+
+    /* Report playback issues */
+    int cur_underruns = shared->underruns.load();
+    if (cur_underruns != reported_underruns) {
+        debuglogstdio(LCF_SOUND | LCF_WARNING, "  Audio device underrun (%d in total)", cur_underruns);
+        reported_underruns = cur_underruns;
+    }
+    int cur_overruns = shared->overruns.load();
+    if (cur_overruns != reported_overruns) {
+        debuglogstdio(LCF_SOUND | LCF_WARNING, "  Dropped %d audio samples (%d in total)", cur_overruns - reported_overruns, cur_overruns);
+        reported_overruns = cur_overruns;
+    }
 
     return true;
 }
 
 void AudioPlayer::close()
 {
-    if (status == STATUS_OK) {
-        MYASSERT(snd_pcm_close(phandle) == 0)
-        status = STATUS_UNINIT;
+    if (!shared || (shared->status != STATUS_OK))
+        return;
+
+    pid_t pid;
+    NATIVECALL(pid = getpid());
+    if (pid != shared->owner_pid)
+        return;
+
+    shared->running = false;
+    sem_post(&shared->wakeup);
+
+    /* Wait for the playback process to close the device, so that the next
+     * playback does not change the parameters while the device is in use */
+    unsigned int session = shared->session.load(std::memory_order_relaxed);
+    while (shared->session_done.load(std::memory_order_acquire) != session) {
+        /* Don't wait for a playback process that has died */
+        pid_t player_pid = shared->player_pid.load();
+        int ret;
+        NATIVECALL(ret = kill(player_pid, 0));
+        if ((player_pid == 0) || (ret != 0))
+            break;
+        NATIVECALL(usleep(1000));
     }
+
+    shared->status = STATUS_UNINIT;
 }
 
 }
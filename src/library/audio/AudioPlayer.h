@@ -21,10 +21,26 @@
 #define LIBTAS_AUDIOPLAYER_H_INCL
 
 #include "AudioContext.h"
+#include "../../shared/lcf.h"
 #include <alsa/asoundlib.h>
+#include <atomic>
+#include <semaphore.h>
+#include <sys/types.h>
 
 namespace libtas {
-/* Class in charge of sending the mixed samples to the audio device */
+/* Class in charge of sending the mixed samples to the audio device.
+ *
+ * The connection to the device is owned by a separate playback process, so
+ * that it is not affected by savestates, and the device is never reopened
+ * when saving or loading a state. This process is started with the game,
+ * so that it does not keep a copy of the game memory.
+ *
+ * Mixed samples are pushed into a ring buffer located in memory shared with
+ * that process, which is excluded from savestates. This way, the frame
+ * boundary never waits for the device. There is a single producer (the
+ * thread mixing audio) and a single consumer (the playback process), so
+ * positions inside the ring are atomic counters without any lock.
+ */
 class AudioPlayer
 {
     /* Status */
@@ -34,26 +50,92 @@ class AudioPlayer
         STATUS_OK = 1,
     };
 
-    static APStatus status;
+    /* State shared with the playback process. It is not saved in
+     * savestates, so it always describes the current playback process. */
+    struct SharedState {
+        std::atomic<int> status;
+
+        /* Game process, and playback process */
+        pid_t owner_pid;
+        std::atomic<pid_t> player_pid;
+
+        /* Wake up the playback process */
+        sem_t wakeup;
+
+        /* Set by the game to start and stop playback */
+        std::atomic<bool> running;
+
+        /* Incremented by the game each time playback is started, and set by
+         * the playback process to the same value when it is done with that
+         * playback and the device is closed */
+        std::atomic<unsigned int> session;
+        std::atomic<unsigned int> session_done;
 
-    /* Connection to the sound system */
+        /* Parameters of the device */
+        snd_pcm_format_t format;
+        int nbChannels;
+        int frequency;
+        int alignSize;
+        snd_pcm_uframes_t bufferSize;
+
+        /* Log categories, because the playback process was forked before
+         * receiving the config and keeps the default one */
+        LogCategoryFlag includeFlags;
+        LogCategoryFlag excludeFlags;
+
+        /* Size of the ring buffer of mixed samples, and total number of
+         * bytes written and read since the device was opened */
+        size_t capacity;
+        std::atomic<size_t> ring_write;
+        std::atomic<size_t> ring_read;
+
+        /* Number of device underruns and of samples dropped because the
+         * ring was full */
+        std::atomic<int> underruns;
+        std::atomic<int> overruns;
+    };
+
+    static const size_t shared_size = 512 * 1024;
+    static SharedState* shared;
+    static char* ring;
+
+    /* Values of counters that were last reported */
+    static int reported_underruns;
+    static int reported_overruns;
+
+    /* Connection to the sound system, only in the playback process */
     static snd_pcm_t *phandle;
+    static snd_pcm_uframes_t period_size;
+
+    /* Main function of the playback process */
+    static void playerMain();
+
+    /* Write samples from the ring to the device until playback is stopped */
+    static void playbackLoop();
 
-    static std::vector<char> silence;
-    
     public:
         // AudioPlayer();
         // ~AudioPlayer();
 
+        /* Allocate the memory shared with the playback process, and start
+         * the process. It must be done at startup, before any savestate is
+         * made, so that loading a state does not unmap the shared memory */
+        static void initProcess();
+
+        /* Is this memory area the one shared with the playback process */
+        static bool isSharedMemory(const void* addr, size_t size);
+
         /* Init the connection to the server.
          * Return if the connection was successful
          */
 		static bool init(snd_pcm_format_t format, int nbChannels, unsigned int frequency);
 
-        /* Play the audio buffer stored in the audio context */
+        /* Push the audio buffer stored in the audio context to the playback
+         * process. This function never blocks.
+         */
 		static bool play(AudioContext& ac);
 
-        /* Close the connection to the server */
+        /* Stop playback and close the connection to the server */
         static void close();
 };
 }
@@ -18,6 +18,7 @@
  */
 
 #include "AudioSource.h"
+#include "AudioMixer.h"
 #include <iterator>     // std::back_inserter
 #include <algorithm>    // std::copy
 #include "../logging.h"
@@ -34,8 +35,6 @@ namespace libtas {
  */
 DEFINE_ORIG_POINTER(swr_alloc)
 DEFINE_ORIG_POINTER(swr_free)
-DEFINE_ORIG_POINTER(swr_is_initialized)
-DEFINE_ORIG_POINTER(swr_close)
 DEFINE_ORIG_POINTER(swr_init)
 DEFINE_ORIG_POINTER(swr_alloc_set_opts)
 DEFINE_ORIG_POINTER(swr_convert)
@@ -67,14 +66,11 @@ AudioSource::AudioSource(void)
     }
     /* Still test if it succeeded. */
     if (!orig::swr_alloc) {
-        debuglogstdio(LCF_SOUND | LCF_ERROR, "Could not link to swr_alloc, disable audio mixing");
-        swr = nullptr;
+        debuglogstdio(LCF_SOUND | LCF_ERROR, "Could not link to swr_alloc, only mixing buffers matching the output format");
     }
     else {
         /* We link to swr_free here, because linking during destructor can softlock */
         LINK_NAMESPACE(swr_free, "swresample");
-
-        swr = orig::swr_alloc();        
     }
 
     init();
@@ -82,8 +78,10 @@ AudioSource::AudioSource(void)
 
 AudioSource::~AudioSource(void)
 {
-    if (orig::swr_free && swr)
-        orig::swr_free(&swr);
+    if (orig::swr_free) {
+        for (auto& resampler : resamplers)
+            orig::swr_free(&resampler.swr);
+    }
 }
 
 void AudioSource::init(void)
@@ -107,12 +105,106 @@ void AudioSource::rewind(void)
 
 void AudioSource::dirty(void)
 {
-    if (swr) {
-        LINK_NAMESPACE(swr_is_initialized, "swresample");
-        LINK_NAMESPACE(swr_close, "swresample");
-        if (orig::swr_is_initialized(swr))
-            orig::swr_close(swr);
+    for (auto& resampler : resamplers)
+        resampler.flush = true;
+}
+
+struct SwrContext* AudioSource::getResampler(const AudioBuffer& buffer, int outNbChannels, int outFrequency)
+{
+    if (!orig::swr_alloc)
+        return nullptr;
+
+    int frequency = static_cast<int>(buffer.frequency*pitch);
+
+    /* MS-ADPCM buffers are decoded into signed 16-bit samples */
+    AudioBuffer::SampleFormat format = buffer.format;
+    if (format == AudioBuffer::SAMPLE_FMT_MSADPCM)
+        format = AudioBuffer::SAMPLE_FMT_S16;
+
+    for (auto it = resamplers.begin(); it != resamplers.end(); it++) {
+        if ((it->format == format) && (it->nbChannels == buffer.nbChannels) &&
+            (it->frequency == frequency) && (it->outNbChannels == outNbChannels) &&
+            (it->outFrequency == outFrequency)) {
+
+            if (it->flush) {
+                /* Drain the buffered samples */
+                mixedSamples.resize(1024 * outNbChannels);
+                uint8_t* begMixed = reinterpret_cast<uint8_t*>(mixedSamples.data());
+                while (orig::swr_convert(it->swr, &begMixed, 1024, nullptr, 0) > 0) {}
+                it->flush = false;
+            }
+
+            /* Move the context to the front */
+            std::rotate(resamplers.begin(), it, it + 1);
+            return resamplers.front().swr;
+        }
+    }
+
+    /* Get the sample format */
+    AVSampleFormat inFormat = AV_SAMPLE_FMT_U8;
+
+    /* Samples are always converted to signed 16-bit for the mixing
+     * bus, the output format is only applied after mixing */
+    AVSampleFormat outFormat = AV_SAMPLE_FMT_S16;
+    switch (format) {
+        case AudioBuffer::SAMPLE_FMT_U8:
+            inFormat = AV_SAMPLE_FMT_U8;
+            break;
+        case AudioBuffer::SAMPLE_FMT_S16:
+            inFormat = AV_SAMPLE_FMT_S16;
+            break;
+        case AudioBuffer::SAMPLE_FMT_S32:
+            inFormat = AV_SAMPLE_FMT_S32;
+            break;
+        case AudioBuffer::SAMPLE_FMT_FLT:
+            inFormat = AV_SAMPLE_FMT_FLT;
+            break;
+        case AudioBuffer::SAMPLE_FMT_DBL:
+            inFormat = AV_SAMPLE_FMT_DBL;
+            break;
+        default:
+            debuglogstdio(LCF_SOUND | LCF_ERROR, "Unknown sample format");
+            break;
+    }
+
+    /* Get the channel layout */
+    int64_t in_ch_layout = 0;
+    int64_t out_ch_layout = 0;
+
+    if (buffer.nbChannels == 1) {
+        in_ch_layout = AV_CH_LAYOUT_MONO;
     }
+    if (buffer.nbChannels == 2) {
+        in_ch_layout = AV_CH_LAYOUT_STEREO;
+    }
+    if (outNbChannels == 1) {
+        out_ch_layout = AV_CH_LAYOUT_MONO;
+    }
+    if (outNbChannels == 2) {
+        out_ch_layout = AV_CH_LAYOUT_STEREO;
+    }
+
+    struct SwrContext *swr = orig::swr_alloc();
+    MYASSERT(nullptr != orig::swr_alloc_set_opts(swr, out_ch_layout, outFormat, outFrequency, in_ch_layout, inFormat, frequency, 0, nullptr));
+
+    /* Open the context */
+    if (orig::swr_init(swr) < 0) {
+        debuglogstdio(LCF_SOUND | LCF_ERROR, "Error initializing swr context");
+        orig::swr_free(&swr);
+        return nullptr;
+    }
+
+    debuglogstdio(LCF_SOUND, "  New resample context from %d Hz to %d Hz", frequency, outFrequency);
+
+    /* Evict the least recently used context */
+    if (static_cast<int>(resamplers.size()) >= max_resamplers) {
+        orig::swr_free(&resamplers.back().swr);
+        resamplers.pop_back();
+    }
+
+    Resampler resampler = {format, buffer.nbChannels, frequency, outNbChannels, outFrequency, false, swr};
+    resamplers.insert(resamplers.begin(), resampler);
+    return swr;
 }
 
 int AudioSource::nbQueue()
@@ -201,10 +293,9 @@ bool AudioSource::willEnd(struct timespec ticks)
 }
 
 
-int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outBytes, int outBitDepth, int outNbChannels, int outFrequency, float outVolume)
+int AudioSource::mixWith( struct timespec ticks, int32_t* outBus, int outNbSamples, int outNbChannels, int outFrequency, float outVolume)
 {
-    if (swr) {
-        LINK_NAMESPACE(swr_is_initialized, "swresample");
+    if (orig::swr_alloc) {
         LINK_NAMESPACE(swr_init, "swresample");
         LINK_NAMESPACE(swr_convert, "swresample");
         LINK_NAMESPACE(swr_alloc_set_opts, "swresample");
@@ -218,72 +309,27 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
 
     debuglogstdio(LCF_SOUND, "Start mixing source %d", id);
 
-    bool skipMixing = (!swr) || 
-                        (!shared_config.av_dumping && 
+    bool skipMixing = !shared_config.av_dumping && 
                             (shared_config.audio_mute ||
                                 (shared_config.fastforward && 
-                                    (shared_config.fastforward_mode & SharedConfig::FF_MIXING))));
+                                    (shared_config.fastforward_mode & SharedConfig::FF_MIXING)));
 
     std::shared_ptr<AudioBuffer> curBuf = buffer_queue[queue_index];
 
+    /* If the buffer already matches the bus format, samples are mixed
+     * directly without going through a resample context. All buffers of a
+     * queue share the same format, so we only check the current one. */
+    struct SwrContext *swr = nullptr;
     if (!skipMixing) {
-        /* Check if SWR context is initialized.
-         * If not, set parameters and init it
-         */
-        if (! orig::swr_is_initialized(swr)) {
-            /* Get the sample format */
-            AVSampleFormat inFormat = AV_SAMPLE_FMT_U8;
-            AVSampleFormat outFormat = AV_SAMPLE_FMT_U8;
-            switch (curBuf->format) {
-                case AudioBuffer::SAMPLE_FMT_U8:
-                    inFormat = AV_SAMPLE_FMT_U8;
-                    break;
-                case AudioBuffer::SAMPLE_FMT_S16:
-                case AudioBuffer::SAMPLE_FMT_MSADPCM:
-                    inFormat = AV_SAMPLE_FMT_S16;
-                    break;
-                case AudioBuffer::SAMPLE_FMT_S32:
-                    inFormat = AV_SAMPLE_FMT_S32;
-                    break;
-                case AudioBuffer::SAMPLE_FMT_FLT:
-                    inFormat = AV_SAMPLE_FMT_FLT;
-                    break;
-                case AudioBuffer::SAMPLE_FMT_DBL:
-                    inFormat = AV_SAMPLE_FMT_DBL;
-                    break;
-                default:
-                    debuglogstdio(LCF_SOUND | LCF_ERROR, "Unknown sample format");
-                    break;
-            }
-            if (outBitDepth == 8)
-                outFormat = AV_SAMPLE_FMT_U8;
-            if (outBitDepth == 16)
-                outFormat = AV_SAMPLE_FMT_S16;
-
-            /* Get the channel layout */
-            int64_t in_ch_layout = 0;
-            int64_t out_ch_layout = 0;
-
-            if (curBuf->nbChannels == 1) {
-                in_ch_layout = AV_CH_LAYOUT_MONO;
-            }
-            if (curBuf->nbChannels == 2) {
-                in_ch_layout = AV_CH_LAYOUT_STEREO;
-            }
-            if (outNbChannels == 1) {
-                out_ch_layout = AV_CH_LAYOUT_MONO;
-            }
-            if (outNbChannels == 2) {
-                out_ch_layout = AV_CH_LAYOUT_STEREO;
-            }
-
-            MYASSERT(nullptr != orig::swr_alloc_set_opts(swr, out_ch_layout, outFormat, outFrequency, in_ch_layout, inFormat, static_cast<int>(curBuf->frequency*pitch), 0, nullptr));
-
-            /* Open the context */
-            if (orig::swr_init(swr) < 0) {
-                debuglogstdio(LCF_SOUND | LCF_ERROR, "Error initializing swr context");
-                return 0;
-            }
+        bool directMix = ((curBuf->format == AudioBuffer::SAMPLE_FMT_S16) ||
+                          (curBuf->format == AudioBuffer::SAMPLE_FMT_MSADPCM)) &&
+                         (curBuf->nbChannels == outNbChannels) &&
+                         (static_cast<int>(curBuf->frequency*pitch) == outFrequency);
+
+        if (!directMix) {
+            swr = getResampler(*curBuf, outNbChannels, outFrequency);
+            if (!swr)
+                skipMixing = true;
         }
     }
 
@@ -305,11 +351,29 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
     int newPosition = position + inNbSamples;
 
     /* Allocate the mixed audio array */
-    int outNbSamples = outBytes / (outNbChannels * outBitDepth / 8);
-    mixedSamples.resize(outBytes);
-    uint8_t* begMixed = mixedSamples.data();
+    mixedSamples.resize(outNbSamples * outNbChannels);
+    uint8_t* begMixed = reinterpret_cast<uint8_t*>(mixedSamples.data());
 
     int convOutSamples = 0;
+
+    /* Send samples to the resample context, or mix them directly into the
+     * bus. Direct mixing must be done right away, because the callback may
+     * overwrite the buffer content. */
+    auto pushSamples = [&](uint8_t* samples, int nbSamples) {
+        if (skipMixing || (nbSamples <= 0))
+            return;
+
+        if (swr) {
+            orig::swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&samples), nbSamples);
+            return;
+        }
+
+        int nbMixed = std::min(nbSamples, outNbSamples - convOutSamples);
+        if (nbMixed > 0) {
+            AudioMixer::mixS16(outBus + convOutSamples*outNbChannels, reinterpret_cast<int16_t*>(samples), nbMixed*outNbChannels, outNbChannels, lvas, rvas);
+            convOutSamples += nbMixed;
+        }
+    };
     uint8_t* begSamples;
     int availableSamples = curBuf->getSamples(begSamples, inNbSamples, oldPosition, (source == SOURCE_STATIC) && looping);
 
@@ -318,17 +382,17 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
 
         position = newPosition;
         debuglogstdio(LCF_SOUND, "  Buffer %d in read in range %d - %d", curBuf->id, oldPosition, position);
-        if (!skipMixing) {
+        if (swr) {
             convOutSamples = orig::swr_convert(swr, &begMixed, outNbSamples, const_cast<const uint8_t**>(&begSamples), inNbSamples);
         }
+        else {
+            pushSamples(begSamples, inNbSamples);
+        }
     }
     else {
         /* We reached the end of the buffer */
         debuglogstdio(LCF_SOUND, "  Buffer %d is read from %d to its end %d", curBuf->id, oldPosition, curBuf->sampleSize);
-        if (!skipMixing) {
-            if (availableSamples > 0)
-                orig::swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
-        }
+        pushSamples(begSamples, availableSamples);
 
         int remainingSamples = inNbSamples - availableSamples;
         if (source == SOURCE_CALLBACK) {
@@ -345,9 +409,7 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
                 callback(*curBuf);
                 detTimer.fakeAdvanceTimer({0, 0});
                 availableSamples = curBuf->getSamples(begSamples, remainingSamples, 0, false);
-                if (!skipMixing) {
-                    orig::swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
-                }
+                pushSamples(begSamples, availableSamples);
 
                 debuglogstdio(LCF_SOUND, "  Buffer %d is read again from 0 to %d", curBuf->id, availableSamples);
                 if (remainingSamples == availableSamples)
@@ -355,7 +417,7 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
                 remainingSamples -= availableSamples;
             }
 
-            if (!skipMixing) {
+            if (swr) {
                 /* Get the mixed samples */
                 convOutSamples = orig::swr_convert(swr, &begMixed, outNbSamples, nullptr, 0);
             }
@@ -372,9 +434,7 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
                     availableSamples = loopbuf->getSamples(begSamples, remainingSamples, loopbuf->loop_point_beg, (source == SOURCE_STATIC) && looping);
                     debuglogstdio(LCF_SOUND, "  Buffer %d in read in range %d - %d", loopbuf->id, loopbuf->loop_point_beg, availableSamples);
 
-                    if (!skipMixing) {
-                        orig::swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
-                    }
+                    pushSamples(begSamples, availableSamples);
 
                     if (remainingSamples == availableSamples) {
                         finalIndex = i;
@@ -389,9 +449,7 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
                     availableSamples = loopbuf->getSamples(begSamples, remainingSamples, 0, false);
                     debuglogstdio(LCF_SOUND, "  Buffer %d in read in range 0 - %d", loopbuf->id, availableSamples);
 
-                    if (!skipMixing) {
-                        orig::swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
-                    }
+                    pushSamples(begSamples, availableSamples);
 
                     if (remainingSamples == availableSamples) {
                         finalIndex = i;
@@ -401,7 +459,7 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
                 }
             }
 
-            if (!skipMixing) {
+            if (swr) {
                 /* Get the mixed samples */
                 convOutSamples = orig::swr_convert(swr, &begMixed, outNbSamples, nullptr, 0);
             }
@@ -429,52 +487,9 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
 
     }
 
-    if (!skipMixing) {
-        #define clamptofullsignedrange(x,lo,hi) ((static_cast<unsigned int>((x)-(lo))<=static_cast<unsigned int>((hi)-(lo)))?(x):(((x)<0)?(lo):(hi)))
-
-        int nbSaturate = 0;
-
-        /* Add mixed source to the output buffer */
-        if (outBitDepth == 8) {
-            for (int s=0; s<convOutSamples*outNbChannels; s+=outNbChannels) {
-                int myL = mixedSamples[s];
-                int otherL = outSamples[s];
-                int sumL = otherL + ((myL * lvas) >> 16) - 256;
-                outSamples[s] = clamptofullsignedrange(sumL, 0, UINT8_MAX);
-                nbSaturate += (sumL < 0) || (sumL > UINT8_MAX);
-
-                if (outNbChannels == 2) {
-                    int myR = mixedSamples[s+1];
-                    int otherR = outSamples[s+1];
-                    int sumR = otherR + ((myR * rvas) >> 16) - 256;
-                    outSamples[s+1] = clamptofullsignedrange(sumR, 0, UINT8_MAX);
-                    nbSaturate += (sumR < 0) || (sumR > UINT8_MAX);
-                }
-            }
-        }
-
-        if (outBitDepth == 16) {
-            int16_t* mixedSamples16 = reinterpret_cast<int16_t*>(mixedSamples.data());
-            int16_t* outSamples16 = reinterpret_cast<int16_t*>(outSamples);
-            for (int s=0; s<convOutSamples*outNbChannels; s+=outNbChannels) {
-                int myL = mixedSamples16[s];
-                int otherL = outSamples16[s];
-                int sumL = otherL + ((myL * lvas) >> 16);
-                outSamples16[s] = clamptofullsignedrange(sumL, INT16_MIN, INT16_MAX);
-                nbSaturate += (sumL < INT16_MIN) || (sumL > INT16_MAX);
-
-                if (outNbChannels == 2) {
-                    int myR = mixedSamples16[s+1];
-                    int otherR = outSamples16[s+1];
-                    int sumR = otherR + ((myR * rvas) >> 16);
-                    outSamples16[s+1] = clamptofullsignedrange(sumR, INT16_MIN, INT16_MAX);
-                    nbSaturate += (sumR < INT16_MIN) || (sumR > INT16_MAX);
-                }
-            }
-        }
-        
-        if (nbSaturate > 0)
-            debuglogstdio(LCF_SOUND | LCF_WARNING, "Saturation during mixing for %d samples", nbSaturate);        
+    if (swr && (convOutSamples > 0)) {
+        /* Add resampled source to the mixing bus */
+        AudioMixer::mixS16(outBus, mixedSamples.data(), convOutSamples*outNbChannels, outNbChannels, lvas, rvas);
     }
 
     return convOutSamples;
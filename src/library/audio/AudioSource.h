@@ -111,11 +111,33 @@ class AudioSource
         /* Indicate the current position in the buffer queue */
         int queue_index;
 
-        /* Context for resampling audio */
-        struct SwrContext *swr;
+        /* Initialized resampling context for a given input and output format */
+        struct Resampler {
+            AudioBuffer::SampleFormat format;
+            int nbChannels;
+            int frequency;
+            int outNbChannels;
+            int outFrequency;
+
+            /* Buffered samples must be discarded before next use */
+            bool flush;
+
+            struct SwrContext *swr;
+        };
+
+        /* Cache of resampling contexts, so that changing buffers or playing
+         * the source again does not initialize a new context each time.
+         * Most recently used context is at the front.
+         */
+        std::vector<Resampler> resamplers;
+        static const int max_resamplers = 4;
+
+        /* Get an initialized resampling context converting the buffer into
+         * the output format, or nullptr if it could not be created */
+        struct SwrContext* getResampler(const AudioBuffer& buffer, int outNbChannels, int outFrequency);
 
-        /* Temporary array of mixed samples */
-        std::vector<uint8_t> mixedSamples;
+        /* Temporary array of converted samples, in signed 16-bit */
+        std::vector<int16_t> mixedSamples;
 
         /* In case of callback type, callback function.
          * We send as an argument a pointer to the buffer to refill.
@@ -133,7 +155,8 @@ class AudioSource
         /* Rewind source to the beginning of the first buffer */
         void rewind();
 
-        /* Some parameters have changed, so we must set a new resample context */
+        /* Playback position has changed, so we must discard the samples
+         * buffered by the resample contexts */
         void dirty();
 
         /* Returns the number of buffers in its queue */
@@ -165,11 +188,12 @@ class AudioSource
         /* Check if reading a number of ticks will reach the end of the source */
         bool willEnd(struct timespec ticks);
 
-        /* Mix the buffer with an external buffer of the given format.
+        /* Mix the buffer into the mixing bus of the audio context, which
+         * stores 32-bit sums of signed 16-bit samples.
          * The number of samples to mix correspond to the number of ticks given.
-         * The function returns the number of samples written in the output buffer.
+         * The function returns the number of samples written in the bus.
          */
-        int mixWith( struct timespec ticks, uint8_t* outSamples, int outBytes, int outBitDepth, int outNbChannels, int outFrequency, float outVolume);
+        int mixWith( struct timespec ticks, int32_t* outBus, int outNbSamples, int outNbChannels, int outFrequency, float outVolume);
 };
 }
 
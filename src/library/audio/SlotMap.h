@@ -0,0 +1,120 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SLOTMAP_H_INCL
+#define LIBTAS_SLOTMAP_H_INCL
+
+#include <vector>
+#include <memory>
+
+namespace libtas {
+/* Container of audio objects indexed by their id, used by the audio context
+ * for buffers and sources.
+ *
+ * Ids start at 1 (0 is reserved for no object) and directly index the slot
+ * of each object, so that lookups are constant time. Objects that are alive
+ * are also stored contiguously, so that they can be iterated quickly.
+ *
+ * Deleted objects are kept in their slot and are recycled with the same id
+ * on the next creation, the most recently deleted first.
+ */
+template<typename T>
+class SlotMap
+{
+    public:
+        /* Create or recycle an object, or return nullptr if there are
+         * already `max` objects alive */
+        std::shared_ptr<T> create(size_t max)
+        {
+            if (live.size() >= max)
+                return nullptr;
+
+            int id;
+            if (!pool.empty()) {
+                id = pool.back();
+                pool.pop_back();
+            }
+            else {
+                slots.push_back(std::make_shared<T>());
+                live_index.push_back(-1);
+                id = slots.size();
+                slots.back()->id = id;
+            }
+
+            live_index[id-1] = live.size();
+            live.push_back(slots[id-1]);
+            return slots[id-1];
+        }
+
+        /* Delete the object of the corresponding id, and keep it for
+         * recycling */
+        void remove(int id)
+        {
+            if (!contains(id))
+                return;
+
+            /* Move the last alive object in place of the deleted one */
+            int index = live_index[id-1];
+            live[index] = live.back();
+            live_index[live[index]->id-1] = index;
+            live.pop_back();
+
+            live_index[id-1] = -1;
+            pool.push_back(id);
+        }
+
+        /* Returns if an id correspond to an alive object */
+        bool contains(int id) const
+        {
+            return (id > 0) && (id <= static_cast<int>(slots.size())) && (live_index[id-1] >= 0);
+        }
+
+        /* Return the object of requested id, or nullptr if not alive */
+        std::shared_ptr<T> get(int id) const
+        {
+            if (!contains(id))
+                return nullptr;
+            return slots[id-1];
+        }
+
+        /* Number of alive objects */
+        size_t size() const {return live.size();}
+
+        /* Access to alive objects, in no particular order */
+        const std::shared_ptr<T>& operator[](size_t i) const {return live[i];}
+        typename std::vector<std::shared_ptr<T>>::const_iterator begin() const {return live.begin();}
+        typename std::vector<std::shared_ptr<T>>::const_iterator end() const {return live.end();}
+
+    private:
+        /* All objects ever created, indexed by id-1 */
+        std::vector<std::shared_ptr<T>> slots;
+
+        /* Index of each object inside the array of alive objects, or -1 */
+        std::vector<int> live_index;
+
+        /* Alive objects */
+        std::vector<std::shared_ptr<T>> live;
+
+        /* Ids of deleted objects that can be recycled */
+        std::vector<int> pool;
+};
+
+}
+
+#endif
@@ -677,6 +677,7 @@ snd_pcm_sframes_t snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_ufr
     ab->samples.insert(ab->samples.end(), static_cast<const uint8_t*>(buffer), &(static_cast<const uint8_t*>(buffer))[ab->size]);
 
     source->buffer_queue.push_back(ab);
+    audiocontext.sourceFilled.notify();
 
     return static_cast<snd_pcm_sframes_t>(size);
 }
@@ -781,6 +782,7 @@ snd_pcm_sframes_t snd_pcm_mmap_commit(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
     int sourceId = reinterpret_cast<intptr_t>(pcm);
     auto source = audiocontext.getSource(sourceId);
     source->buffer_queue.push_back(mmap_ab);
+    audiocontext.sourceFilled.notify();
 
     /* We should unlock the audio mutex here, but we don't (see above comment) */
     // audiocontext.mutex.unlock();
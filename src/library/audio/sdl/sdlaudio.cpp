@@ -389,6 +389,7 @@ void SDL_MixAudio(Uint8 * dst, const Uint8 * src, Uint32 len, int volume)
     ab->size = len;
     ab->update();
     sourcesSDL[dev-1]->buffer_queue.push_back(ab);
+    audiocontext.sourceFilled.notify();
 
     return 0;
 }
@@ -43,6 +43,7 @@
 #include "../../external/xcbint.h"
 #include "../renderhud/RenderHUD.h"
 #include "ReservedMemory.h"
+#include "../audio/AudioPlayer.h"
 #include "SaveState.h"
 #include "../../external/lz4.h"
 #include "../../shared/sockethelpers.h"
@@ -393,6 +394,11 @@ static bool skipArea(const Area *area)
         return true;
     }
 
+    /* Don't save the memory shared with the audio playback process */
+    if (AudioPlayer::isSharedMemory(area->addr, area->size)) {
+        return true;
+    }
+
     /* Save area if write permission */
     if (area->prot & PROT_WRITE) {
         return false;
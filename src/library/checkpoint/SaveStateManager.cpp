@@ -25,6 +25,11 @@
 #include <sys/mman.h>
 #include <sys/syscall.h> // syscall, SYS_gettid
 #include <sys/wait.h> // waitpid
+#include <linux/futex.h> // FUTEX_WAIT_PRIVATE
+#include <unistd.h> // syscall
+#include <climits> // INT_MAX
+#include <atomic>
+#include <new> // placement new
 
 #include "SaveStateManager.h"
 #include "ThreadManager.h"
@@ -33,6 +38,7 @@
 #include "../timewrappers.h" // clock_gettime
 #include "../logging.h"
 #include "../audio/AudioPlayer.h"
+#include "../AsyncLogger.h"
 #include "AltStack.h"
 #include "ReservedMemory.h"
 #include "../fileio/FileHandleList.h"
@@ -40,11 +46,18 @@
 
 namespace libtas {
 
-static sem_t semNotifyCkptThread;
-static sem_t semWaitForCkptThreadSignal;
-static pthread_mutex_t threadResumeLock = PTHREAD_MUTEX_INITIALIZER;
+/* Barrier used to suspend and resume all threads. It is stored in reserved
+ * memory, so that it is not modified when loading a savestate */
+struct SuspendBarrier {
+    std::atomic<int> arrived; // number of threads that are suspended
+    std::atomic<int> expected; // number of threads that were signaled
+    std::atomic<int> generation; // incremented each time threads are resumed
+    std::atomic<int> restored; // number of threads that were resumed
+    std::atomic<int> released; // incremented when all threads were resumed
+};
+
+static SuspendBarrier* barrier;
 static volatile bool restoreInProgress = false;
-static int numThreads;
 static int sig_suspend_threads = SIGXFSZ;
 static int sig_checkpoint = SIGSYS;
 static bool* state_dirty;
@@ -61,11 +74,11 @@ int SaveStateManager::sigSuspend()
 
 void SaveStateManager::init()
 {
-    sem_init(&semNotifyCkptThread, 0, 0);
-    sem_init(&semWaitForCkptThreadSignal, 0, 0);
-
     ReservedMemory::init();
 
+    static_assert(sizeof(SuspendBarrier) <= ReservedMemory::SS_SYNC_SIZE, "Suspend barrier does not fit in reserved memory");
+    barrier = new (ReservedMemory::getAddr(ReservedMemory::SS_SYNC_ADDR)) SuspendBarrier();
+
     state_dirty = static_cast<bool*>(ReservedMemory::getAddr(ReservedMemory::SS_SLOTS_ADDR));
     memset(state_dirty, 0, 11*sizeof(bool));
 }
@@ -174,10 +187,9 @@ int SaveStateManager::checkpoint(int slot)
 
     restoreInProgress = false;
 
-    /* We must close the connection to the sound device. This must be done
-     * BEFORE suspending threads.
-     */
-    AudioPlayer::close();
+    /* The log writer thread must not run while threads are suspended and
+     * memory is restored */
+    AsyncLogger::stop();
 
     /* Perform a series of checks before attempting to checkpoint */
     int ret = Checkpoint::checkCheckpoint();
@@ -231,7 +243,7 @@ int SaveStateManager::checkpoint(int slot)
 
     /* Wait for all other threads to finish being restored before resuming */
     debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Waiting for other threads to resume");
-    waitForAllRestored(current_thread);
+    waitForAllRestored();
     debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Resuming main thread");
 
     ThreadSync::releaseLocks();
@@ -252,10 +264,9 @@ int SaveStateManager::restore(int slot)
     MYASSERT(current_thread->state == ThreadInfo::ST_CKPNTHREAD)
     ThreadSync::acquireLocks();
 
-    /* We must close the connection to the sound device. This must be done
-     * BEFORE suspending threads.
-     */
-    AudioPlayer::close();
+    /* The log writer thread must not run while threads are suspended and
+     * memory is restored */
+    AsyncLogger::stop();
 
     /* Perform a series of checks before attempting to restore */
     int ret = Checkpoint::checkRestore();
@@ -308,150 +319,158 @@ int SaveStateManager::restore(int slot)
 
      resumeThreads();
 
-     waitForAllRestored(current_thread);
+     waitForAllRestored();
 
      ThreadSync::releaseLocks();
 
      return ESTATE_UNKNOWN;
 }
 
+/* Futex operations on the words of the suspend barrier */
+static void futexWait(std::atomic<int>* addr, int val, const struct timespec* timeout = nullptr)
+{
+    syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAIT_PRIVATE, val, timeout, nullptr, 0);
+}
+
+static void futexWake(std::atomic<int>* addr)
+{
+    syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static int elapsedMicros(const struct timespec& from, const struct timespec& to)
+{
+    return (to.tv_sec - from.tv_sec) * 1000000 + (to.tv_nsec - from.tv_nsec) / 1000;
+}
+
 void SaveStateManager::suspendThreads()
 {
-    MYASSERT(pthread_mutex_destroy(&threadResumeLock) == 0)
-    MYASSERT(pthread_mutex_init(&threadResumeLock, NULL) == 0)
-    MYASSERT(pthread_mutex_lock(&threadResumeLock) == 0)
-
-    /* Halt all other threads - force them to call stopthisthread
-    * If any have blocked checkpointing, wait for them to unblock before
-    * signalling
-    */
-    ThreadManager::lockList();
+    barrier->arrived = 0;
+    barrier->expected = INT_MAX;
 
-    bool needrescan = false;
-    do {
-        needrescan = false;
-        numThreads = 0;
-        ThreadInfo *next;
-        for (ThreadInfo *thread = ThreadManager::getThreadList(); thread != nullptr; thread = next) {
-            debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Signaling thread %d", thread->tid);
-            next = thread->next;
-            int ret;
+    struct timespec start_time;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &start_time));
 
-            /* Do various things based on thread's state */
-            switch (thread->state) {
-            case ThreadInfo::ST_RUNNING:
-            case ThreadInfo::ST_ZOMBIE:
-            case ThreadInfo::ST_FREE:
-
-                /* Thread is running. Send it a signal so it will call stopthisthread.
-                * We will need to rescan (hopefully it will be suspended by then)
-                */
-                thread->orig_state = thread->state;
-                if (ThreadManager::updateState(thread, ThreadInfo::ST_SIGNALED, thread->state)) {
-
-                    /* Setup an alternate signal stack.
-                     *
-                     * This is a workaround for a bug when loading a savestate
-                     * which involves the stack pointer.
-                     * During a state loading, the main thread restores the
-                     * memory of the thread stacks, then resume the threads, and
-                     * each thread restore its registers.
-                     * If the stack pointer had changed, the thread is resumed
-                     * with a corrupted stack (old stack pointer, new stack memory)
-                     * and cannot reach the function to restore its stack pointer.
-                     *
-                     * The workaround is to run our signal handler function on
-                     * an alternate stack (different for each thread).
-                     * This way, this stack pointer will be the same.
-                     */
-
-                    // NATIVECALL(ret = sigaltstack(&thread->altstack, nullptr));
-                    // if (ret < 0) {
-                    //     debuglog(LCF_THREAD | LCF_CHECKPOINT | LCF_ERROR, "sigaltstack failed with error ", ret);
-                    // }
-                    // else {
-                    //     debuglog(LCF_THREAD | LCF_CHECKPOINT | LCF_ERROR, "sigaltstack with add ", thread->altstack.ss_sp);
-                    // }
-                    // struct sigaction sigusr1;
-                    // sigfillset(&sigusr1.sa_mask);
-                    // sigusr1.sa_flags = SA_RESTART | SA_ONSTACK;
-                    // sigusr1.sa_handler = stopThisThread;
-                    // {
-                    //     GlobalNative gn;
-                    //     MYASSERT(sigaction(SIGUSR1, &sigusr1, nullptr) == 0)
-                    // }
-
-                    /* Send the suspend signal to the thread */
-                    NATIVECALL(ret = pthread_kill(thread->pthread_id, sig_suspend_threads));
-
-                    if (ret == 0) {
-                        needrescan = true;
-                    }
-                    else {
-                        MYASSERT(ret == ESRCH)
-                        debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Thread %d has died since", thread->tid);
-                        ThreadManager::threadIsDead(thread);
-                    }
-                }
-                break;
+    /* Halt all other threads - force them to call stopthisthread.
+     * Signals are sent to all threads in a single pass, then we wait for
+     * all of them to arrive at the barrier.
+     */
+    ThreadManager::lockList();
 
-            case ThreadInfo::ST_SIGNALED:
-                NATIVECALL(ret = pthread_kill(thread->pthread_id, 0));
+    int numThreads = 0;
+    ThreadInfo *next;
+    for (ThreadInfo *thread = ThreadManager::getThreadList(); thread != nullptr; thread = next) {
+        next = thread->next;
+        int ret;
+
+        /* Do various things based on thread's state */
+        switch (thread->state) {
+        case ThreadInfo::ST_RUNNING:
+        case ThreadInfo::ST_ZOMBIE:
+        case ThreadInfo::ST_FREE:
+
+            /* Thread is running. Send it a signal so it will call stopthisthread. */
+            thread->orig_state = thread->state;
+            if (ThreadManager::updateState(thread, ThreadInfo::ST_SIGNALED, thread->state)) {
+
+                /* Send the suspend signal to the thread. The signal handler
+                 * runs on an alternate stack (different for each thread),
+                 * so that the stack pointer is identical when resuming the
+                 * thread after a state loading, as the thread stack memory
+                 * has been replaced.
+                 */
+                debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Signaling thread %d", thread->tid);
+                NATIVECALL(ret = pthread_kill(thread->pthread_id, sig_suspend_threads));
 
                 if (ret == 0) {
-                    needrescan = true;
+                    numThreads++;
                 }
                 else {
                     MYASSERT(ret == ESRCH)
-                    debuglogstdio(LCF_ERROR | LCF_THREAD | LCF_CHECKPOINT, "Signalled thread %d died", thread->tid);
+                    debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Thread %d has died since", thread->tid);
                     ThreadManager::threadIsDead(thread);
                 }
-                break;
-
-            case ThreadInfo::ST_SUSPINPROG:
-                numThreads++;
-                break;
+            }
+            break;
 
-            case ThreadInfo::ST_SUSPENDED:
-                numThreads++;
-                break;
+        case ThreadInfo::ST_CKPNTHREAD:
+        case ThreadInfo::ST_UNINITIALIZED:
+        case ThreadInfo::ST_RECYCLED:
+            break;
 
-            case ThreadInfo::ST_CKPNTHREAD:
-                break;
+        default:
+            debuglogstdio(LCF_ERROR | LCF_THREAD | LCF_CHECKPOINT, "Unexpected thread state %d", thread->state);
+        }
+    }
 
-            // case ThreadInfo::ST_FAKEZOMBIE:
-            //     break;
+    barrier->expected = numThreads;
 
-            case ThreadInfo::ST_UNINITIALIZED:
-                break;
+    ThreadManager::unlockList();
 
-            case ThreadInfo::ST_RECYCLED:
-                break;
+    /* Wait for all signaled threads to be suspended. The last thread to
+     * arrive wakes us up. We periodically check that no signaled thread
+     * has died before handling the signal.
+     */
+    int arrived;
+    while ((arrived = barrier->arrived) < numThreads) {
+        struct timespec timeout = { 0, 10 * 1000 * 1000 };
+        futexWait(&barrier->arrived, arrived, &timeout);
+        if (barrier->arrived >= numThreads)
+            break;
+
+        ThreadManager::lockList();
+        for (ThreadInfo *thread = ThreadManager::getThreadList(); thread != nullptr; thread = next) {
+            next = thread->next;
+            if (thread->state != ThreadInfo::ST_SIGNALED)
+                continue;
 
-            default:
-                debuglogstdio(LCF_ERROR | LCF_THREAD | LCF_CHECKPOINT, "Unknown thread state %d", thread->state);
+            int ret;
+            NATIVECALL(ret = pthread_kill(thread->pthread_id, 0));
+            if (ret == 0) {
+                debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Still waiting for thread %d", thread->tid);
+            }
+            else {
+                MYASSERT(ret == ESRCH)
+                debuglogstdio(LCF_ERROR | LCF_THREAD | LCF_CHECKPOINT, "Signalled thread %d died", thread->tid);
+                ThreadManager::threadIsDead(thread);
+                numThreads--;
+                barrier->expected = numThreads;
             }
         }
-        if (needrescan) {
-            struct timespec sleepTime = { 0, 10 * 1000 };
-            NATIVECALL(nanosleep(&sleepTime, NULL));
-        }
-    } while (needrescan);
+        ThreadManager::unlockList();
+    }
 
-    ThreadManager::unlockList();
+    if (isLogEnabled(LCF_THREAD | LCF_CHECKPOINT)) {
+        struct timespec end_time;
+        NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &end_time));
+
+        /* Report how long each thread took to be suspended */
+        int slowest_tid = 0;
+        int slowest_time = -1;
+        ThreadManager::lockList();
+        for (ThreadInfo *thread = ThreadManager::getThreadList(); thread != nullptr; thread = thread->next) {
+            if (thread->state != ThreadInfo::ST_SUSPENDED)
+                continue;
+            int park_time = elapsedMicros(start_time, thread->park_time);
+            debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Thread %d suspended after %d us", thread->tid, park_time);
+            if (park_time > slowest_time) {
+                slowest_time = park_time;
+                slowest_tid = thread->tid;
+            }
+        }
+        ThreadManager::unlockList();
 
-    for (int i = 0; i < numThreads; i++) {
-        sem_wait(&semNotifyCkptThread);
+        debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "%d threads were suspended in %d us", numThreads, elapsedMicros(start_time, end_time));
+        if (slowest_time >= 0)
+            debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Slowest thread was %d with %d us", slowest_tid, slowest_time);
     }
-
-    debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "%d threads were suspended", numThreads);
 }
 
 /* Resume all threads. */
 void SaveStateManager::resumeThreads()
 {
     debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Resuming all threads");
-    MYASSERT(pthread_mutex_unlock(&threadResumeLock) == 0)
+    barrier->generation++;
+    futexWake(&barrier->generation);
     debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "All threads resumed");
 }
 
@@ -488,23 +507,24 @@ void SaveStateManager::stopThisThread(int signum)
              * Wait for ckpt thread to write ckpt, and resume.
              */
 
-            /* Tell the checkpoint thread that we're all saved away */
+            /* Tell the checkpoint thread that we're all saved away. The
+             * resume generation must be read before arriving at the barrier,
+             * so that we cannot miss the resume.
+             */
             MYASSERT(ThreadManager::updateState(current_thread, ThreadInfo::ST_SUSPENDED, ThreadInfo::ST_SUSPINPROG))
-            sem_post(&semNotifyCkptThread);
-
-            /* Then wait for the ckpt thread to write the ckpt file then wake us up */
+            NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &current_thread->park_time));
+            int generation = barrier->generation;
+            if (++barrier->arrived >= barrier->expected)
+                futexWake(&barrier->arrived);
+
+            /* Then wait for the ckpt thread to write the ckpt file then wake us up.
+             * The generation counter is not part of the savestate, so it
+             * keeps increasing after a state loading.
+             */
             debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Thread suspended");
 
-            // sigset_t mask;
-            // sigemptyset(&mask);
-            // sigaddset(&mask, SIGTRAP);
-            // NATIVECALL(pthread_sigmask(SIG_UNBLOCK, &mask, nullptr));
-            // raise(SIGTRAP);
-
-            MYASSERT(pthread_mutex_lock(&threadResumeLock) == 0)
-            MYASSERT(pthread_mutex_unlock(&threadResumeLock) == 0)
-
-            // raise(SIGTRAP);
+            while (barrier->generation == generation)
+                futexWait(&barrier->generation, generation);
 
             /* If when thread was suspended, we performed a restore,
              * then we must resume execution using setcontext
@@ -523,28 +543,28 @@ void SaveStateManager::stopThisThread(int signum)
         /* We successfully resumed the thread. We wait for all other
          * threads to restore before continuing
          */
-        waitForAllRestored(current_thread);
+        waitForAllRestored();
 
         debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Thread returning to user code");
     }
 }
 
-void SaveStateManager::waitForAllRestored(ThreadInfo *thread)
+void SaveStateManager::waitForAllRestored()
 {
-    if (thread->state == ThreadInfo::ST_CKPNTHREAD) {
-        for (int i = 0; i < numThreads; i++) {
-            sem_wait(&semNotifyCkptThread);
-        }
-
-        /* If this was last of all, wake everyone up */
-        for (int i = 0; i < numThreads; i++) {
-            sem_post(&semWaitForCkptThreadSignal);
-        }
-    }
-    else {
-        sem_post(&semNotifyCkptThread);
-        sem_wait(&semWaitForCkptThreadSignal);
+    /* All resumed threads and the checkpoint thread arrive at the barrier,
+     * and the last one to arrive releases everyone. The release counter
+     * must be read before arriving, so that we cannot miss the release.
+     */
+    int released = barrier->released;
+    if (++barrier->restored == barrier->expected + 1) {
+        barrier->restored = 0;
+        barrier->released++;
+        futexWake(&barrier->released);
+        return;
     }
+
+    while (barrier->released == released)
+        futexWait(&barrier->released, released);
 }
 
 void SaveStateManager::printError(int err)
@@ -65,7 +65,8 @@ int checkpoint(int slot);
 /* Restore a savestate */
 int restore(int slot);
 
-/* Send a signal to suspend all threads before checkpointing */
+/* Send a signal to suspend all threads before checkpointing, and wait for
+ * all of them to be suspended */
 void suspendThreads();
 
 /* Resume all threads */
@@ -74,7 +75,9 @@ void resumeThreads();
 /* Function executed by all secondary threads using signal SIGUSR1 */
 void stopThisThread(int signum);
 
-void waitForAllRestored(ThreadInfo *thread);
+/* Wait for all threads to be resumed, called by each resumed thread and by
+ * the checkpoint thread */
+void waitForAllRestored();
 
 /* Is currently loading a savestate? */
 bool isLoading();
@@ -25,6 +25,7 @@
 #include <ucontext.h>
 #include <pthread.h> // pthread_t
 #include <csignal> // stack_t
+#include <ctime> // struct timespec
 #include <mutex>
 #include <condition_variable>
 #include <setjmp.h>
@@ -68,6 +69,8 @@ struct ThreadInfo {
     bool initial_nolog = false; // initial value of the global nolog state
 
     stack_t altstack = {nullptr, 0, 0}; // altstack to be used when suspending threads
+    struct timespec park_time = {0, 0}; // time when the thread was suspended during
+                                        // the last savestate, for instrumentation
 
     std::mutex mutex; // mutex to notify a thread for a new routing
     std::condition_variable cv; // associated conditional variable
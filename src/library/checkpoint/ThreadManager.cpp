@@ -37,6 +37,7 @@
 namespace libtas {
 
 ThreadInfo* ThreadManager::thread_list = nullptr;
+ThreadTable ThreadManager::thread_table;
 thread_local ThreadInfo* ThreadManager::current_thread = nullptr;
 pthread_t ThreadManager::main_pthread_id = 0;
 pthread_mutex_t ThreadManager::threadStateLock = PTHREAD_MUTEX_INITIALIZER;
@@ -176,11 +177,7 @@ ThreadInfo* ThreadManager::getNewThread()
 
 ThreadInfo* ThreadManager::getThread(pthread_t pthread_id)
 {
-    for (ThreadInfo* thread = thread_list; thread != nullptr; thread = thread->next)
-        if (thread->pthread_id == pthread_id)
-            return thread;
-
-    return nullptr;
+    return thread_table.find(pthread_id);
 }
 
 pid_t ThreadManager::getThreadTid(pthread_t pthread_id)
@@ -269,6 +266,8 @@ void ThreadManager::addToList(ThreadInfo* thread)
     }
     thread_list = thread;
 
+    thread_table.insert(thread);
+
     unlockList();
 }
 
@@ -296,6 +295,8 @@ void ThreadManager::threadIsDead(ThreadInfo *thread)
         thread_list = thread_list->next;
     }
 
+    thread_table.remove(thread);
+
     if (thread->altstack.ss_sp) {
         free(thread->altstack.ss_sp);
     }
@@ -23,6 +23,7 @@
 #define LIBTAS_THREAD_MANAGER_H
 #include "../TimeHolder.h"
 #include "ThreadInfo.h"
+#include "ThreadTable.h"
 #include <set>
 #include <map>
 #include <vector>
@@ -35,6 +36,9 @@
 namespace libtas {
 class ThreadManager {
     static ThreadInfo* thread_list;
+
+    /* Index of the thread list by pthread id */
+    static ThreadTable thread_table;
     static thread_local ThreadInfo* current_thread;
 
     // static bool inited;
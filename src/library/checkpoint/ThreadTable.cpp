@@ -0,0 +1,122 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadTable.h"
+#include <cstdint>
+#include <cstdlib>
+
+namespace libtas {
+
+size_t ThreadTable::hash(pthread_t pthread_id, size_t capacity)
+{
+    /* Fibonacci hashing. pthread ids are addresses of aligned structures,
+     * so lower bits are mostly identical, and we keep the higher bits */
+    uint64_t h = static_cast<uint64_t>(pthread_id) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(h >> 32) & (capacity - 1);
+}
+
+ThreadInfo* ThreadTable::find(pthread_t pthread_id) const
+{
+    const Table* t = table.load(std::memory_order_acquire);
+    if (!t || !pthread_id)
+        return nullptr;
+
+    size_t mask = t->capacity - 1;
+    for (size_t i = hash(pthread_id, t->capacity); t->slots[i].pthread_id; i = (i + 1) & mask) {
+        if ((t->slots[i].pthread_id == pthread_id) && t->slots[i].thread)
+            return t->slots[i].thread;
+    }
+    return nullptr;
+}
+
+void ThreadTable::insert(ThreadInfo* thread)
+{
+    if (!thread->pthread_id)
+        return;
+
+    remove(thread);
+
+    /* Keep at most half of the slots used, so that probing stays short */
+    Table* t = table.load(std::memory_order_relaxed);
+    if (!t || (2 * (used + 1) > t->capacity)) {
+        size_t capacity = min_capacity;
+        while (capacity < 4 * (live + 1))
+            capacity *= 2;
+        rebuild(capacity);
+        t = table.load(std::memory_order_relaxed);
+    }
+
+    size_t mask = t->capacity - 1;
+    size_t i = hash(thread->pthread_id, t->capacity);
+    for (; t->slots[i].pthread_id; i = (i + 1) & mask) {
+        /* Reuse the tombstone of the same thread id */
+        if ((t->slots[i].pthread_id == thread->pthread_id) && !t->slots[i].thread)
+            break;
+    }
+
+    if (!t->slots[i].pthread_id) {
+        used++;
+        t->slots[i].pthread_id = thread->pthread_id;
+    }
+    t->slots[i].thread = thread;
+    live++;
+}
+
+void ThreadTable::remove(ThreadInfo* thread)
+{
+    Table* t = table.load(std::memory_order_relaxed);
+    if (!t || !thread->pthread_id)
+        return;
+
+    size_t mask = t->capacity - 1;
+    for (size_t i = hash(thread->pthread_id, t->capacity); t->slots[i].pthread_id; i = (i + 1) & mask) {
+        if (t->slots[i].thread == thread) {
+            t->slots[i].thread = nullptr;
+            live--;
+            return;
+        }
+    }
+}
+
+void ThreadTable::rebuild(size_t capacity)
+{
+    Table* t = static_cast<Table*>(calloc(1, sizeof(Table) + (capacity - 1) * sizeof(Slot)));
+    t->capacity = capacity;
+
+    Table* old = table.load(std::memory_order_relaxed);
+    if (old) {
+        size_t mask = capacity - 1;
+        for (size_t j = 0; j < old->capacity; j++) {
+            if (!old->slots[j].thread)
+                continue;
+            size_t i = hash(old->slots[j].pthread_id, capacity);
+            while (t->slots[i].pthread_id)
+                i = (i + 1) & mask;
+            t->slots[i] = old->slots[j];
+        }
+    }
+    used = live;
+
+    table.store(t, std::memory_order_release);
+
+    free(retired);
+    retired = old;
+}
+
+}
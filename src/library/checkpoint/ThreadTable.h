@@ -0,0 +1,83 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_THREAD_TABLE_H
+#define LIBTAS_THREAD_TABLE_H
+
+#include "ThreadInfo.h"
+#include <pthread.h> // pthread_t
+#include <atomic>
+#include <cstddef>
+
+namespace libtas {
+
+/* Index of ThreadInfo structs by their pthread id, so that looking for a
+ * thread takes constant time regardless of the number of threads that the
+ * game has created.
+ *
+ * This is an open-addressing hash table with linear probing. Lookups do not
+ * lock nor allocate, so they can be performed from signal handlers and
+ * during a checkpoint. Modifications must be done with the thread list
+ * locked.
+ *
+ * Removed entries leave a tombstone, and the table is rebuilt when too many
+ * slots are used, which also discards all tombstones. The previous array is
+ * only freed at the next rebuild, so that a concurrent lookup never reads
+ * freed memory.
+ */
+class ThreadTable
+{
+    public:
+        /* Get the ThreadInfo struct of a thread, or null if not there */
+        ThreadInfo* find(pthread_t pthread_id) const;
+
+        /* Add a thread, replacing any thread with the same pthread id */
+        void insert(ThreadInfo* thread);
+
+        /* Remove a thread if it is there */
+        void remove(ThreadInfo* thread);
+
+    private:
+        struct Slot {
+            pthread_t pthread_id; // 0 if the slot was never used
+            ThreadInfo* thread; // nullptr if the slot is empty or a tombstone
+        };
+
+        struct Table {
+            size_t capacity; // power of two
+            Slot slots[1];
+        };
+
+        static const size_t min_capacity = 64;
+
+        /* Index of the first slot to probe */
+        static size_t hash(pthread_t pthread_id, size_t capacity);
+
+        /* Build a new table containing only live entries */
+        void rebuild(size_t capacity);
+
+        std::atomic<Table*> table{nullptr};
+        Table* retired = nullptr;
+
+        size_t live = 0; // number of threads in the table
+        size_t used = 0; // number of non-empty slots, including tombstones
+};
+}
+
+#endif
@@ -28,6 +28,7 @@
 #include <set>
 #include "backtrace.h"
 #include "GameHacks.h"
+#include "BusyLoopDetection.h"
 
 namespace libtas {
 
@@ -90,9 +91,13 @@ void *dlopen(const char *file, int mode) throw() {
 
     void *result = orig::dlopen(file, mode);
 
-    if (result)
+    if (result) {
         add_lib(file);
 
+        /* Memory mappings have changed */
+        BusyLoopDetection::invalidateSymbols();
+    }
+
     if (result && file && std::string(file).find("wined3d.dll.so") != std::string::npos) {
         /* Hook wine wined3d functions */
         hook_wined3d();
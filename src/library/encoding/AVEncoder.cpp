@@ -78,6 +78,20 @@ void AVEncoder::initMuxer() {
 
     const char* pixfmt = ScreenCapture::getPixelFormat();
 
+    /* Convert or downscale frames ourselves if asked */
+    convert_video = false;
+    if ((shared_config.video_pixfmt != SharedConfig::VIDEO_PIXFMT_NATIVE) || (shared_config.video_downscale > 1)) {
+        if (converter.init(width, height, ScreenCapture::getPixelSize(), pixfmt, shared_config.video_pixfmt, shared_config.video_downscale)) {
+            convert_video = true;
+            width = converter.getWidth();
+            height = converter.getHeight();
+            pixfmt = converter.getPixelFormat();
+        }
+        else {
+            debuglogstdio(LCF_DUMP | LCF_ERROR, "Could not convert video frames, sending them unchanged");
+        }
+    }
+
     /* Initialize the muxer with either framerate or video framerate */
     if (shared_config.variable_framerate)
         nutMuxer = new NutMuxer(width, height, shared_config.video_framerate, 1, pixfmt, audiocontext.outFrequency, audiocontext.outAlignSize, audiocontext.outNbChannels, ffmpeg_pipe);
@@ -101,10 +115,8 @@ void AVEncoder::encodeOneFrame(bool draw, TimeHolder frametime) {
 
             /* Just getting the size of an image */
             int size = ScreenCapture::getSize();
-            startup_audio_bytes.resize(size, 0); // reusing the audio samples vector
-            for (int i=0; i<startup_video_frames; i++) {
-                nutMuxer->writeVideoFrame(startup_audio_bytes.data(), size);
-            }
+            startup_audio_bytes.assign(size, 0); // reusing the audio samples vector
+            writeVideoFrames(startup_audio_bytes.data(), size, startup_video_frames);
         }
         else {
             startup_video_frames++;
@@ -132,17 +144,63 @@ void AVEncoder::encodeOneFrame(bool draw, TimeHolder frametime) {
         frame_remainder -= frames;
     }
 
+    /* If possible, start an asynchronous transfer of the screen pixels, and
+     * only encode the frame when a later frame is encoded. Video and audio
+     * timestamps are independent, so it does not break the synchronization.
+     * Non-draw frames must stay in order with the queued frames. */
+    if ((draw && ScreenCapture::queuePixelsFromSurface()) || (!draw && !queued_frames.empty())) {
+        queued_frames.push_back({draw, frames});
+        writeQueuedFrames(queue_latency);
+        return;
+    }
+
+    writeQueuedFrames(0);
+
     /* Access to the screen pixels, or last screen pixels if not a draw frame */
-    int size = ScreenCapture::getPixelsFromSurface(&pixels, draw);
+    int size = ScreenCapture::getPixelsFromSurface(frame, draw);
+
+    writeVideoFrames(frame->pixels, size, frames);
+
+    /* Frames may reference the screen surface, and would be copied if kept
+     * until the next capture */
+    frame.reset();
+}
+
+void AVEncoder::writeQueuedFrames(unsigned int keep) {
+    while (queued_frames.size() > keep) {
+        const QueuedVideoFrame& qf = queued_frames.front();
+
+        /* Non-draw frames reuse the pixels of the previous queued frame */
+        int size;
+        if (qf.draw)
+            size = ScreenCapture::getQueuedPixels(frame);
+        else
+            size = ScreenCapture::getPixelsFromSurface(frame, false);
+
+        writeVideoFrames(frame->pixels, size, qf.count);
+
+        frame.reset();
+        queued_frames.pop_front();
+    }
+}
+
+void AVEncoder::writeVideoFrames(const uint8_t* frame, int size, int count) {
+    if (count <= 0)
+        return;
+
+    /* Convert only once, even if the frame is encoded multiple times */
+    if (convert_video)
+        size = converter.convert(frame, &frame);
 
-    for (int f=0; f<frames; f++) {
+    for (int f=0; f<count; f++) {
         debuglogstdio(LCF_DUMP, "Encode a video frame");
-        nutMuxer->writeVideoFrame(pixels, size);
+        nutMuxer->writeVideoFrame(frame, size);
     }
 }
 
 AVEncoder::~AVEncoder() {
     if (nutMuxer) {
+        writeQueuedFrames(0);
         nutMuxer->finish();
     }
 
@@ -21,8 +21,11 @@
 #define LIBTAS_AVDUMPING_H_INCL
 
 #include "NutMuxer.h"
+#include "VideoConverter.h"
+#include "../ScreenCapture.h"
 #include "../TimeHolder.h"
 #include <vector>
+#include <deque>
 #include <memory> // std::unique_ptr
 
 namespace libtas {
@@ -63,13 +66,34 @@ class AVEncoder {
         FILE *ffmpeg_pipe = nullptr;
         NutMuxer* nutMuxer = nullptr;
 
-        uint8_t* pixels = nullptr;
+        /* Current video frame, released as soon as it is encoded */
+        std::shared_ptr<ScreenCapture::Frame> frame;
+
+        /* Optional conversion of video frames before sending them */
+        VideoConverter converter;
+        bool convert_video = false;
 
         int startup_video_frames = 0;
         std::vector<uint8_t> startup_audio_bytes;
 
         /* remainder of the number of video frames to send */
         double frame_remainder = 0;
+
+        /* Video frames waiting for an asynchronous screen transfer */
+        struct QueuedVideoFrame {
+            bool draw; // is it a new image or a copy of the previous one
+            int count; // number of times the frame must be encoded
+        };
+        std::deque<QueuedVideoFrame> queued_frames;
+
+        /* Number of frames that are kept in the queue before being encoded */
+        static const unsigned int queue_latency = 1;
+
+        /* Encode queued video frames until `keep` frames remain */
+        void writeQueuedFrames(unsigned int keep);
+
+        /* Convert a video frame if needed, and encode it `count` times */
+        void writeVideoFrames(const uint8_t* frame, int size, int count);
 };
 
 extern std::unique_ptr<AVEncoder> avencoder;
@@ -0,0 +1,323 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "VideoConverter.h"
+
+#include "../logging.h"
+#include "../../shared/SharedConfig.h"
+
+#include <cstring> // memcpy
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace libtas {
+
+/* Pack two signed 16-bit values into a 32-bit value, used as coefficients
+ * for _mm_madd_epi16 */
+#define PAIR16(lo, hi) static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(hi)) << 16) | static_cast<uint16_t>(lo))
+
+/* Halve a frame in both dimensions, by averaging blocks of 2x2 pixels */
+static void downscale2x(const uint8_t* src, int src_stride, int w, int h, uint8_t* dst)
+{
+    int ow = w / 2;
+    int oh = h / 2;
+
+    for (int y = 0; y < oh; y++) {
+        const uint8_t* s0 = src + 2*y*src_stride;
+        const uint8_t* s1 = s0 + src_stride;
+        uint8_t* d = dst + y*ow*4;
+        int x = 0;
+
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+
+        /* 8 source pixels from each row give 4 output pixels */
+        for (; x + 4 <= ow; x += 4) {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + 8*x));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + 8*x + 16));
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + 8*x));
+            __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + 8*x + 16));
+
+            /* Vertical sums, two pixels per register */
+            __m128i p01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+            __m128i p23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+            __m128i p45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+            __m128i p67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+            /* Horizontal sums of adjacent pixels */
+            __m128i q01 = _mm_add_epi16(_mm_unpacklo_epi64(p01, p23), _mm_unpackhi_epi64(p01, p23));
+            __m128i q23 = _mm_add_epi16(_mm_unpacklo_epi64(p45, p67), _mm_unpackhi_epi64(p45, p67));
+
+            q01 = _mm_srli_epi16(_mm_add_epi16(q01, two), 2);
+            q23 = _mm_srli_epi16(_mm_add_epi16(q23, two), 2);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 4*x), _mm_packus_epi16(q01, q23));
+        }
+#endif
+
+        for (; x < ow; x++) {
+            for (int c = 0; c < 4; c++) {
+                d[4*x+c] = (s0[8*x+c] + s0[8*x+4+c] + s1[8*x+c] + s1[8*x+4+c] + 2) >> 2;
+            }
+        }
+    }
+}
+
+/* BT.601 limited range coefficients, with 8 bits of precision */
+static inline uint8_t luma(int r, int g, int b)
+{
+    return ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+}
+
+/* Chroma values from the sums of a 2x2 block of pixels */
+static inline uint8_t chromaU(int rs, int gs, int bs)
+{
+    return 128 + ((-38*rs - 74*gs + 112*bs + 512) >> 10);
+}
+
+static inline uint8_t chromaV(int rs, int gs, int bs)
+{
+    return 128 + ((112*rs - 94*gs - 18*bs + 512) >> 10);
+}
+
+/* Convert a packed 32-bit frame into a luma plane and chroma planes. Chroma
+ * samples are written every `uvstep` bytes, so that the same function can
+ * output both planar (I420) and semi-planar (NV12) formats. Dimensions must
+ * be even. */
+static void convertYUV(const uint8_t* src, int src_stride, int w, int h,
+    int ro, int go, int bo, uint8_t* ydst, uint8_t* udst, uint8_t* vdst, int uvstep)
+{
+    for (int y = 0; y < h/2; y++) {
+        const uint8_t* s0 = src + 2*y*src_stride;
+        const uint8_t* s1 = s0 + src_stride;
+        uint8_t* y0 = ydst + 2*y*w;
+        uint8_t* y1 = y0 + w;
+        uint8_t* u = udst + y*(w/2)*uvstep;
+        uint8_t* v = vdst + y*(w/2)*uvstep;
+        int x = 0;
+
+#ifdef __SSE2__
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i rshift = _mm_cvtsi32_si128(8*ro);
+        const __m128i gshift = _mm_cvtsi32_si128(8*go);
+        const __m128i bshift = _mm_cvtsi32_si128(8*bo);
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i ycst = _mm_set1_epi16(128);
+        const __m128i yoff = _mm_set1_epi16(16);
+        const __m128i uvoff = _mm_set1_epi32(128);
+        const __m128i bone = _mm_set1_epi32(1 << 16);
+        const __m128i urg = _mm_set1_epi32(PAIR16(-38, -74));
+        const __m128i ub = _mm_set1_epi32(PAIR16(112, 512));
+        const __m128i vrg = _mm_set1_epi32(PAIR16(112, -94));
+        const __m128i vb = _mm_set1_epi32(PAIR16(-18, 512));
+
+        /* Process 8 pixels from each row at a time */
+        for (; x + 8 <= w; x += 8) {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + 4*x));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + 4*x + 16));
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + 4*x));
+            __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + 4*x + 16));
+
+            /* Extract each component as 16-bit values */
+            __m128i r0 = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(a0, rshift), mask), _mm_and_si128(_mm_srl_epi32(a1, rshift), mask));
+            __m128i g0 = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(a0, gshift), mask), _mm_and_si128(_mm_srl_epi32(a1, gshift), mask));
+            __m128i c0 = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(a0, bshift), mask), _mm_and_si128(_mm_srl_epi32(a1, bshift), mask));
+            __m128i r1 = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(b0, rshift), mask), _mm_and_si128(_mm_srl_epi32(b1, rshift), mask));
+            __m128i g1 = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(b0, gshift), mask), _mm_and_si128(_mm_srl_epi32(b1, gshift), mask));
+            __m128i c1 = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(b0, bshift), mask), _mm_and_si128(_mm_srl_epi32(b1, bshift), mask));
+
+            /* Luma. The weighted sum does not exceed 16 bits, so we can use
+             * unsigned wrapping arithmetic */
+            __m128i l0 = _mm_add_epi16(_mm_mullo_epi16(r0, _mm_set1_epi16(66)), _mm_mullo_epi16(g0, _mm_set1_epi16(129)));
+            l0 = _mm_add_epi16(l0, _mm_mullo_epi16(c0, _mm_set1_epi16(25)));
+            l0 = _mm_add_epi16(_mm_srli_epi16(_mm_add_epi16(l0, ycst), 8), yoff);
+            __m128i l1 = _mm_add_epi16(_mm_mullo_epi16(r1, _mm_set1_epi16(66)), _mm_mullo_epi16(g1, _mm_set1_epi16(129)));
+            l1 = _mm_add_epi16(l1, _mm_mullo_epi16(c1, _mm_set1_epi16(25)));
+            l1 = _mm_add_epi16(_mm_srli_epi16(_mm_add_epi16(l1, ycst), 8), yoff);
+
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(y0 + x), _mm_packus_epi16(l0, l0));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(y1 + x), _mm_packus_epi16(l1, l1));
+
+            /* Sums of 2x2 blocks, as 32-bit values */
+            __m128i rs = _mm_madd_epi16(_mm_add_epi16(r0, r1), ones);
+            __m128i gs = _mm_madd_epi16(_mm_add_epi16(g0, g1), ones);
+            __m128i bs = _mm_madd_epi16(_mm_add_epi16(c0, c1), ones);
+
+            /* Sums fit in 16 bits, so interleave them to use multiply-add */
+            __m128i rg = _mm_or_si128(rs, _mm_slli_epi32(gs, 16));
+            __m128i b1c = _mm_or_si128(bs, bone);
+
+            __m128i us = _mm_add_epi32(_mm_madd_epi16(rg, urg), _mm_madd_epi16(b1c, ub));
+            __m128i vs = _mm_add_epi32(_mm_madd_epi16(rg, vrg), _mm_madd_epi16(b1c, vb));
+            us = _mm_add_epi32(_mm_srai_epi32(us, 10), uvoff);
+            vs = _mm_add_epi32(_mm_srai_epi32(vs, 10), uvoff);
+
+            __m128i u8 = _mm_packus_epi16(_mm_packs_epi32(us, us), _mm_packs_epi32(us, us));
+            __m128i v8 = _mm_packus_epi16(_mm_packs_epi32(vs, vs), _mm_packs_epi32(vs, vs));
+
+            if (uvstep == 1) {
+                int ui = _mm_cvtsi128_si32(u8);
+                int vi = _mm_cvtsi128_si32(v8);
+                memcpy(u + x/2, &ui, 4);
+                memcpy(v + x/2, &vi, 4);
+            }
+            else {
+                /* Interleaved chroma, `v` is right after `u` */
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x), _mm_unpacklo_epi8(u8, v8));
+            }
+        }
+#endif
+
+        for (; x < w; x += 2) {
+            const uint8_t* p00 = s0 + 4*x;
+            const uint8_t* p01 = p00 + 4;
+            const uint8_t* p10 = s1 + 4*x;
+            const uint8_t* p11 = p10 + 4;
+
+            y0[x] = luma(p00[ro], p00[go], p00[bo]);
+            y0[x+1] = luma(p01[ro], p01[go], p01[bo]);
+            y1[x] = luma(p10[ro], p10[go], p10[bo]);
+            y1[x+1] = luma(p11[ro], p11[go], p11[bo]);
+
+            int rs = p00[ro] + p01[ro] + p10[ro] + p11[ro];
+            int gs = p00[go] + p01[go] + p10[go] + p11[go];
+            int bs = p00[bo] + p01[bo] + p10[bo] + p11[bo];
+
+            u[(x/2)*uvstep] = chromaU(rs, gs, bs);
+            v[(x/2)*uvstep] = chromaV(rs, gs, bs);
+        }
+    }
+}
+
+bool VideoConverter::init(int width, int height, int pixelsize, const char* srcfmt, int dstfmt, int ds)
+{
+    in_width = width;
+    in_height = height;
+    dst_format = dstfmt;
+    downscale = ds;
+
+    if ((downscale != 1) && (downscale != 2) && (downscale != 4)) {
+        debuglogstdio(LCF_DUMP | LCF_ERROR, "Unsupported downscale factor %d", downscale);
+        return false;
+    }
+
+    /* Only 32-bit formats are supported. Other formats (e.g. 16-bit SDL1
+     * surfaces) may still be described by a 32-bit fourcc */
+    if (pixelsize != 4) {
+        debuglogstdio(LCF_DUMP | LCF_ERROR, "Unsupported pixel size %d for conversion", pixelsize);
+        return false;
+    }
+
+    /* Get the offset of each component */
+    r_off = g_off = b_off = -1;
+    for (int i = 0; i < 4; i++) {
+        switch (srcfmt[i]) {
+            case 'R': r_off = i; break;
+            case 'G': g_off = i; break;
+            case 'B': b_off = i; break;
+            case 'A':
+            case '\0':
+                break;
+            default:
+                debuglogstdio(LCF_DUMP | LCF_ERROR, "Unsupported pixel format for conversion");
+                return false;
+        }
+    }
+    if ((r_off < 0) || (g_off < 0) || (b_off < 0)) {
+        debuglogstdio(LCF_DUMP | LCF_ERROR, "Unsupported pixel format for conversion");
+        return false;
+    }
+
+    int scaled_width = in_width / downscale;
+    int scaled_height = in_height / downscale;
+
+    /* Buffer for one or two downscaling passes */
+    if (downscale == 2)
+        scaled.resize(scaled_width * scaled_height * 4);
+    else if (downscale == 4)
+        scaled.resize((in_width/2) * (in_height/2) * 4 + scaled_width * scaled_height * 4);
+
+    switch (dst_format) {
+        case SharedConfig::VIDEO_PIXFMT_I420:
+        case SharedConfig::VIDEO_PIXFMT_NV12:
+            /* Chroma subsampling requires even dimensions */
+            out_width = scaled_width & ~1;
+            out_height = scaled_height & ~1;
+            out_fourcc = (dst_format == SharedConfig::VIDEO_PIXFMT_I420) ? "I420" : "NV12";
+            converted.resize(out_width * out_height * 3 / 2);
+            break;
+        default:
+            out_width = scaled_width;
+            out_height = scaled_height;
+            out_fourcc = srcfmt;
+            converted.clear();
+            break;
+    }
+
+    debuglogstdio(LCF_DUMP, "Video conversion from %dx%d to %dx%d", in_width, in_height, out_width, out_height);
+    return true;
+}
+
+int VideoConverter::convert(const uint8_t* src, const uint8_t** dst)
+{
+    const uint8_t* frame = src;
+    int stride = in_width * 4;
+    int w = in_width;
+    int h = in_height;
+
+    if (downscale >= 2) {
+        downscale2x(frame, stride, w, h, scaled.data());
+        frame = scaled.data();
+        w /= 2;
+        h /= 2;
+        stride = w * 4;
+    }
+
+    if (downscale == 4) {
+        uint8_t* second = scaled.data() + stride * h;
+        downscale2x(frame, stride, w, h, second);
+        frame = second;
+        w /= 2;
+        h /= 2;
+        stride = w * 4;
+    }
+
+    if (converted.empty()) {
+        *dst = frame;
+        return w * h * 4;
+    }
+
+    uint8_t* ydst = converted.data();
+    uint8_t* uvdst = ydst + out_width * out_height;
+    if (dst_format == SharedConfig::VIDEO_PIXFMT_I420) {
+        convertYUV(frame, stride, out_width, out_height, r_off, g_off, b_off,
+            ydst, uvdst, uvdst + out_width * out_height / 4, 1);
+    }
+    else {
+        convertYUV(frame, stride, out_width, out_height, r_off, g_off, b_off,
+            ydst, uvdst, uvdst + 1, 2);
+    }
+
+    *dst = converted.data();
+    return converted.size();
+}
+
+}
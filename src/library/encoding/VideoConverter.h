@@ -0,0 +1,68 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_VIDEOCONVERTER_H_INCL
+#define LIBTAS_VIDEOCONVERTER_H_INCL
+
+#include <vector>
+#include <cstdint>
+
+namespace libtas {
+
+/* Convert and downscale video frames before sending them to ffmpeg, which
+ * reduces the amount of data going through the pipe. Source frames must be
+ * in a 32-bit packed format, described by the same fourcc as the nut muxer
+ * (e.g. "RGBA", "BGR\0"). Output is either the same packed format, or
+ * planar I420 or semi-planar NV12 (BT.601 limited range, like swscale). */
+class VideoConverter {
+    public:
+        /* Set up the conversion. `pixelsize` is the number of bytes per
+         * source pixel, formats are values of SharedConfig::VideoPixelFormat,
+         * and downscale is 1, 2 or 4.
+         * @return false if the conversion is not supported
+         */
+        bool init(int width, int height, int pixelsize, const char* srcfmt, int dstfmt, int downscale);
+
+        /* Dimensions and fourcc of the converted frames */
+        int getWidth() const {return out_width;}
+        int getHeight() const {return out_height;}
+        const char* getPixelFormat() const {return out_fourcc;}
+
+        /* Convert a frame. Returns the size of the converted frame, pointed
+         * by `dst`, which stays valid until the next conversion. */
+        int convert(const uint8_t* src, const uint8_t** dst);
+
+    private:
+        int in_width, in_height;
+        int out_width, out_height;
+        int dst_format;
+        int downscale;
+        const char* out_fourcc;
+
+        /* Byte offset of each color component inside a pixel */
+        int r_off, g_off, b_off;
+
+        /* Frame after downscaling, and converted frame */
+        std::vector<uint8_t> scaled;
+        std::vector<uint8_t> converted;
+};
+
+}
+
+#endif
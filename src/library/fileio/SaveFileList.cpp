@@ -28,11 +28,12 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <forward_list>
+#include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <mutex>
 #include <cstring>
 #include <unistd.h>
-#include <algorithm> // remove_if
 
 namespace libtas {
 
@@ -43,62 +44,78 @@ static std::forward_list<std::unique_ptr<SaveFile>>& getSaveFileList() {
     return savefiles;
 }
 
+/* Savefiles indexed by their canonicalized path */
+static std::unordered_map<std::string, SaveFile*>& getSaveFileIndex() {
+    static std::unordered_map<std::string, SaveFile*> index;
+    return index;
+}
+
+/* Canonicalized paths of files that cannot become savefiles (devices,
+ * pipes, shared memory), so that we don't check them again on each open */
+static std::unordered_set<std::string>& getNotSaveFiles() {
+    static std::unordered_set<std::string> notsavefiles;
+    return notsavefiles;
+}
+
 /* Mutex to protect the savefile list */
 static std::mutex& getSaveFileListMutex() {
     static std::mutex mutex;
     return mutex;
 }
 
-/* Check if the file open permission allows for write operation */
-bool isSaveFile(const char *file, const char *modes)
+/* Return the canonicalized path of a file, or an empty string */
+static std::string canonicalize(const char *file)
 {
-    std::lock_guard<std::mutex> lock(getSaveFileListMutex());
+    char* canonfile = SaveFile::canonicalizeFile(file);
+    if (!canonfile)
+        return std::string();
 
-    const auto& savefiles = getSaveFileList();
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(file)) {
-            return true;
-        }
-    }
-
-    if (!(strstr(modes, "w") || strstr(modes, "a") || strstr(modes, "+")))
-        return false;
+    std::string filestr(canonfile);
+    free(canonfile);
+    return filestr;
+}
 
-    return isSaveFile(file);
+/* Return the savefile of a canonicalized path, or nullptr */
+static SaveFile* findSaveFile(const std::string& canonfile)
+{
+    if (canonfile.empty())
+        return nullptr;
+
+    const auto& index = getSaveFileIndex();
+    auto it = index.find(canonfile);
+    if (it == index.end())
+        return nullptr;
+    return it->second;
 }
 
-bool isSaveFile(const char *file, int oflag)
+/* Register a new savefile */
+static SaveFile* addSaveFile(const char *file)
 {
-    std::lock_guard<std::mutex> lock(getSaveFileListMutex());
+    auto& savefiles = getSaveFileList();
+    savefiles.emplace_front(new SaveFile(file));
+    SaveFile* savefile = savefiles.front().get();
 
-    const auto& savefiles = getSaveFileList();
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(file)) {
-            return true;
-        }
+    if (!savefile->filename.empty()) {
+        getSaveFileIndex()[savefile->filename] = savefile;
+        getNotSaveFiles().erase(savefile->filename);
     }
-
-    if ((oflag & 0x3) == O_RDONLY)
-        return false;
-
-    /*
-     * This is a sort of hack to prevent considering new shared
-     * memory files as a savefile, which are opened using O_CLOEXEC
-     */
-    if (oflag & O_CLOEXEC)
-        return false;
-
-    return isSaveFile(file);
+    return savefile;
 }
 
-/* Detect save files (excluding the writeable flag), basically if the file is regular */
-bool isSaveFile(const char *file)
+/* Result of checking a file that is not registered as a savefile */
+enum SaveFileCheck {
+    CHECK_SAVEFILE,
+    CHECK_NOT_SAVEFILE,
+    CHECK_NEVER_SAVEFILE, // file type prevents it from ever being a savefile
+};
+
+static SaveFileCheck checkSaveFile(const char *file)
 {
     if (!shared_config.prevent_savefiles)
-        return false;
+        return CHECK_NOT_SAVEFILE;
 
     if (!file)
-        return false;
+        return CHECK_NOT_SAVEFILE;
 
     /* Check if file is a dev file */
     GlobalNative gn;
@@ -112,55 +129,114 @@ bool isSaveFile(const char *file)
          * we consider it as a savefile
          */
         if (errno == ENOENT)
-            return true;
+            return CHECK_SAVEFILE;
 
         /* For any other error, let's say no */
-        return false;
+        return CHECK_NOT_SAVEFILE;
     }
 
+    /* Directories can be removed and replaced by a file */
+    if (S_ISDIR(filestat.st_mode))
+        return CHECK_NOT_SAVEFILE;
+
     /* Check if the file is a regular file */
     if (! S_ISREG(filestat.st_mode))
-        return false;
+        return CHECK_NEVER_SAVEFILE;
 
     /* Check if the file is a message queue, semaphore or shared memory object */
     if (S_TYPEISMQ(&filestat) || S_TYPEISSEM(&filestat) || S_TYPEISSHM(&filestat))
-        return false;
+        return CHECK_NEVER_SAVEFILE;
 
     /* Check if the file lies in shared memory */
     if (strstr(file, "/dev/shm"))
+        return CHECK_NEVER_SAVEFILE;
+
+    return CHECK_SAVEFILE;
+}
+
+/* Check a file that is not registered, using the cache of files that cannot
+ * be savefiles */
+static bool isNewSaveFile(const char *file, const std::string& canonfile)
+{
+    auto& notsavefiles = getNotSaveFiles();
+    if (!canonfile.empty() && (notsavefiles.find(canonfile) != notsavefiles.end()))
         return false;
 
-    return true;
+    SaveFileCheck check = checkSaveFile(file);
+    if ((check == CHECK_NEVER_SAVEFILE) && !canonfile.empty())
+        notsavefiles.insert(canonfile);
+
+    return check == CHECK_SAVEFILE;
+}
+
+/* Check if a file being opened is a savefile, or becomes one. Paths are
+ * only canonicalized when there is something to look up, so that opening
+ * files for reading costs nothing when there is no savefile */
+static bool isOpenedSaveFile(const char *file, bool writable)
+{
+    /* New savefiles can only be created by opening a file for writing */
+    bool canBeNew = writable && shared_config.prevent_savefiles;
+
+    if (!canBeNew && getSaveFileIndex().empty())
+        return false;
+
+    std::string canonfile = canonicalize(file);
+    if (findSaveFile(canonfile))
+        return true;
+
+    if (!canBeNew)
+        return false;
+
+    return isNewSaveFile(file, canonfile);
+}
+
+/* Check if the file open permission allows for write operation */
+bool isSaveFile(const char *file, const char *modes)
+{
+    std::lock_guard<std::mutex> lock(getSaveFileListMutex());
+
+    bool writable = strstr(modes, "w") || strstr(modes, "a") || strstr(modes, "+");
+    return isOpenedSaveFile(file, writable);
+}
+
+bool isSaveFile(const char *file, int oflag)
+{
+    std::lock_guard<std::mutex> lock(getSaveFileListMutex());
+
+    /*
+     * This is a sort of hack to prevent considering new shared
+     * memory files as a savefile, which are opened using O_CLOEXEC
+     */
+    bool writable = ((oflag & 0x3) != O_RDONLY) && !(oflag & O_CLOEXEC);
+    return isOpenedSaveFile(file, writable);
+}
+
+/* Detect save files (excluding the writeable flag), basically if the file is regular */
+bool isSaveFile(const char *file)
+{
+    return checkSaveFile(file) == CHECK_SAVEFILE;
 }
 
 FILE *openSaveFile(const char *file, const char *modes)
 {
     std::lock_guard<std::mutex> lock(getSaveFileListMutex());
 
-    auto& savefiles = getSaveFileList();
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(file)) {
-            return savefile->open(modes);
-        }
-    }
+    SaveFile* savefile = findSaveFile(canonicalize(file));
+    if (savefile)
+        return savefile->open(modes);
 
-    savefiles.emplace_front(new SaveFile(file));
-    return savefiles.front()->open(modes);
+    return addSaveFile(file)->open(modes);
 }
 
 int openSaveFile(const char *file, int oflag)
 {
     std::lock_guard<std::mutex> lock(getSaveFileListMutex());
 
-    auto& savefiles = getSaveFileList();
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(file)) {
-            return savefile->open(oflag);
-        }
-    }
+    SaveFile* savefile = findSaveFile(canonicalize(file));
+    if (savefile)
+        return savefile->open(oflag);
 
-    savefiles.emplace_front(new SaveFile(file));
-    return savefiles.front()->open(oflag);
+    return addSaveFile(file)->open(oflag);
 }
 
 int closeSaveFile(int fd)
@@ -195,17 +271,16 @@ int removeSaveFile(const char *file)
 {
     std::lock_guard<std::mutex> lock(getSaveFileListMutex());
 
-    auto& savefiles = getSaveFileList();
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(file)) {
-            return savefile->remove();
-        }
-    }
+    std::string canonfile = canonicalize(file);
+    getNotSaveFiles().erase(canonfile);
+
+    SaveFile* savefile = findSaveFile(canonfile);
+    if (savefile)
+        return savefile->remove();
 
     /* If the file is not registered, create a removed savefile */
     if (shared_config.prevent_savefiles) {
-        savefiles.emplace_front(new SaveFile(file));
-        savefiles.front()->remove();
+        addSaveFile(file)->remove();
 
         GlobalNative gn;
         return access(file, W_OK);
@@ -218,28 +293,39 @@ int renameSaveFile(const char *oldfile, const char *newfile)
 {
     std::lock_guard<std::mutex> lock(getSaveFileListMutex());
 
-    char* canonnewfile = SaveFile::canonicalizeFile(newfile);
-    if (!canonnewfile)
+    std::string newfilestr = canonicalize(newfile);
+    if (newfilestr.empty())
         return -1;
-    std::string newfilestr(canonnewfile);
-    free(canonnewfile);
+
+    std::string oldfilestr = canonicalize(oldfile);
+
+    auto& notsavefiles = getNotSaveFiles();
+    notsavefiles.erase(oldfilestr);
+    notsavefiles.erase(newfilestr);
 
     /* Remove the newfile if present */
-    auto& savefiles = getSaveFileList();
-    savefiles.remove_if([newfile](const std::unique_ptr<SaveFile>& s) { return (s->isSameFile(newfile));});
+    auto& index = getSaveFileIndex();
+    SaveFile* newsavefile = findSaveFile(newfilestr);
+    if (newsavefile) {
+        index.erase(newfilestr);
+        getSaveFileList().remove_if([newsavefile](const std::unique_ptr<SaveFile>& s) { return (s.get() == newsavefile);});
+    }
 
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(oldfile)) {
-            savefile->filename = newfilestr;
-            return 0;
-        }
+    SaveFile* savefile = findSaveFile(oldfilestr);
+    if (savefile) {
+        index.erase(oldfilestr);
+        savefile->filename = newfilestr;
+        index[newfilestr] = savefile;
+        return 0;
     }
 
     /* If the file is not registered, create a savefile */
     if (shared_config.prevent_savefiles) {
-        savefiles.emplace_front(new SaveFile(oldfile));
-        savefiles.front()->open("rb");
-        savefiles.front()->filename = newfilestr;
+        savefile = addSaveFile(oldfile);
+        savefile->open("rb");
+        index.erase(savefile->filename);
+        savefile->filename = newfilestr;
+        index[newfilestr] = savefile;
 
         GlobalNative gn;
         return access(oldfile, W_OK);
@@ -252,12 +338,12 @@ int getSaveFileFd(const char *file)
 {
     std::lock_guard<std::mutex> lock(getSaveFileListMutex());
 
-    auto& savefiles = getSaveFileList();
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(file)) {
-            return savefile->fd;
-        }
-    }
+    if (getSaveFileIndex().empty())
+        return 0;
+
+    SaveFile* savefile = findSaveFile(canonicalize(file));
+    if (savefile)
+        return savefile->fd;
 
     return 0;
 }
@@ -266,12 +352,12 @@ bool isSaveFileRemoved(const char *file)
 {
     std::lock_guard<std::mutex> lock(getSaveFileListMutex());
 
-    auto& savefiles = getSaveFileList();
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(file)) {
-            return savefile->removed;
-        }
-    }
+    if (getSaveFileIndex().empty())
+        return true;
+
+    SaveFile* savefile = findSaveFile(canonicalize(file));
+    if (savefile)
+        return savefile->removed;
 
     return true;
 }
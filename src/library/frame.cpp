@@ -30,6 +30,7 @@
 #include "sdl/sdlwindows.h"
 #include "sdl/sdlevents.h"
 #include <iomanip>
+#include <vector>
 #include <stdint.h>
 #include "timewrappers.h" // clock_gettime
 #include "checkpoint/ThreadManager.h"
@@ -46,6 +47,9 @@
 #include "xlib/XlibEventQueueList.h"
 #include "xlib/xwindows.h" // x11::gameXWindows
 #include "BusyLoopDetection.h"
+#include "FrameProfiler.h"
+#include "SyncNotifier.h"
+#include "AsyncLogger.h"
 #include "audio/AudioContext.h"
 
 namespace libtas {
@@ -189,9 +193,19 @@ void frameBoundary(std::function<void()> draw)
     ThreadManager::setCheckpointThread();
     ThreadManager::setMainThread();
 
+    FrameProfiler::start();
+
     /* Reset the busy loop detector */
     BusyLoopDetection::reset();
 
+    /* Report the time spent waiting for the game during the last frame */
+    SyncNotifier::reportWaits();
+
+    /* Start writing log messages on a separate thread, which is stopped
+     * during savestates */
+    if (shared_config.includeFlags)
+        AsyncLogger::start();
+
     /* Wait for events to be processed by the game */
     if (shared_config.async_events & SharedConfig::ASYNC_XEVENTS_END)
         xlibEventQueueList.waitForEmpty();
@@ -206,14 +220,20 @@ void frameBoundary(std::function<void()> draw)
         ThreadSync::detWait();
     }
 
+    FrameProfiler::mark(FrameProfiler::SYNC);
+
     /* Update the deterministic timer, sleep if necessary */
     TimeHolder timeIncrement = detTimer.enterFrameBoundary();
 
+    FrameProfiler::mark(FrameProfiler::TIMER);
+
     /* Mix audio, except if the game opened a loopback context */
     if (! audiocontext.isLoopback) {
         audiocontext.mixAllSources(timeIncrement);
     }
 
+    FrameProfiler::mark(FrameProfiler::AUDIO);
+
     /* If the game is exiting, dont process the frame boundary, just draw and exit */
     if (is_exiting) {
         detTimer.flushDelay();
@@ -276,6 +296,9 @@ void frameBoundary(std::function<void()> draw)
     sendData(&fps, sizeof(float));
     sendData(&lfps, sizeof(float));
 
+    /* Send the time calls of the frame that just ended */
+    BusyLoopDetection::sendTraces(framecount - 1);
+
     /* Ask the program to perform a backtrack savestate */
     if (saveBacktrack) {
         /* Only save a backtrack savestate if we did at least one savestate.
@@ -325,45 +348,15 @@ void frameBoundary(std::function<void()> draw)
             sendData(&h, sizeof(int));
             break;
         }
-        case MSGN_LUA_TEXT:
-        {
-            int x, y;
-            receiveData(&x, sizeof(int));
-            receiveData(&y, sizeof(int));
-            std::string text = receiveString();
-            uint32_t fg, bg;
-            receiveData(&fg, sizeof(uint32_t));
-            receiveData(&bg, sizeof(uint32_t));
-#ifdef LIBTAS_ENABLE_HUD
-            RenderHUD::insertLuaText(x, y, text, fg, bg);
-#endif
-            break;
-        }
-        case MSGN_LUA_PIXEL:
-        {
-            int x, y;
-            receiveData(&x, sizeof(int));
-            receiveData(&y, sizeof(int));
-            uint32_t color;
-            receiveData(&color, sizeof(uint32_t));
-#ifdef LIBTAS_ENABLE_HUD
-            RenderHUD::insertLuaPixel(x, y, color);
-#endif
-            break;
-        }
-        case MSGN_LUA_RECT:
+        case MSGN_LUA_DRAWLIST:
         {
-            int x, y, w, h, thickness;
-            receiveData(&x, sizeof(int));
-            receiveData(&y, sizeof(int));
-            receiveData(&w, sizeof(int));
-            receiveData(&h, sizeof(int));
-            receiveData(&thickness, sizeof(int));
-            uint32_t outline, fill;
-            receiveData(&outline, sizeof(uint32_t));
-            receiveData(&fill, sizeof(uint32_t));
+            static std::vector<uint8_t> draw_list;
+            uint32_t size;
+            receiveData(&size, sizeof(uint32_t));
+            draw_list.resize(size);
+            receiveData(draw_list.data(), size);
 #ifdef LIBTAS_ENABLE_HUD
-            RenderHUD::insertLuaRect(x, y, w, h, thickness, outline, fill);
+            RenderHUD::setLuaDrawList(draw_list);
 #endif
             break;
         }
@@ -371,6 +364,8 @@ void frameBoundary(std::function<void()> draw)
         message = receiveMessage();
     }
 
+    FrameProfiler::mark(FrameProfiler::SOCKET);
+
     /*** Rendering ***/
     if (!draw)
         nondraw_framecount++;
@@ -388,6 +383,8 @@ void frameBoundary(std::function<void()> draw)
         }
     }
 
+    FrameProfiler::mark(FrameProfiler::CAPTURE);
+
 #ifdef LIBTAS_ENABLE_HUD
     if (!skipping_draw && shared_config.osd_encode) {
         AllInputs preview_ai;
@@ -396,6 +393,8 @@ void frameBoundary(std::function<void()> draw)
     }
 #endif
 
+    FrameProfiler::mark(FrameProfiler::HUD);
+
     /* Audio mixing is done above, so encode must be called after */
     /* Dumping audio and video */
     if (shared_config.av_dumping) {
@@ -419,6 +418,8 @@ void frameBoundary(std::function<void()> draw)
         }
     }
 
+    FrameProfiler::mark(FrameProfiler::ENCODE);
+
 #ifdef LIBTAS_ENABLE_HUD
     if (!skipping_draw && !shared_config.osd_encode) {
         AllInputs preview_ai;
@@ -427,12 +428,16 @@ void frameBoundary(std::function<void()> draw)
     }
 #endif
 
+    FrameProfiler::mark(FrameProfiler::HUD);
+
     /* Actual draw command */
     if (!skipping_draw && draw) {
         GlobalNoLog gnl;
         NATIVECALL(draw());
     }
 
+    FrameProfiler::mark(FrameProfiler::DRAW);
+
     /* Receive messages from the program */
     #ifdef LIBTAS_ENABLE_HUD
         receive_messages(draw, hud);
@@ -443,6 +448,8 @@ void frameBoundary(std::function<void()> draw)
     /* No more socket messages here, unlocking the socket. */
     unlockSocket();
 
+    FrameProfiler::mark(FrameProfiler::SOCKET);
+
     /* Some methods of drawing on screen don't always update the full screen.
      * Our current screen may be dirty with OSD, so in that case, we must
      * restore the screen to its original content so that the next frame will
@@ -454,6 +461,8 @@ void frameBoundary(std::function<void()> draw)
         ScreenCapture::restoreScreenState();
     }
 
+    FrameProfiler::mark(FrameProfiler::CAPTURE);
+
     /*** Process inputs and events ***/
 
     /* This part may disappear entirely if we manage to completely emulate
@@ -505,7 +514,8 @@ void frameBoundary(std::function<void()> draw)
         sdlEventQueue.mutex.unlock();
     }
 
-    /* Wait for evdev and jsdev events to be processed by the game, in case of async event handling */
+    /* Send evdev and jsdev events, and wait for them to be processed by the
+     * game in case of async event handling */
     syncControllerEvents();
 
     /* Wait for events to be processed by the game */
@@ -515,6 +525,8 @@ void frameBoundary(std::function<void()> draw)
     if (shared_config.async_events & SharedConfig::ASYNC_SDLEVENTS_BEG)
         sdlEventQueue.waitForEmpty();
 
+    FrameProfiler::mark(FrameProfiler::EVENTS);
+
     // ThreadSync::detSignalGlobal(0);
     // ThreadSync::detWaitGlobal(1);
 
@@ -524,6 +536,9 @@ void frameBoundary(std::function<void()> draw)
     skipping_draw = skipDraw(fps);
 
     detTimer.exitFrameBoundary();
+
+    FrameProfiler::mark(FrameProfiler::TIMER);
+    FrameProfiler::end(framecount);
 }
 
 static void pushQuitEvent(void)
@@ -692,8 +707,16 @@ static void receive_messages(std::function<void()> draw)
                 break;
 
             case MSGN_SAVESTATE:
+                FrameProfiler::mark(FrameProfiler::SOCKET);
                 status = SaveStateManager::checkpoint(slot);
 
+                /* Timings were restored with the rest of the memory when
+                 * loading, so they start again from here */
+                if (SaveStateManager::isLoading())
+                    FrameProfiler::start();
+                else
+                    FrameProfiler::mark(FrameProfiler::SAVESTATE);
+
                 if (status == 0) {
                     /* Current savestate is now the parent savestate */
                     Checkpoint::setCurrentToParent();
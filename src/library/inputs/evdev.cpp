@@ -23,6 +23,7 @@
 #include <cerrno>
 #include <utility>
 #include "../DeterministicTimer.h"
+#include "../SyncNotifier.h"
 #include "../fileio/FileHandleList.h"
 #include "../../shared/AllInputs.h"
 #include <unistd.h> /* write */
@@ -32,6 +33,19 @@ namespace libtas {
 /* The tuple contains pipe in fd, pipe out fd, and then refcount. */
 static std::pair<std::pair<int, int>, int> evdevfds[AllInputs::MAXJOYS];
 
+/* Used to wait for the game to read the evdev pipes */
+static SyncNotifier evdevNotifier("evdev");
+
+/* Maximum number of events in each pipe */
+static const int max_pipe_events = 64;
+
+/* Events of the current frame that were not yet written to the pipe, so
+ * that they are sent using a single write */
+static struct {
+    struct input_event events[max_pipe_events];
+    int count;
+} evdevPending[AllInputs::MAXJOYS];
+
 int is_evdev(const char* source)
 {
     /* Extract the ev number from the dev filename */
@@ -87,15 +101,39 @@ void write_evdev(struct input_event ev, int evnum)
     if (evdevfds[evnum].second == 0)
         return;
 
-    /* Check pipe size and don't write if too big */
+    /* Flush early if the batch is full, the pipe would not accept more
+     * events than this anyway */
+    if (evdevPending[evnum].count == max_pipe_events)
+        flush_evdev(evnum);
+
+    evdevPending[evnum].events[evdevPending[evnum].count++] = ev;
+}
+
+void flush_evdev(int evnum)
+{
+    int count = evdevPending[evnum].count;
+    if (count == 0)
+        return;
+    evdevPending[evnum].count = 0;
+
+    if (evdevfds[evnum].second == 0)
+        return;
+
+    /* Check pipe size once, and only write the events that fit */
     int pipeSize;
     NATIVECALL(MYASSERT(ioctl(evdevfds[evnum].first.first, FIONREAD, &pipeSize) == 0));
 
-    if (pipeSize < static_cast<int>(64*sizeof(ev)))
-        write(evdevfds[evnum].first.second, &ev, sizeof(ev));
-    else {
-        debuglogstdio(LCF_JOYSTICK | LCF_WARNING, "did not write evdev event, too many already.");
+    int room = max_pipe_events - pipeSize / static_cast<int>(sizeof(struct input_event));
+    if (room < 0)
+        room = 0;
+
+    if (room < count) {
+        debuglogstdio(LCF_JOYSTICK | LCF_WARNING, "did not write %d evdev events, too many already.", count - room);
+        count = room;
     }
+
+    if (count > 0)
+        write(evdevfds[evnum].first.second, evdevPending[evnum].events, count * sizeof(struct input_event));
 }
 
 bool sync_evdev(int evnum)
@@ -103,23 +141,24 @@ bool sync_evdev(int evnum)
     if (evdevfds[evnum].second == 0)
         return false;
 
-    int attempts = 0, count = 0;
+    int count = 0;
     NATIVECALL(ioctl(evdevfds[evnum].first.first, FIONREAD, &count));
 
-    if (count >= static_cast<int>(64*sizeof(struct input_event)))
+    if (count >= static_cast<int>(max_pipe_events*sizeof(struct input_event)))
         return false;
 
-    do {
-        NATIVECALL(ioctl(evdevfds[evnum].first.first, FIONREAD, &count));
-        if (count > 0) {
-            if (++attempts > 100 * 100) {
-                debuglogstdio(LCF_JOYSTICK | LCF_ERROR | LCF_ALERT, "evdev sync took too long, were asynchronous events incorrectly enabled?");
-                return false;
-            }
-            struct timespec sleepTime = { 0, 10 * 1000 };
-            NATIVECALL(nanosleep(&sleepTime, NULL));
-        }
-    } while (count > 0);
+    /* The game reads the pipe directly, so nobody notifies us when it is
+     * empty, and the notifier only checks the pipe size periodically */
+    bool empty = evdevNotifier.wait([evnum]{
+        int size = 0;
+        NATIVECALL(ioctl(evdevfds[evnum].first.first, FIONREAD, &size));
+        return size <= 0;
+    }, 500);
+
+    if (!empty) {
+        debuglogstdio(LCF_JOYSTICK | LCF_ERROR | LCF_ALERT, "evdev sync took too long, were asynchronous events incorrectly enabled?");
+        return false;
+    }
 
     return true;
 }
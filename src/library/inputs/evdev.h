@@ -33,9 +33,13 @@ int is_evdev(const char* source);
 /* Open a fake dev file using SYS_memfd_create */
 int open_evdev(const char* source, int flags);
 
-/* Write an input event in the file */
+/* Queue an input event, to be written in the file on the next flush */
 void write_evdev(struct input_event ev, int evnum);
 
+/* Write all queued events in the file at once, dropping the ones that
+ * don't fit in the pipe */
+void flush_evdev(int evnum);
+
 /* Block, waiting for the input event queue to become empty.
  * Return of the queue is empty.
  */
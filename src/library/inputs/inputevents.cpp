@@ -1040,41 +1040,51 @@ void generateMouseButtonEvents(void)
 
 void syncControllerEvents()
 {
-    if (!(shared_config.async_events & (SharedConfig::ASYNC_JSDEV | SharedConfig::ASYNC_EVDEV)))
-        return;
-
     if (!(game_info.joystick & (GameInfo::JSDEV | GameInfo::EVDEV)))
         return;
 
+    bool async_jsdev = shared_config.async_events & SharedConfig::ASYNC_JSDEV;
+    bool async_evdev = shared_config.async_events & SharedConfig::ASYNC_EVDEV;
+
     struct timespec time = detTimer.getTicks();
     int timestamp = time.tv_sec * 1000 + time.tv_nsec / 1000000;
 
     for (int i = 0; i < shared_config.nb_controllers; i++) {
-        if (shared_config.async_events & SharedConfig::ASYNC_JSDEV) {
-            /* Send a synchronize report event */
-            struct js_event ev;
-            ev.time = timestamp;
-            ev.type = 0;
-            ev.number = 0;
-            ev.value = 0;
-            write_jsdev(ev, i);
+        if (game_info.joystick & GameInfo::JSDEV) {
+            if (async_jsdev) {
+                /* Send a synchronize report event with the other events */
+                struct js_event ev;
+                ev.time = timestamp;
+                ev.type = 0;
+                ev.number = 0;
+                ev.value = 0;
+                write_jsdev(ev, i);
+            }
+
+            flush_jsdev(i);
 
             /* Wait for queue to become empty, ensuring that
              * the event have finished being processed. */
-            sync_jsdev(i);
+            if (async_jsdev)
+                sync_jsdev(i);
         }
 
         /* Same for evdev */
-        if (shared_config.async_events & SharedConfig::ASYNC_EVDEV) {
-            struct input_event ev;
-            ev.time.tv_sec = time.tv_sec;
-            ev.time.tv_usec = time.tv_nsec / 1000;
-            ev.type = EV_SYN;
-            ev.code = SYN_REPORT;
-            ev.value = 0;
-            write_evdev(ev, i);
-
-            sync_evdev(i);
+        if (game_info.joystick & GameInfo::EVDEV) {
+            if (async_evdev) {
+                struct input_event ev;
+                ev.time.tv_sec = time.tv_sec;
+                ev.time.tv_usec = time.tv_nsec / 1000;
+                ev.type = EV_SYN;
+                ev.code = SYN_REPORT;
+                ev.value = 0;
+                write_evdev(ev, i);
+            }
+
+            flush_evdev(i);
+
+            if (async_evdev)
+                sync_evdev(i);
         }
     }
 }
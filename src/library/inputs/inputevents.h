@@ -42,7 +42,8 @@ void generateMouseMotionEvents(void);
 /* Same as above with the MouseButton event */
 void generateMouseButtonEvents(void);
 
-/* Wait for evdev and jsdev to be read */
+/* Write the evdev and jsdev events of the frame, and wait for them to be read
+ * in case of async event handling */
 void syncControllerEvents();
 
 }
@@ -23,6 +23,7 @@
 #include <cerrno>
 #include <utility>
 #include "../DeterministicTimer.h"
+#include "../SyncNotifier.h"
 #include "../fileio/FileHandleList.h"
 #include "../../shared/AllInputs.h"
 #include <unistd.h> /* write */
@@ -32,6 +33,19 @@ namespace libtas {
 /* The tuple contains pipe in fd, pipe out fd, and then refcount. */
 static std::pair<std::pair<int, int>, int> jsdevfds[AllInputs::MAXJOYS];
 
+/* Used to wait for the game to read the jsdev pipes */
+static SyncNotifier jsdevNotifier("jsdev");
+
+/* Maximum number of events in each pipe */
+static const int max_pipe_events = 64;
+
+/* Events of the current frame that were not yet written to the pipe, so
+ * that they are sent using a single write */
+static struct {
+    struct js_event events[max_pipe_events];
+    int count;
+} jsdevPending[AllInputs::MAXJOYS];
+
 int is_jsdev(const char* source)
 {
     /* Extract the js number from the dev filename */
@@ -95,6 +109,7 @@ int open_jsdev(const char* source, int flags)
             ev.number = axis;
             write_jsdev(ev, jsnum);
         }
+        flush_jsdev(jsnum);
     }
 
     return jsdevfds[jsnum].first.first;
@@ -105,15 +120,39 @@ void write_jsdev(struct js_event ev, int jsnum)
     if (jsdevfds[jsnum].second == 0)
         return;
 
-    /* Check pipe size and don't write if too big */
+    /* Flush early if the batch is full, the pipe would not accept more
+     * events than this anyway */
+    if (jsdevPending[jsnum].count == max_pipe_events)
+        flush_jsdev(jsnum);
+
+    jsdevPending[jsnum].events[jsdevPending[jsnum].count++] = ev;
+}
+
+void flush_jsdev(int jsnum)
+{
+    int count = jsdevPending[jsnum].count;
+    if (count == 0)
+        return;
+    jsdevPending[jsnum].count = 0;
+
+    if (jsdevfds[jsnum].second == 0)
+        return;
+
+    /* Check pipe size once, and only write the events that fit */
     int pipeSize;
     NATIVECALL(MYASSERT(ioctl(jsdevfds[jsnum].first.first, FIONREAD, &pipeSize) == 0));
 
-    if (pipeSize < static_cast<int>(64*sizeof(ev)))
-        write(jsdevfds[jsnum].first.second, &ev, sizeof(ev));
-    else {
-        debuglogstdio(LCF_JOYSTICK | LCF_WARNING, "did not write jsdev event, too many already.");
+    int room = max_pipe_events - pipeSize / static_cast<int>(sizeof(struct js_event));
+    if (room < 0)
+        room = 0;
+
+    if (room < count) {
+        debuglogstdio(LCF_JOYSTICK | LCF_WARNING, "did not write %d jsdev events, too many already.", count - room);
+        count = room;
     }
+
+    if (count > 0)
+        write(jsdevfds[jsnum].first.second, jsdevPending[jsnum].events, count * sizeof(struct js_event));
 }
 
 bool sync_jsdev(int jsnum)
@@ -122,23 +161,24 @@ bool sync_jsdev(int jsnum)
         return false;
 
     /* Do not attempt to sync if the pipe is already full */
-    int attempts = 0, count = 0;
+    int count = 0;
     NATIVECALL(ioctl(jsdevfds[jsnum].first.first, FIONREAD, &count));
 
-    if (count >= static_cast<int>(64*sizeof(struct js_event)))
+    if (count >= static_cast<int>(max_pipe_events*sizeof(struct js_event)))
         return false;
 
-    do {
-        NATIVECALL(ioctl(jsdevfds[jsnum].first.first, FIONREAD, &count));
-        if (count > 0) {
-            if (++attempts > 10 * 100) {
-                debuglogstdio(LCF_JOYSTICK | LCF_ERROR | LCF_ALERT, "jsdev sync took too long, were asynchronous events incorrectly enabled?");
-                return false;
-            }
-            struct timespec sleepTime = { 0, 10 * 1000 };
-            NATIVECALL(nanosleep(&sleepTime, NULL));
-        }
-    } while (count > 0);
+    /* The game reads the pipe directly, so nobody notifies us when it is
+     * empty, and the notifier only checks the pipe size periodically */
+    bool empty = jsdevNotifier.wait([jsnum]{
+        int size = 0;
+        NATIVECALL(ioctl(jsdevfds[jsnum].first.first, FIONREAD, &size));
+        return size <= 0;
+    }, 50);
+
+    if (!empty) {
+        debuglogstdio(LCF_JOYSTICK | LCF_ERROR | LCF_ALERT, "jsdev sync took too long, were asynchronous events incorrectly enabled?");
+        return false;
+    }
 
     return true;
 }
@@ -33,9 +33,13 @@ int is_jsdev(const char* source);
 /* Open a fake jsdev file using SYS_memfd_create, and write the init data */
 int open_jsdev(const char* source, int flags);
 
-/* Write an js event in the file */
+/* Queue a js event, to be written in the file on the next flush */
 void write_jsdev(struct js_event ev, int jsnum);
 
+/* Write all queued events in the file at once, dropping the ones that
+ * don't fit in the pipe */
+void flush_jsdev(int jsnum);
+
 /* Block, waiting for the js event queue to become empty. Return true if
  * queue is empty. */
 bool sync_jsdev(int jsnum);
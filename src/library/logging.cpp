@@ -18,6 +18,7 @@
  */
 
 #include "logging.h"
+#include "AsyncLogger.h"
 #include <stdlib.h>
 #include "checkpoint/ThreadManager.h" // isMainThread()
 #include <unistd.h> // For isatty
@@ -32,17 +33,9 @@
 
 namespace libtas {
 
-void debuglogstdio(LogCategoryFlag lcf, const char* fmt, ...)
+/* Parentheses prevent the expansion of the debuglogstdio() macro */
+void (debuglogstdio)(LogCategoryFlag lcf, const char* fmt, ...)
 {
-    if ((shared_config.includeFlags & LCF_MAINTHREAD) &&
-        !ThreadManager::isMainThread())
-        return;
-
-    if ((!(lcf & shared_config.includeFlags)  ||
-          (lcf & shared_config.excludeFlags)) &&
-         !(lcf & LCF_ALERT))
-        return;
-
     /* Not printing anything if global state is set to NOLOG */
     if (GlobalState::isNoLog())
         return;
@@ -52,78 +45,59 @@ void debuglogstdio(LogCategoryFlag lcf, const char* fmt, ...)
      */
      GlobalNoLog tnl;
 
-    /* Build main log string */
+    LogHeader header;
+    header.lcf = lcf;
+    header.framecount = framecount;
 
-    /* We avoid any memory allocation here, because some parts of our code
-     * are critical about memory allocation, like checkpointing.
-     */
-    int maxsize = 2048;
-    char s[2048] = {'\0'};
-    int size = 0;
-
-    /* We only print colors if displayed on a terminal */
-    bool isTerm = isatty(/*cerr*/ 2);
-    if (isTerm) {
-        if (lcf & LCF_ERROR)
-            /* Write the header text in red */
-            strncat(s, ANSI_COLOR_RED, maxsize-size-1);
-        else if (lcf & LCF_WARNING)
-            /* Write the header text in light red */
-            strncat(s, ANSI_COLOR_LIGHT_RED, maxsize-size-1);
-        else
-            /* Write the header text in white */
-            strncat(s, ANSI_COLOR_LIGHT_GRAY, maxsize-size-1);
-    }
-    size = strlen(s);
-
-    snprintf(s + size, maxsize-size-1, "[libTAS f:%" PRIu64 "] ", framecount);
-    size = strlen(s);
-
-    pid_t tid;
     if (is_fork)
         /* For forked processes, the thread manager have wrong pid values (those of parent process) */
-        NATIVECALL(tid = getpid());
+        NATIVECALL(header.tid = getpid());
     else
-        tid = ThreadManager::getThreadTid();
+        header.tid = ThreadManager::getThreadTid();
 
-    snprintf(s + size, maxsize-size-1, "Thread %d %s ", tid, is_fork?"(fork)":(ThreadManager::isMainThread()?"(main)":""));
+    header.thread = is_fork?"(fork)":(ThreadManager::isMainThread()?"(main)":"");
 
-    size = strlen(s);
+    /* Messages are formatted and written by a separate thread when possible.
+     * Errors are written immediately after the queued messages, because the
+     * game may exit right after.
+     *
+     * We write directly to the file descriptor, without locking, because of
+     * the following situation (encountered in Towerfall):
+     * - Thread 1 starts printing a debug message and acquire the lock
+     * - Thread 2 sends a signal to thread 1, interrupting the printing
+     * - Thread 1 executes a function that is wrapped, and prints a debug message
+     * - Thread 1 wants to acquire the lock
+     */
+    va_list args;
+    va_start(args, fmt);
 
-    if (isTerm) {
-        /* Reset color change */
-        strncat(s, ANSI_COLOR_RESET, maxsize-size-1);
-        size = strlen(s);
+    if (!(lcf & (LCF_ERROR | LCF_ALERT)) && AsyncLogger::push(header, fmt, args)) {
+        va_end(args);
+        return;
     }
 
-    if (lcf & LCF_ERROR) {
-        strncat(s, "ERROR: ", maxsize-size-1);
-        size = strlen(s);
-    }
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(s + size, maxsize-size-1, fmt, args);
-    va_end(args);
+    /* Build main log string */
 
-    /* If we must send the string to the program for displaying to the user,
-     * we only send the actual message */
-    // if (lcf & LCF_ALERT) {
-    //     setAlertMsg(s+size, strlen(s)-size);
-    // }
+    /* We avoid any memory allocation here, because some parts of our code
+     * are critical about memory allocation, like checkpointing.
+     */
+    const int maxsize = AsyncLogger::max_size;
+    char s[maxsize];
 
-    size = strlen(s);
+    int size = AsyncLogger::formatHeader(s, maxsize, header);
 
-    strncat(s, "\n", maxsize-size-1);
+    int len = vsnprintf(s + size, maxsize-size-1, fmt, args);
+    va_end(args);
 
-    /* We need to use a non-locking function here, because of the following
-     * situation (encountered in Towerfall):
-     * - Thread 1 starts printing a debug message and acquire the lock
-     * - Thread 2 sends a signal to thread 1, interrupting the printing
-     * - Thread 1 executes a function that is wrapped, and prints a debug message
-     * - Thread 1 wants to acquire the lock
-     */
-    fputs_unlocked(s, stderr);
+    /* Keep room for the line return if the message was truncated */
+    if (len < 0)
+        len = 0;
+    else if (len > maxsize-size-2)
+        len = maxsize-size-2;
+    size += len;
+    s[size++] = '\n';
 
+    AsyncLogger::write(s, size);
 }
 
 void sendAlertMsg(const std::string alert)
@@ -20,6 +20,7 @@
 #ifndef LIBTAS_LOGGING_H_INCL
 #define LIBTAS_LOGGING_H_INCL
 
+#include "config.h"
 #include "../shared/lcf.h"
 #include "global.h" // shared_config
 #include "checkpoint/ThreadManager.h" // isMainThread()
@@ -52,9 +53,40 @@
 
 #define ANSI_COLOR_RESET         "\x1b[0m"
 
+/* Categories of log messages that are removed at compile time, set by the
+ * configure option --with-disabled-log */
+#ifndef LIBTAS_DISABLED_LOG
+#define LIBTAS_DISABLED_LOG LCF_NONE
+#endif
+
 namespace libtas {
 
-/* Print the debug message using stdio functions */
+/* Check if a message of category `lcf` must be printed, based on the
+ * values of tasflags.includeFlags and tasflags.excludeFlags. The check is
+ * inlined at each call site so that nothing is evaluated for disabled
+ * messages, and disabled categories are removed by the compiler when `lcf`
+ * is a constant.
+ */
+inline bool isLogEnabled(LogCategoryFlag lcf)
+{
+    if (lcf & LCF_ALERT)
+        return !(shared_config.includeFlags & LCF_MAINTHREAD) ||
+                ThreadManager::isMainThread();
+
+    if ((lcf & LIBTAS_DISABLED_LOG) ||
+        !(lcf & shared_config.includeFlags) ||
+         (lcf & shared_config.excludeFlags))
+        return false;
+
+    if ((shared_config.includeFlags & LCF_MAINTHREAD) &&
+        !ThreadManager::isMainThread())
+        return false;
+
+    return true;
+}
+
+/* Print the debug message using stdio functions. It must be called through
+ * the debuglogstdio() macro below, which checks the category first. */
 void debuglogstdio(LogCategoryFlag lcf, const char* fmt, ...);
 
 /* Helper functions to concatenate different arguments arbitrary types into
@@ -78,12 +110,11 @@ inline void catlog (std::ostringstream &oss, First && first, Rest && ...rest)
     catlog(oss, std::forward<Rest>(rest)...);
 }
 
-/* Print a variable list of arguments and other information based on the
- * value of lcf compared to the values in tasflags.includeFlags
- * and tasflags.excludeFlags.
+/* Print a variable list of arguments and other information.
  *
- * This function is the one called by other source files.
  * It uses variadic templates so the above comment does apply here also.
+ * It must be called through the debuglog() macro below, which checks the
+ * category first.
  *
  * The content is kept as minimal as possible and everything that does not
  * depend on variadic templates is transfered to debuglogstdio(),
@@ -94,23 +125,20 @@ void debuglog(LogCategoryFlag lcf, Args ...args);
 template<typename ...Args>
 inline void debuglog(LogCategoryFlag lcf, Args ...args)
 {
-    /* We also check this in debuglogstdio(), but doing it here avoid building
-     * all strings, because as a fraction of these will be printed.
-     */
-    if ((shared_config.includeFlags & LCF_MAINTHREAD) &&
-        !ThreadManager::isMainThread())
-        return;
-
-    if ((!(lcf & shared_config.includeFlags) ||
-          (lcf & shared_config.excludeFlags)) &&
-         !(lcf & LCF_ALERT))
-        return;
-
     std::ostringstream oss;
     catlog(oss, std::forward<Args>(args)...);
-    debuglogstdio(lcf, oss.str().c_str());
+    debuglogstdio(lcf, "%s", oss.str().c_str());
 }
 
+}
+
+/* These are the ones called by other source files. Arguments are only
+ * evaluated if the message is printed. */
+#define debuglogstdio(lcf, ...) do {if (libtas::isLogEnabled(lcf)) libtas::debuglogstdio(lcf, __VA_ARGS__);} while (false)
+#define debuglog(lcf, ...) do {if (libtas::isLogEnabled(lcf)) libtas::debuglog(lcf, __VA_ARGS__);} while (false)
+
+namespace libtas {
+
 /* If we only want to print the function name... */
 #define DEBUGLOGCALL(lcf) debuglogstdio(lcf, "%s call.", __func__)
 
@@ -33,6 +33,7 @@
 #include "checkpoint/SaveStateManager.h"
 #include "checkpoint/Checkpoint.h"
 #include "audio/AudioContext.h"
+#include "audio/AudioPlayer.h"
 #include "encoding/AVEncoder.h"
 #include "renderhud/RenderHUD.h"
 #include <unistd.h> // getpid()
@@ -40,6 +41,7 @@
 #include "steam/isteamuser.h" // SteamSetUserDataFolder
 #include "steam/isteamremotestorage/isteamremotestorage.h" // SteamSetRemoteStorageFolder
 #include "Stack.h"
+#include "AsyncLogger.h"
 
 
 extern char**environ;
@@ -79,6 +81,11 @@ void __attribute__((constructor)) init(void)
 
     ThreadManager::init();
     SaveStateManager::init();
+
+    /* Start the process that plays audio, before the socket is opened so
+     * that it does not inherit it */
+    AudioPlayer::initProcess();
+
     Stack::grow();
 
     initSocketGame();
@@ -192,6 +199,8 @@ void __attribute__((destructor)) term(void)
             closeSocket();
         }
         debuglog(LCF_SOCKET, "Exiting.");
+        AudioPlayer::close();
+        AsyncLogger::stop();
         ThreadManager::deallocateThreads();
     }
 }
@@ -87,6 +87,12 @@ DEFINE_ORIG_POINTER(glActiveTexture)
 DEFINE_ORIG_POINTER(glFramebufferTexture2D)
 DEFINE_ORIG_POINTER(glUseProgram)
 DEFINE_ORIG_POINTER(glPixelStorei)
+DEFINE_ORIG_POINTER(glGenBuffers)
+DEFINE_ORIG_POINTER(glBindBuffer)
+DEFINE_ORIG_POINTER(glBufferData)
+DEFINE_ORIG_POINTER(glMapBufferRange)
+DEFINE_ORIG_POINTER(glUnmapBuffer)
+DEFINE_ORIG_POINTER(glDeleteBuffers)
 
 #define GLFUNCSKIPDRAW(NAME, DECL, ARGS) \
 DEFINE_ORIG_POINTER(NAME)\
@@ -0,0 +1,185 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GlyphAtlas.h"
+#ifdef LIBTAS_ENABLE_HUD
+
+#include "../logging.h"
+#include <climits>
+#include <cstring>
+
+namespace libtas {
+
+GlyphAtlas::GlyphAtlas(TTF_Font* f) : font(f)
+{
+    outline = TTF_GetFontOutline(font);
+    ascent = TTF_FontAscent(font);
+    height = TTF_FontHeight(font);
+    kerning = TTF_GetFontKerning(font);
+}
+
+const GlyphAtlas::Glyph& GlyphAtlas::getGlyph(uint8_t c)
+{
+    Glyph& glyph = glyphs[c];
+    if (glyph.cached)
+        return glyph;
+
+    glyph.cached = true;
+    glyph.provided = TTF_GlyphIsProvided(font, c);
+
+    if (TTF_GlyphMetrics(font, c, &glyph.minx, &glyph.maxx, &glyph.miny, &glyph.maxy, &glyph.advance) < 0)
+        return glyph;
+
+    const uint8_t* buffer;
+    int pitch;
+    if (TTF_GlyphPixmap(font, c, &buffer, &glyph.w, &glyph.h, &pitch, &glyph.yoffset) < 0)
+        return glyph;
+
+    if (glyph.w > atlas_width)
+        glyph.w = atlas_width;
+
+    /* Find a place in the atlas, starting a new shelf if needed */
+    if ((shelf_x + glyph.w) > atlas_width) {
+        shelf_x = 0;
+        shelf_y += shelf_h;
+        shelf_h = 0;
+    }
+    glyph.atlas_x = shelf_x;
+    glyph.atlas_y = shelf_y;
+    shelf_x += glyph.w;
+    if (glyph.h > shelf_h)
+        shelf_h = glyph.h;
+
+    if (atlas.size() < static_cast<size_t>((shelf_y + shelf_h) * atlas_width))
+        atlas.resize((shelf_y + shelf_h) * atlas_width, 0);
+
+    for (int row = 0; row < glyph.h; row++)
+        memcpy(&atlas[(glyph.atlas_y + row) * atlas_width + glyph.atlas_x], buffer + row * pitch, glyph.w);
+
+    glyph.valid = true;
+    return glyph;
+}
+
+int GlyphAtlas::getKerning(uint8_t prev, uint8_t c)
+{
+    if (kernings.empty())
+        kernings.assign(256*256, INT8_MIN);
+
+    int8_t& k = kernings[(prev << 8) | c];
+    if (k == INT8_MIN) {
+        int delta = TTF_GetFontKerningSizeGlyphs(font, prev, c);
+        if (delta < -127) delta = -127;
+        if (delta > 127) delta = 127;
+        k = delta;
+    }
+    return k;
+}
+
+bool GlyphAtlas::sizeText(const char* text, int& w, int& h)
+{
+    /* Same computation as TTF_SizeUTF8() */
+    int minx = 0, maxx = 0;
+    int miny = 0, maxy = 0;
+    int x = 0;
+    int prev = -1;
+
+    for (const uint8_t* c = reinterpret_cast<const uint8_t*>(text); *c; c++) {
+        const Glyph& glyph = getGlyph(*c);
+        if (!glyph.valid) {
+            debuglogstdio(LCF_WINDOW | LCF_ERROR, "Could not load glyph %d", *c);
+            return false;
+        }
+
+        if (kerning && (prev >= 0) && glyph.provided)
+            x += getKerning(prev, *c);
+
+        int z = x + glyph.minx;
+        if (minx > z)
+            minx = z;
+
+        z = x + ((glyph.advance > glyph.maxx) ? glyph.advance : glyph.maxx);
+        if (maxx < z)
+            maxx = z;
+
+        x += glyph.advance;
+
+        if (glyph.miny < miny)
+            miny = glyph.miny;
+        if (glyph.maxy > maxy)
+            maxy = glyph.maxy;
+
+        prev = glyph.provided ? *c : -1;
+    }
+
+    w = (maxx - minx) + 2 * outline;
+    h = (ascent - miny) + 2 * outline;
+    if (h < height)
+        h = height;
+
+    return w > 0;
+}
+
+void GlyphAtlas::drawText(const char* text, Color color, SurfaceARGB* surf, int x, int y)
+{
+    uint32_t rgb = (color.r << 16) | (color.g << 8) | color.b;
+
+    /* Same layout as TTF_RenderUTF8_Blended(), glyphs are already cached */
+    int xstart = 0;
+    bool first = true;
+    int prev = -1;
+
+    for (const uint8_t* c = reinterpret_cast<const uint8_t*>(text); *c; c++) {
+        const Glyph& glyph = getGlyph(*c);
+        if (!glyph.valid)
+            return;
+
+        if (kerning && (prev >= 0) && glyph.provided)
+            xstart += getKerning(prev, *c);
+
+        /* Compensate for the wrap around bug with negative minx's */
+        if (first && (glyph.minx < 0))
+            xstart -= glyph.minx;
+        first = false;
+
+        /* Glyphs always fit inside the text surface as computed by
+         * sizeText(), so we only need to clip to the destination surface */
+        int gx = x + xstart + glyph.minx;
+        int gy = y + glyph.yoffset;
+        int col0 = (gx < 0) ? -gx : 0;
+        int col1 = (gx + glyph.w > surf->w) ? (surf->w - gx) : glyph.w;
+        int row0 = (gy < 0) ? -gy : 0;
+        int row1 = (gy + glyph.h > surf->h) ? (surf->h - gy) : glyph.h;
+
+        for (int row = row0; row < row1; row++) {
+            const uint8_t* src = &atlas[(glyph.atlas_y + row) * atlas_width + glyph.atlas_x];
+            uint32_t* dst = surf->pixels.data() + (gy + row) * surf->w + gx;
+            for (int col = col0; col < col1; col++) {
+                if (src[col])
+                    SurfaceARGB::blendValue(dst[col], rgb | (src[col] << 24));
+            }
+        }
+
+        xstart += glyph.advance;
+        prev = glyph.provided ? *c : -1;
+    }
+}
+
+}
+
+#endif
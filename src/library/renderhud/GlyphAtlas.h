@@ -0,0 +1,104 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#ifdef LIBTAS_ENABLE_HUD
+
+#ifndef LIBTAS_GLYPHATLAS_H_INCL
+#define LIBTAS_GLYPHATLAS_H_INCL
+
+#include "sdl_ttf.h"
+#include "SurfaceARGB.h"
+#include <cstdint>
+#include <vector>
+
+namespace libtas {
+
+/* Persistent cache of the glyphs of a font, so that texts can be drawn
+ * without going through sdl_ttf each time. The coverage of each glyph is
+ * stored in a single 8-bit atlas, and is composed directly into the
+ * destination surface with the text color.
+ *
+ * Texts are Latin-1 strings, like TTF_RenderText_Blended(), so each byte
+ * is a glyph. Layout follows sdl_ttf, so that texts are identical to the
+ * surfaces that TTF_RenderText_Blended() would return.
+ */
+class GlyphAtlas
+{
+    public:
+        GlyphAtlas(TTF_Font* font);
+
+        /* Compute the size of a text, like TTF_SizeText().
+         * @return false if the text cannot be rendered or is empty
+         */
+        bool sizeText(const char* text, int& w, int& h);
+
+        /* Draw a text of specified color into a surface.
+         * @param x      x position of the text surface (top-left corner)
+         * @param y      y position of the text surface (top-left corner)
+         */
+        void drawText(const char* text, Color color, SurfaceARGB* surf, int x, int y);
+
+    private:
+        struct Glyph
+        {
+            bool cached = false;
+            bool valid = false;
+
+            /* Is the glyph provided by the font, used for kerning */
+            bool provided = false;
+
+            /* Position of the glyph pixmap inside the atlas, and its size */
+            int atlas_x, atlas_y;
+            int w, h;
+
+            int minx, maxx, miny, maxy;
+            int yoffset;
+            int advance;
+        };
+
+        /* Get a glyph, loading it into the atlas if needed */
+        const Glyph& getGlyph(uint8_t c);
+
+        /* Get the kerning between two glyphs */
+        int getKerning(uint8_t prev, uint8_t c);
+
+        TTF_Font* font;
+        int outline;
+        int ascent;
+        int height;
+        bool kerning;
+
+        Glyph glyphs[256];
+
+        /* Kerning of each pair of glyphs, computed on first use */
+        std::vector<int8_t> kernings;
+
+        /* Glyph pixmaps, packed in horizontal shelves */
+        static const int atlas_width = 512;
+        std::vector<uint8_t> atlas;
+        int shelf_x = 0;
+        int shelf_y = 0;
+        int shelf_h = 0;
+};
+
+}
+
+#endif
+#endif
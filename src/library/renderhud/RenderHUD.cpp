@@ -23,26 +23,36 @@
 #include "../logging.h"
 #include "../hook.h"
 #include <sstream>
+#include <cstring>
+#include <cstdlib>
 #include "../global.h" // shared_config
 #include <fontconfig/fontconfig.h>
 // #include <X11/keysym.h>
 #include "../ScreenCapture.h"
+#include "../../shared/LuaDrawList.h"
 #include <X11/Xlib.h> // XKeysymToString
 
 namespace libtas {
 
 TTF_Font* RenderHUD::fg_font = nullptr;
 TTF_Font* RenderHUD::bg_font = nullptr;
+std::unique_ptr<GlyphAtlas> RenderHUD::fg_atlas;
+std::unique_ptr<GlyphAtlas> RenderHUD::bg_atlas;
+std::list<RenderHUD::CachedText> RenderHUD::text_cache;
+std::unordered_map<std::string, std::list<RenderHUD::CachedText>::iterator> RenderHUD::text_cache_index;
+std::string RenderHUD::text_key;
 std::list<std::pair<std::string, TimeHolder>> RenderHUD::messages;
 std::list<std::string> RenderHUD::watches;
-std::list<RenderHUD::LuaText> RenderHUD::lua_texts;
-std::list<RenderHUD::LuaPixel> RenderHUD::lua_pixels;
-std::list<RenderHUD::LuaRect> RenderHUD::lua_rects;
+std::vector<uint8_t> RenderHUD::lua_draw_list;
 int RenderHUD::outline_size = 1;
 int RenderHUD::font_size = 20;
 
 RenderHUD::~RenderHUD()
 {
+    text_cache_index.clear();
+    text_cache.clear();
+    fg_atlas.reset();
+    bg_atlas.reset();
     if (fg_font) {
         TTF_CloseFont(fg_font);
         fg_font = nullptr;
@@ -117,6 +127,9 @@ void RenderHUD::initFonts()
             }
 
             TTF_SetFontOutline(bg_font, outline_size);
+
+            fg_atlas.reset(new GlyphAtlas(fg_font));
+            bg_atlas.reset(new GlyphAtlas(bg_font));
         }
         else {
             debuglogstdio(LCF_WINDOW | LCF_ERROR, "We didn't find any regular TTF font !");
@@ -127,44 +140,223 @@ void RenderHUD::initFonts()
     }
 }
 
-void RenderHUD::renderText(const char* text, Color fg_color, Color bg_color, int x, int y)
+std::shared_ptr<SurfaceARGB> RenderHUD::getTextSurface(const char* text, Color fg_color, Color bg_color)
 {
-    if (!fg_font)
-        return;
+    text_key.assign(text);
+    text_key.push_back('\0');
+    text_key.push_back(fg_color.r);
+    text_key.push_back(fg_color.g);
+    text_key.push_back(fg_color.b);
+    text_key.push_back(bg_color.r);
+    text_key.push_back(bg_color.g);
+    text_key.push_back(bg_color.b);
+
+    auto it = text_cache_index.find(text_key);
+    if (it != text_cache_index.end()) {
+        /* Move the text at the front of the cache */
+        text_cache.splice(text_cache.begin(), text_cache, it->second);
+        return it->second->surface;
+    }
 
-    std::unique_ptr<SurfaceARGB> fg_surf = TTF_RenderText_Blended(fg_font, text, fg_color);
-    std::unique_ptr<SurfaceARGB> bg_surf = TTF_RenderText_Blended(bg_font, text, bg_color);
+    /* The outline surface is the largest */
+    int w, h;
+    if (!bg_atlas->sizeText(text, w, h))
+        return nullptr;
 
-    if (bg_surf) {
-        /* Blit text onto its outline. */
-        bg_surf->blit(fg_surf.get(), outline_size, outline_size);
+    /* Draw the text onto its outline, with a transparent background */
+    std::shared_ptr<SurfaceARGB> surf(new SurfaceARGB(w, h));
+    surf->fill({bg_color.r, bg_color.g, bg_color.b, 0});
+    bg_atlas->drawText(text, bg_color, surf.get(), 0, 0);
+    fg_atlas->drawText(text, fg_color, surf.get(), outline_size, outline_size);
 
-        renderSurface(std::move(bg_surf), x, y);
-    }
-    else {
-        debuglogstdio(LCF_WINDOW | LCF_ERROR, "Could not generate a text surface!");
+    text_cache.push_front({text_key, surf});
+    text_cache_index[text_key] = text_cache.begin();
+
+    /* Evict the least recently used text */
+    if (text_cache.size() > text_cache_size) {
+        text_cache_index.erase(text_cache.back().key);
+        text_cache.pop_back();
     }
+
+    return surf;
+}
+
+void RenderHUD::renderText(const char* text, Color fg_color, Color bg_color, int x, int y)
+{
+    if (!bg_atlas)
+        return;
+
+    std::shared_ptr<SurfaceARGB> surf = getTextSurface(text, fg_color, bg_color);
+    if (!surf)
+        return;
+
+    DrawItem& item = pushDrawItem(DrawItem::TEXT, x, y, surf->w, surf->h);
+    item.surface = std::move(surf);
 }
 
 void RenderHUD::renderPixel(int x, int y, Color color)
 {
-    std::unique_ptr<SurfaceARGB> surf(new SurfaceARGB(1, 1));
-    surf->fill(color);
-    renderSurface(std::move(surf), x, y);        
+    DrawItem& item = pushDrawItem(DrawItem::PIXEL, x, y, 1, 1);
+    item.color = color;
 }
 
 void RenderHUD::renderRect(int x, int y, int w, int h, int t, Color outline_color, Color fill_color)
 {
-    std::unique_ptr<SurfaceARGB> surf(new SurfaceARGB(w, h));
-    surf->fill(fill_color);
-    surf->fillBorder(outline_color, t);
-    renderSurface(std::move(surf), x, y);        
+    if ((w <= 0) || (h <= 0))
+        return;
+
+    DrawItem& item = pushDrawItem(DrawItem::RECT, x, y, w, h);
+    item.thickness = t;
+    item.color = outline_color;
+    item.bg_color = fill_color;
+}
+
+void RenderHUD::renderLine(int x0, int y0, int x1, int y1, Color color)
+{
+    /* Bresenham's algorithm */
+    int dx = std::abs(x1 - x0);
+    int dy = -std::abs(y1 - y0);
+    int sx = (x0 < x1) ? 1 : -1;
+    int sy = (y0 < y1) ? 1 : -1;
+    int err = dx + dy;
+
+    while (true) {
+        renderPixel(x0, y0, color);
+        if ((x0 == x1) && (y0 == y1))
+            break;
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void RenderHUD::renderPixels(int x, int y, int w, int h, const uint8_t* colors)
+{
+    if ((w <= 0) || (h <= 0))
+        return;
+
+    auto surf = std::make_shared<SurfaceARGB>(w, h);
+    memcpy(surf->pixels.data(), colors, w * h * sizeof(uint32_t));
+
+    DrawItem& item = pushDrawItem(DrawItem::IMAGE, x, y, w, h);
+    item.surface = std::move(surf);
+}
+
+RenderHUD::DrawItem& RenderHUD::pushDrawItem(DrawItem::Type type, int x, int y, int w, int h)
+{
+    if (draw_count == draw_list.size())
+        draw_list.emplace_back();
+
+    DrawItem& item = draw_list[draw_count++];
+    item.type = type;
+
+    /* Change the coords so that the element fills on screen */
+    item.x = (x + w + 5) > screen_width ? (screen_width - w - 5) : x;
+    item.y = (y + h + 5) > screen_height ? (screen_height - h - 5) : y;
+    item.w = w;
+    item.h = h;
+    return item;
+}
+
+void RenderHUD::renderDrawList()
+{
+    if (draw_count == 0)
+        return;
+
+    /* Get the area covered by all elements, inside the screen */
+    int x0 = screen_width, y0 = screen_height, x1 = 0, y1 = 0;
+    for (size_t i = 0; i < draw_count; i++) {
+        const DrawItem& item = draw_list[i];
+        if (item.x < x0) x0 = item.x;
+        if (item.y < y0) y0 = item.y;
+        if (item.x + item.w > x1) x1 = item.x + item.w;
+        if (item.y + item.h > y1) y1 = item.y + item.h;
+    }
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > screen_width) x1 = screen_width;
+    if (y1 > screen_height) y1 = screen_height;
+
+    if ((x1 <= x0) || (y1 <= y0)) {
+        for (size_t i = 0; i < draw_count; i++)
+            draw_list[i].surface.reset();
+        draw_count = 0;
+        return;
+    }
+
+    overlay.resize(x1 - x0, y1 - y0);
+    overlay_rects.clear();
+
+    /* Composite all elements in order */
+    for (size_t i = 0; i < draw_count; i++) {
+        const DrawItem& item = draw_list[i];
+        int x = item.x - x0;
+        int y = item.y - y0;
+
+        switch (item.type) {
+            case DrawItem::TEXT:
+            case DrawItem::IMAGE:
+                overlay.blend(item.surface.get(), x, y);
+                break;
+            case DrawItem::PIXEL:
+                overlay.blendPixel(x, y, SurfaceARGB::colorToValue(item.color));
+                break;
+            case DrawItem::RECT: {
+                uint32_t outline = SurfaceARGB::colorToValue(item.color);
+                int t = (item.thickness > 0) ? item.thickness : 0;
+                if ((2*t >= item.w) || (2*t >= item.h)) {
+                    overlay.blendRect(x, y, item.w, item.h, outline);
+                }
+                else {
+                    overlay.blendRect(x, y, item.w, t, outline);
+                    overlay.blendRect(x, y + item.h - t, item.w, t, outline);
+                    overlay.blendRect(x, y + t, t, item.h - 2*t, outline);
+                    overlay.blendRect(x + item.w - t, y + t, t, item.h - 2*t, outline);
+                    overlay.blendRect(x + t, y + t, item.w - 2*t, item.h - 2*t, SurfaceARGB::colorToValue(item.bg_color));
+                }
+                break;
+            }
+        }
+
+        /* Store the covered area, clipped to the overlay */
+        int rx0 = (x < 0) ? 0 : x;
+        int ry0 = (y < 0) ? 0 : y;
+        int rx1 = (x + item.w > overlay.w) ? overlay.w : (x + item.w);
+        int ry1 = (y + item.h > overlay.h) ? overlay.h : (y + item.h);
+        if ((rx1 <= rx0) || (ry1 <= ry0))
+            continue;
+
+        /* Merge with the previous area when on the same row, which happens
+         * a lot for lines drawn pixel by pixel */
+        if (!overlay_rects.empty()) {
+            Rect& last = overlay_rects.back();
+            if ((last.y == ry0) && (last.h == (ry1 - ry0)) && (last.x + last.w == rx0)) {
+                last.w += rx1 - rx0;
+                continue;
+            }
+        }
+        overlay_rects.push_back({rx0, ry0, rx1 - rx0, ry1 - ry0});
+    }
+
+    /* Release text surfaces that were evicted from the cache */
+    for (size_t i = 0; i < draw_count; i++)
+        draw_list[i].surface.reset();
+
+    draw_count = 0;
+
+    renderOverlay(&overlay, x0, y0, overlay_rects);
 }
 
 void RenderHUD::locationToCoords(int location, int& x, int& y)
 {
-    int width, height;
-    ScreenCapture::getDimensions(width, height);
+    int width = screen_width;
+    int height = screen_height;
 
     if (location & SharedConfig::OSD_LEFT)         x = 5;
     else if (location & SharedConfig::OSD_HCENTER) x = width / 2;
@@ -351,76 +543,125 @@ void RenderHUD::drawWatches()
     }
 }
 
-void RenderHUD::drawLua()
+/* Read a value from the lua display list, or return false if the list is
+ * truncated */
+template<typename T>
+static bool readDrawList(const std::vector<uint8_t>& list, size_t& pos, T& value)
 {
-    for (auto iter = lua_texts.begin(); iter != lua_texts.end(); iter++) {
-        renderText(iter->text.c_str(), iter->fg_color, iter->bg_color, iter->x, iter->y);
-    }
-    for (auto iter = lua_pixels.begin(); iter != lua_pixels.end(); iter++) {
-        renderPixel(iter->x, iter->y, iter->color);
-    }
-    for (auto iter = lua_rects.begin(); iter != lua_rects.end(); iter++) {
-        renderRect(iter->x, iter->y, iter->w, iter->h, iter->thickness, iter->outline, iter->fill);
-    }
+    if (pos + sizeof(T) > list.size())
+        return false;
+    memcpy(&value, &list[pos], sizeof(T));
+    pos += sizeof(T);
+    return true;
 }
 
-void RenderHUD::insertLuaText(int x, int y, std::string text, uint32_t fg_color, uint32_t bg_color)
+static Color luaColor(uint32_t color)
 {
-    LuaText lt;
-    lt.x = x;
-    lt.y = y;
-    lt.text = text;
-    lt.fg_color = {static_cast<uint8_t>((fg_color >> 16) & 0xff),
-                   static_cast<uint8_t>((fg_color >> 8) & 0xff),
-                   static_cast<uint8_t>(fg_color & 0xff),
-                   static_cast<uint8_t>((fg_color >> 24) & 0xff)};
-    lt.bg_color = {static_cast<uint8_t>((bg_color >> 16) & 0xff),
-                   static_cast<uint8_t>((bg_color >> 8) & 0xff),
-                   static_cast<uint8_t>(bg_color & 0xff),
-                   static_cast<uint8_t>((bg_color >> 24) & 0xff)};
-    lua_texts.push_back(lt);
+    return {static_cast<uint8_t>((color >> 16) & 0xff),
+            static_cast<uint8_t>((color >> 8) & 0xff),
+            static_cast<uint8_t>(color & 0xff),
+            static_cast<uint8_t>((color >> 24) & 0xff)};
 }
 
-void RenderHUD::insertLuaPixel(int x, int y, uint32_t color)
+void RenderHUD::drawLua()
 {
-    LuaPixel lp;
-    lp.x = x;
-    lp.y = y;
-    lp.color = {static_cast<uint8_t>((color >> 16) & 0xff),
-                static_cast<uint8_t>((color >> 8) & 0xff),
-                static_cast<uint8_t>(color & 0xff),
-                static_cast<uint8_t>((color >> 24) & 0xff)};
-    lua_pixels.push_back(lp);
+    /* Draw elements in the order they were inserted by the script */
+    const std::vector<uint8_t>& list = lua_draw_list;
+    size_t pos = 0;
+    uint8_t command;
+    while (readDrawList(list, pos, command)) {
+        switch (command) {
+            case LuaDrawList::TEXT: {
+                int32_t x, y;
+                uint32_t fg, bg, len;
+                if (!readDrawList(list, pos, x) || !readDrawList(list, pos, y) ||
+                    !readDrawList(list, pos, fg) || !readDrawList(list, pos, bg) ||
+                    !readDrawList(list, pos, len) || (pos + len > list.size()))
+                    return;
+                std::string text(reinterpret_cast<const char*>(&list[pos]), len);
+                pos += len;
+                renderText(text.c_str(), luaColor(fg), luaColor(bg), x, y);
+                break;
+            }
+            case LuaDrawList::PIXEL: {
+                int32_t x, y;
+                uint32_t color;
+                if (!readDrawList(list, pos, x) || !readDrawList(list, pos, y) ||
+                    !readDrawList(list, pos, color))
+                    return;
+                renderPixel(x, y, luaColor(color));
+                break;
+            }
+            case LuaDrawList::RECT: {
+                int32_t x, y, w, h, thickness;
+                uint32_t outline, fill;
+                if (!readDrawList(list, pos, x) || !readDrawList(list, pos, y) ||
+                    !readDrawList(list, pos, w) || !readDrawList(list, pos, h) ||
+                    !readDrawList(list, pos, thickness) ||
+                    !readDrawList(list, pos, outline) || !readDrawList(list, pos, fill))
+                    return;
+                renderRect(x, y, w, h, thickness, luaColor(outline), luaColor(fill));
+                break;
+            }
+            case LuaDrawList::LINE: {
+                int32_t x0, y0, x1, y1;
+                uint32_t color;
+                if (!readDrawList(list, pos, x0) || !readDrawList(list, pos, y0) ||
+                    !readDrawList(list, pos, x1) || !readDrawList(list, pos, y1) ||
+                    !readDrawList(list, pos, color))
+                    return;
+                renderLine(x0, y0, x1, y1, luaColor(color));
+                break;
+            }
+            case LuaDrawList::POLYLINE: {
+                uint32_t color, n;
+                if (!readDrawList(list, pos, color) || !readDrawList(list, pos, n) ||
+                    (n > (list.size() - pos) / (2 * sizeof(int32_t))))
+                    return;
+                int32_t x0, y0, x1, y1;
+                for (uint32_t i = 0; i < n; i++) {
+                    readDrawList(list, pos, x1);
+                    readDrawList(list, pos, y1);
+                    if (i > 0)
+                        renderLine(x0, y0, x1, y1, luaColor(color));
+                    x0 = x1;
+                    y0 = y1;
+                }
+                break;
+            }
+            case LuaDrawList::PIXELS: {
+                int32_t x, y, w, h;
+                if (!readDrawList(list, pos, x) || !readDrawList(list, pos, y) ||
+                    !readDrawList(list, pos, w) || !readDrawList(list, pos, h) ||
+                    (w < 0) || (h < 0) ||
+                    (static_cast<uint64_t>(w) * h * sizeof(uint32_t) > list.size() - pos))
+                    return;
+                renderPixels(x, y, w, h, &list[pos]);
+                pos += w * h * sizeof(uint32_t);
+                break;
+            }
+            default:
+                debuglogstdio(LCF_WINDOW | LCF_ERROR, "Unknown lua draw command %d", command);
+                return;
+        }
+    }
 }
 
-void RenderHUD::insertLuaRect(int x, int y, int w, int h, int thickness, uint32_t outline, uint32_t fill)
+void RenderHUD::setLuaDrawList(std::vector<uint8_t>& list)
 {
-    LuaRect lr;
-    lr.x = x;
-    lr.y = y;
-    lr.w = w;
-    lr.h = h;
-    lr.thickness = thickness;
-    lr.outline = {static_cast<uint8_t>((outline >> 16) & 0xff),
-                  static_cast<uint8_t>((outline >> 8) & 0xff),
-                  static_cast<uint8_t>(outline & 0xff),
-                  static_cast<uint8_t>((outline >> 24) & 0xff)};
-    lr.fill = {static_cast<uint8_t>((fill >> 16) & 0xff),
-               static_cast<uint8_t>((fill >> 8) & 0xff),
-               static_cast<uint8_t>(fill & 0xff),
-               static_cast<uint8_t>((fill >> 24) & 0xff)};
-    lua_rects.push_back(lr);
+    lua_draw_list.swap(list);
 }
 
 void RenderHUD::resetLua()
 {
-    lua_texts.clear();
-    lua_pixels.clear();
-    lua_rects.clear();
+    lua_draw_list.clear();
 }
 
 void RenderHUD::drawAll(uint64_t framecount, uint64_t nondraw_framecount, const AllInputs& ai, const AllInputs& preview_ai)
 {
+    ScreenCapture::getDimensions(screen_width, screen_height);
+    draw_count = 0;
+
     resetOffsets();
     if (shared_config.osd & SharedConfig::OSD_FRAMECOUNT) {
         drawFrame(framecount);
@@ -440,6 +681,7 @@ void RenderHUD::drawAll(uint64_t framecount, uint64_t nondraw_framecount, const
     if (shared_config.osd & SharedConfig::OSD_LUA)
         drawLua();
 
+    renderDrawList();
 }
 
 }
@@ -26,10 +26,13 @@
 //#include "../../external/SDL.h"
 #include "sdl_ttf.h"
 #include "SurfaceARGB.h"
+#include "GlyphAtlas.h"
 #include "../../shared/AllInputs.h"
 #include "../TimeHolder.h"
 #include <memory>
 #include <list>
+#include <vector>
+#include <unordered_map>
 #include <utility>
 #include <string>
 #include <stdint.h>
@@ -39,12 +42,14 @@ namespace libtas {
  *
  * Because games have different methods of rendering, this class
  * should be derived for each rendering method. The subclass must
- * define the renderText() and size() functions
+ * define the renderOverlay() function
  *
- * As a helper, this class provide a method to create a surface from
- * a text, based on the sdl_ttf library. This library was modified so
- * that it does not depend on SDL anymore. It returns now a standard
- * 32-bit surface using the ARGB mask, encapsulated in a SurfaceARGB object.
+ * Elements of the HUD (texts, pixels and rects) are stored in a draw list
+ * during the frame, and composited at the end into a single 32-bit ARGB
+ * surface, so that each renderer only has to draw one surface per frame.
+ * Texts are drawn using a glyph atlas for each font, filled by the sdl_ttf
+ * library. This library was modified so that it does not depend on SDL
+ * anymore.
  *
  * This class is also responsible on formatting and positioning the
  * different elements of the HUD.
@@ -57,13 +62,24 @@ class RenderHUD
         /* Initialize the font located at the given path */
         static void initFonts();
 
-        /* Main function to render something on the screen.
+        /* Area of the overlay covered by an element */
+        struct Rect
+        {
+            int x;
+            int y;
+            int w;
+            int h;
+        };
+
+        /* Main function to render the HUD on the screen.
          * This function does nothing in this class and must be overridden.
-         * @param surface   Surface to render
-         * @param x         x position of the text (top-left corner)
-         * @param y         y position of the text (top-left corner)
+         * @param overlay   Surface containing all elements of the HUD
+         * @param x         x position of the overlay (top-left corner)
+         * @param y         y position of the overlay (top-left corner)
+         * @param rects     Areas of the overlay covered by elements, for
+         *                  renderers that cannot blend the overlay
          */
-        virtual void renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y) {};
+        virtual void renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects) {};
 
         /* Display everything based on setting */
         void drawAll(uint64_t framecount, uint64_t nondraw_framecount, const AllInputs& ai, const AllInputs& preview_ai);
@@ -77,14 +93,10 @@ class RenderHUD
         /* Clear the list of watches */
         static void resetWatches();
 
-        /* Insert a lua text to be displayed */
-        static void insertLuaText(int x, int y, std::string text, uint32_t fg, uint32_t bg);
-
-        /* Insert a lua pixel to be displayed */
-        static void insertLuaPixel(int x, int y, uint32_t color);
-
-        /* Insert a lua rect to be displayed */
-        static void insertLuaRect(int x, int y, int w, int h, int thickness, uint32_t outline, uint32_t fill);
+        /* Set the display list of lua drawings, as described in
+         * LuaDrawList.h. The list is swapped with the previous one, so that
+         * its storage can be reused */
+        static void setLuaDrawList(std::vector<uint8_t>& list);
 
         /* Clear all lua drawings */
         static void resetLua();
@@ -98,6 +110,39 @@ class RenderHUD
         /* Reset offsets to 0 */
         void resetOffsets();
 
+        /* Element of the draw list, in screen coordinates */
+        struct DrawItem
+        {
+            enum Type {
+                TEXT,
+                PIXEL,
+                RECT,
+                IMAGE,
+            };
+            Type type;
+            int x;
+            int y;
+            int w;
+            int h;
+            int thickness;
+            Color color; // pixel or outline color
+            Color bg_color; // rect fill color
+            std::shared_ptr<SurfaceARGB> surface; // rendered text or image
+        };
+
+        /* Append an element to the draw list, moving it so that it fits on
+         * screen */
+        DrawItem& pushDrawItem(DrawItem::Type type, int x, int y, int w, int h);
+
+        /* Composite all elements of the draw list into the overlay and
+         * render it */
+        void renderDrawList();
+
+        /* Get the surface of a text with its outline, from the cache of
+         * rendered texts if possible. Returns nullptr if the text is empty.
+         */
+        std::shared_ptr<SurfaceARGB> getTextSurface(const char* text, Color fg_color, Color bg_color);
+
         /* Render text of specified color and outline
          * @param text      Text to display
          * @param fg_color  Color of the text
@@ -121,6 +166,22 @@ class RenderHUD
          */
         void renderRect(int x, int y, int w, int h, int t, Color outline_color, Color fill_color);
 
+        /* Render a line, pixel by pixel
+         * @param x0     x position of the first end
+         * @param y0     y position of the first end
+         * @param x1     x position of the second end
+         * @param y1     y position of the second end
+         * @param color  Color of the line
+         */
+        void renderLine(int x0, int y0, int x1, int y1, Color color);
+
+        /* Render an array of pixels
+         * @param x       x position of the array (top-left corner)
+         * @param y       y position of the array (top-left corner)
+         * @param colors  ARGB values of the pixels, row by row
+         */
+        void renderPixels(int x, int y, int w, int h, const uint8_t* colors);
+
 
         /*** Draw specific information on screen ***/
 
@@ -149,6 +210,37 @@ class RenderHUD
         static TTF_Font* fg_font;
         static TTF_Font* bg_font;
 
+        static std::unique_ptr<GlyphAtlas> fg_atlas;
+        static std::unique_ptr<GlyphAtlas> bg_atlas;
+
+        /* Cache of rendered texts, with the most recently used first. Most
+         * texts are identical from one frame to the next, so they are only
+         * rendered once. Keys are the text followed by its colors. */
+        struct CachedText
+        {
+            std::string key;
+            std::shared_ptr<SurfaceARGB> surface;
+        };
+        static std::list<CachedText> text_cache;
+        static std::unordered_map<std::string, std::list<CachedText>::iterator> text_cache_index;
+        static const size_t text_cache_size = 128;
+
+        /* Buffer to build cache keys, to avoid allocations */
+        static std::string text_key;
+
+        /* Elements to draw this frame. Items are reused between frames to
+         * avoid reallocating strings, only the first `draw_count` are valid */
+        std::vector<DrawItem> draw_list;
+        size_t draw_count = 0;
+
+        /* Composited elements and their areas */
+        SurfaceARGB overlay{0, 0};
+        std::vector<Rect> overlay_rects;
+
+        /* Screen dimensions of the current frame */
+        int screen_width;
+        int screen_height;
+
         /* Location offsets when displaying multiple texts on the same location */
         int offsets[9];
 
@@ -158,41 +250,8 @@ class RenderHUD
         /* Ram watches to print on screen */
         static std::list<std::string> watches;
 
-        struct LuaText
-        {
-            std::string text;
-            Color fg_color;
-            Color bg_color;
-            int x;
-            int y;
-        };
-
-        /* Lua texts to print on screen */
-        static std::list<LuaText> lua_texts;
-
-        struct LuaPixel
-        {
-            int x;
-            int y;
-            Color color;
-        };
-
-        /* Lua pixels to print on screen */
-        static std::list<LuaPixel> lua_pixels;
-
-        struct LuaRect
-        {
-            int x;
-            int y;
-            int w;
-            int h;
-            int thickness;
-            Color outline;
-            Color fill;
-        };
-
-        /* Lua rects to print on screen */
-        static std::list<LuaRect> lua_rects;
+        /* Display list of lua drawings */
+        static std::vector<uint8_t> lua_draw_list;
 
 };
 }
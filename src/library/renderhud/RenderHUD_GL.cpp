@@ -118,7 +118,7 @@ void RenderHUD_GL::fini()
     }
 }
 
-void RenderHUD_GL::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y)
+void RenderHUD_GL::renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects)
 {
     RenderHUD_GL::init();
 
@@ -164,7 +164,7 @@ void RenderHUD_GL::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y
     GLint oldActiveTex;
     orig::glGetIntegerv(GL_ACTIVE_TEXTURE, &oldActiveTex);
 
-    /* Create our text as a texture */
+    /* Create our overlay as a texture */
     orig::glActiveTexture(GL_TEXTURE0);
     if ((error = orig::glGetError()) != GL_NO_ERROR)
         debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glActiveTexture failed with error %d", error);
@@ -185,7 +185,7 @@ void RenderHUD_GL::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y
     orig::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     orig::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    orig::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surf->w, surf->h, 0, GL_BGRA, GL_UNSIGNED_BYTE, surf->pixels.data());
+    orig::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, overlay->w, overlay->h, 0, GL_BGRA, GL_UNSIGNED_BYTE, overlay->pixels.data());
     if ((error = orig::glGetError()) != GL_NO_ERROR)
         debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glTexImage2D failed with error %d", error);
 
@@ -197,16 +197,15 @@ void RenderHUD_GL::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y
     int width, height;
     ScreenCapture::getDimensions(width, height);
 
-    /* Change the coords so that the text fills on screen */
-    x = (x + surf->w + 5) > width ? (width - surf->w - 5) : x;
-    y = (y + surf->h + 5) > height ? (height - surf->h - 5) : y;
-
     orig::glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
     if ((error = orig::glGetError()) != GL_NO_ERROR)
         debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBindFramebuffer failed with error %d", error);
 
-    orig::glBlitFramebuffer(0, 0, surf->w, surf->h, x, height-y, x+surf->w, height-(y+surf->h),
-                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    /* Blitting does not blend, so only blit the areas covered by elements */
+    for (const Rect& r : rects) {
+        orig::glBlitFramebuffer(r.x, r.y, r.x+r.w, r.y+r.h, x+r.x, height-(y+r.y), x+r.x+r.w, height-(y+r.y+r.h),
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
     if ((error = orig::glGetError()) != GL_NO_ERROR)
         debuglogstdio(LCF_WINDOW | LCF_OGL | LCF_ERROR, "glBlitFramebuffer failed with error %d", error);
 
@@ -41,7 +41,7 @@ class RenderHUD_GL : public RenderHUD
         /* Deallocate texture and fbo */
         static void fini();
 
-        void renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y);
+        void renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects);
     private:
         static GLuint texture;
         static GLuint fbo;
@@ -42,7 +42,7 @@ RenderHUD_SDL1::~RenderHUD_SDL1()
 {
 }
 
-void RenderHUD_SDL1::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y)
+void RenderHUD_SDL1::renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects)
 {
     LINK_NAMESPACE_SDL1(SDL_CreateRGBSurfaceFrom);
     LINK_NAMESPACE_SDL1(SDL_FreeSurface);
@@ -53,13 +53,9 @@ void RenderHUD_SDL1::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int
 
     GlobalNative gn;
 
-    SDL1::SDL_Surface* sdlsurf = orig::SDL_CreateRGBSurfaceFrom(surf->pixels.data(), surf->w, surf->h, 32, surf->pitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    SDL1::SDL_Surface* sdlsurf = orig::SDL_CreateRGBSurfaceFrom(overlay->pixels.data(), overlay->w, overlay->h, 32, overlay->pitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
     SDL1::SDL_Surface* screen = orig::SDL_GetVideoSurface();
 
-    /* Change the coords so that the text fills on screen */
-    x = (x + surf->w + 5) > screen->w ? (screen->w - surf->w - 5) : x;
-    y = (y + surf->h + 5) > screen->h ? (screen->h - surf->h - 5) : y;
-
     SDL1::SDL_Rect rect = {static_cast<Sint16>(x), static_cast<Sint16>(y), 0, 0}; // width and height are ignored
 
     /* Save and restore the clip rectangle */
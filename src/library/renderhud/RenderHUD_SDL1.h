@@ -30,7 +30,7 @@ class RenderHUD_SDL1 : public RenderHUD
 {
     public:
         ~RenderHUD_SDL1();
-        void renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y);
+        void renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects);
 };
 }
 
@@ -22,13 +22,14 @@
 
 #include "../logging.h"
 #include "../hook.h"
-#include "../ScreenCapture.h"
 
 namespace libtas {
 
 DECLARE_ORIG_POINTER(SDL_CreateRGBSurfaceFrom)
 DECLARE_ORIG_POINTER(SDL_RenderCopy)
 DECLARE_ORIG_POINTER(SDL_CreateTextureFromSurface)
+DECLARE_ORIG_POINTER(SDL_DestroyTexture)
+DECLARE_ORIG_POINTER(SDL_FreeSurface)
 
 RenderHUD_SDL2_renderer::~RenderHUD_SDL2_renderer()
 {
@@ -39,25 +40,24 @@ void RenderHUD_SDL2_renderer::setRenderer(SDL_Renderer* r)
     renderer = r;
 }
 
-void RenderHUD_SDL2_renderer::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y)
+void RenderHUD_SDL2_renderer::renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects)
 {
     LINK_NAMESPACE_SDL2(SDL_CreateRGBSurfaceFrom);
     LINK_NAMESPACE_SDL2(SDL_CreateTextureFromSurface);
     LINK_NAMESPACE_SDL2(SDL_RenderCopy);
+    LINK_NAMESPACE_SDL2(SDL_DestroyTexture);
+    LINK_NAMESPACE_SDL2(SDL_FreeSurface);
 
     GlobalNative gn;
 
-    SDL_Surface* sdlsurf = orig::SDL_CreateRGBSurfaceFrom(surf->pixels.data(), surf->w, surf->h, 32, surf->pitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    SDL_Surface* sdlsurf = orig::SDL_CreateRGBSurfaceFrom(overlay->pixels.data(), overlay->w, overlay->h, 32, overlay->pitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
     SDL_Texture* tex = orig::SDL_CreateTextureFromSurface(renderer, sdlsurf);
 
-    /* Change the coords so that the text fills on screen */
-    int width, height;
-    ScreenCapture::getDimensions(width, height);
-    x = (x + surf->w + 5) > width ? (width - surf->w - 5) : x;
-    y = (y + surf->h + 5) > height ? (height - surf->h - 5) : y;
-
     SDL_Rect rect = {x, y, sdlsurf->w, sdlsurf->h};
     orig::SDL_RenderCopy(renderer, tex, NULL, &rect);
+
+    orig::SDL_DestroyTexture(tex);
+    orig::SDL_FreeSurface(sdlsurf);
 }
 
 }
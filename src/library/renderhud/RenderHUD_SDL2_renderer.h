@@ -32,7 +32,7 @@ class RenderHUD_SDL2_renderer : public RenderHUD
     public:
         ~RenderHUD_SDL2_renderer();
         void setRenderer(SDL_Renderer* r);
-        void renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y);
+        void renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects);
 
     private:
         SDL_Renderer* renderer;
@@ -23,7 +23,6 @@
 #include "../logging.h"
 #include "../hook.h"
 #include "../sdl/sdlwindows.h" // sdl::gameSDLWindow
-#include "../ScreenCapture.h"
 
 #include <SDL2/SDL.h>
 
@@ -32,30 +31,28 @@ namespace libtas {
 DECLARE_ORIG_POINTER(SDL_CreateRGBSurfaceFrom)
 DECLARE_ORIG_POINTER(SDL_GetWindowSurface)
 DECLARE_ORIG_POINTER(SDL_UpperBlit)
+DECLARE_ORIG_POINTER(SDL_FreeSurface)
 
 RenderHUD_SDL2_surface::~RenderHUD_SDL2_surface()
 {
 }
 
-void RenderHUD_SDL2_surface::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y)
+void RenderHUD_SDL2_surface::renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects)
 {
     LINK_NAMESPACE_SDL2(SDL_CreateRGBSurfaceFrom);
     LINK_NAMESPACE_SDL2(SDL_GetWindowSurface);
     LINK_NAMESPACE_SDL2(SDL_UpperBlit);
+    LINK_NAMESPACE_SDL2(SDL_FreeSurface);
 
     GlobalNative gn;
 
-    SDL_Surface* sdlsurf = orig::SDL_CreateRGBSurfaceFrom(surf->pixels.data(), surf->w, surf->h, 32, surf->pitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    SDL_Surface* sdlsurf = orig::SDL_CreateRGBSurfaceFrom(overlay->pixels.data(), overlay->w, overlay->h, 32, overlay->pitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
     SDL_Surface* screensurf = orig::SDL_GetWindowSurface(sdl::gameSDLWindow);
 
-    /* Change the coords so that the text fills on screen */
-    int width, height;
-    ScreenCapture::getDimensions(width, height);
-    x = (x + surf->w + 5) > width ? (width - surf->w - 5) : x;
-    y = (y + surf->h + 5) > height ? (height - surf->h - 5) : y;
-
     SDL_Rect rect = {x, y, sdlsurf->w, sdlsurf->h};
     orig::SDL_UpperBlit(sdlsurf, NULL, screensurf, &rect);
+
+    orig::SDL_FreeSurface(sdlsurf);
 }
 
 }
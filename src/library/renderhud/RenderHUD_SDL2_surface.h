@@ -30,7 +30,7 @@ class RenderHUD_SDL2_surface : public RenderHUD
 {
     public:
         ~RenderHUD_SDL2_surface();
-        void renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y);
+        void renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects);
 };
 }
 
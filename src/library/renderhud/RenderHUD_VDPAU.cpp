@@ -22,7 +22,6 @@
 
 #include "../logging.h"
 #include "../hook.h"
-#include "../ScreenCapture.h"
 #include "../../external/vdpau.h"
 
 namespace libtas {
@@ -48,35 +47,27 @@ void RenderHUD_VDPAU::setSurface(VdpOutputSurface o)
     output_surface = o;
 }
 
-void RenderHUD_VDPAU::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y)
+void RenderHUD_VDPAU::renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects)
 {
     /* Create Vdp bitmap surface */
     VdpBitmapSurface surface;
-    VdpStatus status = orig::VdpBitmapSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, surf->w, surf->h, false, &surface);
+    VdpStatus status = orig::VdpBitmapSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, overlay->w, overlay->h, false, &surface);
     if (status != VDP_STATUS_OK) {
         debuglogstdio(LCF_WINDOW | LCF_ERROR, "VdpBitmapSurfaceCreate failed with status %d", status);
         return;
     }
 
     /* Put surface pixels */
-    uint32_t pitch = surf->pitch;
-    void const* const pix = surf->pixels.data();
+    uint32_t pitch = overlay->pitch;
+    void const* const pix = overlay->pixels.data();
     status = orig::VdpBitmapSurfacePutBitsNative(surface, &pix, &pitch, nullptr);
     if (status != VDP_STATUS_OK) {
         debuglogstdio(LCF_WINDOW | LCF_ERROR, "VdpBitmapSurfacePutBitsNative failed with status %d", status);
+        orig::VdpBitmapSurfaceDestroy(surface);
         return;
     }
 
-    // SDL_Surface* sdlsurf = orig::SDL_CreateRGBSurfaceFrom(surf->pixels.data(), surf->w, surf->h, 32, surf->pitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
-    // SDL_Texture* tex = orig::SDL_CreateTextureFromSurface(renderer, sdlsurf);
-
-    /* Change the coords so that the text fills on screen */
-    int width, height;
-    ScreenCapture::getDimensions(width, height);
-    x = (x + surf->w + 5) > width ? (width - surf->w - 5) : x;
-    y = (y + surf->h + 5) > height ? (height - surf->h - 5) : y;
-
-    VdpRect rect = {static_cast<uint32_t>(x), static_cast<uint32_t>(y), static_cast<uint32_t>(x + surf->w), static_cast<uint32_t>(y + surf->h)};
+    VdpRect rect = {static_cast<uint32_t>(x), static_cast<uint32_t>(y), static_cast<uint32_t>(x + overlay->w), static_cast<uint32_t>(y + overlay->h)};
 
     /* Render the text on the output surface */
     VdpOutputSurfaceRenderBlendState blend_state;
@@ -90,8 +81,9 @@ void RenderHUD_VDPAU::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, in
     status = orig::VdpOutputSurfaceRenderBitmapSurface(output_surface, &rect, surface, nullptr, nullptr, &blend_state, 0);
     if (status != VDP_STATUS_OK) {
         debuglogstdio(LCF_WINDOW | LCF_ERROR, "VdpOutputSurfaceRenderBitmapSurface failed with status %d", status);
-        return;
     }
+
+    orig::VdpBitmapSurfaceDestroy(surface);
 }
 
 }
@@ -33,7 +33,7 @@ class RenderHUD_VDPAU : public RenderHUD
         // ~RenderHUD_SDL2_renderer();
         static void setDevice(VdpDevice d);
         void setSurface(VdpOutputSurface o);
-        void renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y);
+        void renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects);
 
     private:
         static VdpDevice device;
@@ -24,24 +24,17 @@
 #include "SurfaceXImage.h"
 #include "../logging.h"
 #include "../hook.h"
-#include "../ScreenCapture.h"
 #include "../xlib/xshm.h" // x11::gameXImage
 
 namespace libtas {
 
-void RenderHUD_XShm::renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y)
+void RenderHUD_XShm::renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects)
 {
     if (x11::gameXImage->bits_per_pixel == 32) {
         /* Create a SurfaceARGB pointing to the XImage */
         std::unique_ptr<SurfaceXImage> image_surf = std::unique_ptr<SurfaceXImage>(new SurfaceXImage(x11::gameXImage));
 
-        /* Change the coords so that the text fills on screen */
-        int width, height;
-        ScreenCapture::getDimensions(width, height);
-        x = (x + surf->w + 5) > width ? (width - surf->w - 5) : x;
-        y = (y + surf->h + 5) > height ? (height - surf->h - 5) : y;
-
-        image_surf->blit(surf.get(), x, y);
+        image_surf->blit(overlay, x, y);
     }
     else {
         debuglogstdio(LCF_WINDOW | LCF_WARNING, "HUD for surface of depth %d is not supported", x11::gameXImage->bits_per_pixel);
@@ -29,7 +29,7 @@ namespace libtas {
 class RenderHUD_XShm : public RenderHUD
 {
     public:
-        void renderSurface(std::unique_ptr<SurfaceARGB> surf, int x, int y);
+        void renderOverlay(SurfaceARGB* overlay, int x, int y, const std::vector<Rect>& rects);
 };
 }
 
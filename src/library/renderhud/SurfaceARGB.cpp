@@ -21,6 +21,7 @@
 #ifdef LIBTAS_ENABLE_HUD
 
 #include "../logging.h"
+#include <algorithm>
 
 namespace libtas {
 
@@ -122,6 +123,48 @@ void SurfaceARGB::blit(const SurfaceARGB* src, int x, int y)
     }
 }
 
+void SurfaceARGB::resize(int width, int height)
+{
+    w = width;
+    h = height;
+    pitch = 4 * w;
+    pixels.assign(w*h, 0);
+}
+
+void SurfaceARGB::blend(const SurfaceARGB* src, int x, int y)
+{
+    int col0 = (x < 0) ? -x : 0;
+    int col1 = (x + src->w > w) ? (w - x) : src->w;
+    int row0 = (y < 0) ? -y : 0;
+    int row1 = (y + src->h > h) ? (h - y) : src->h;
+
+    for (int row = row0; row < row1; row++) {
+        const uint32_t* srcp = src->pixels.data() + row*src->w;
+        uint32_t* dstp = pixels.data() + (y + row)*w + x;
+        for (int col = col0; col < col1; col++)
+            blendValue(dstp[col], srcp[col]);
+    }
+}
+
+void SurfaceARGB::blendRect(int x, int y, int width, int height, uint32_t value)
+{
+    int x0 = (x < 0) ? 0 : x;
+    int y0 = (y < 0) ? 0 : y;
+    int x1 = (x + width > w) ? w : (x + width);
+    int y1 = (y + height > h) ? h : (y + height);
+
+    for (int py = y0; py < y1; py++) {
+        uint32_t* dst = pixels.data() + py*w;
+        if ((value >> 24) == 0xFF) {
+            std::fill(dst + x0, dst + x1, value);
+        }
+        else {
+            for (int px = x0; px < x1; px++)
+                blendValue(dst[px], value);
+        }
+    }
+}
+
 uint32_t SurfaceARGB::colorToValue(Color color)
 {
     uint32_t value = static_cast<uint32_t>(color.a);
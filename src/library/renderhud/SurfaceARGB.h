@@ -64,10 +64,54 @@ class SurfaceARGB
 
         /* Blit surface `src` into this surface at coords x and y */
         void blit(const SurfaceARGB* src, int x, int y);
-        
-    private:
+
+        /* Change the size of the surface and clear all pixels, keeping the
+         * allocated storage */
+        void resize(int width, int height);
+
+        /* Compose a pixel value over the pixel at coords x and y */
+        void blendPixel(int x, int y, uint32_t value)
+        {
+            if ((x < 0) || (y < 0) || (x >= w) || (y >= h))
+                return;
+
+            blendValue(pixels[y*w+x], value);
+        }
+
+        /* Compose a pixel value over another. A pixel that is still fully
+         * transparent is replaced, so that transparent elements keep their
+         * color for renderers that ignore alpha. */
+        static void blendValue(uint32_t& d, uint32_t value)
+        {
+            uint32_t alpha = value >> 24;
+            if ((alpha == 0xFF) || ((d >> 24) == 0)) {
+                d = value;
+                return;
+            }
+            if (alpha == 0)
+                return;
+
+            /* Same composition as blit() */
+            uint32_t dalpha = d >> 24;
+            uint32_t s1 = value & 0xff00ff;
+            uint32_t d1 = d & 0xff00ff;
+            d1 = (d1 + ((s1 - d1) * alpha >> 8)) & 0xff00ff;
+            uint32_t s2 = value & 0xff00;
+            uint32_t d2 = d & 0xff00;
+            d2 = (d2 + ((s2 - d2) * alpha >> 8)) & 0xff00;
+            dalpha = alpha + (dalpha * (alpha ^ 0xFF) >> 8);
+            d = d1 | d2 | (dalpha << 24);
+        }
+
+        /* Compose surface `src` over this surface at coords x and y, using
+         * the same composition as blendPixel() */
+        void blend(const SurfaceARGB* src, int x, int y);
+
+        /* Compose a rectangle of a certain value at coords x and y */
+        void blendRect(int x, int y, int width, int height, uint32_t value);
+
         /* Compute the value in ARGB32 from a color struct */
-        uint32_t colorToValue(Color color);
+        static uint32_t colorToValue(Color color);
 };
 
 }
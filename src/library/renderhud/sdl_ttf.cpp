@@ -1733,6 +1733,31 @@ int TTF_GetFontKerningSizeGlyphs(TTF_Font *font, uint16_t previous_ch, uint16_t
     return (delta.x >> 6);
 }
 
+int TTF_GlyphPixmap(TTF_Font *font, uint16_t ch, const uint8_t **buffer,
+                    int *width, int *rows, int *pitch, int *yoffset)
+{
+    FT_Error error;
+    c_glyph *glyph;
+
+    error = Find_Glyph(font, ch, CACHED_METRICS|CACHED_PIXMAP);
+    if ( error ) {
+        TTF_SetError("Couldn't find glyph");
+        return -1;
+    }
+    glyph = font->current;
+
+    /* Same width correction as in TTF_RenderUTF8_Blended() */
+    *width = glyph->pixmap.width;
+    if ( font->outline <= 0 && *width > glyph->maxx - glyph->minx ) {
+        *width = glyph->maxx - glyph->minx;
+    }
+    *buffer = glyph->pixmap.buffer;
+    *rows = glyph->pixmap.rows;
+    *pitch = glyph->pixmap.pitch;
+    *yoffset = glyph->yoffset;
+    return 0;
+}
+
 }
 
 #endif
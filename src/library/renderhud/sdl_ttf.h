@@ -180,6 +180,13 @@ int TTF_WasInit(void);
 /* Get the kerning size of two glyphs */
 int TTF_GetFontKerningSizeGlyphs(TTF_Font *font, uint16_t previous_ch, uint16_t ch);
 
+/* Get the 8-bit coverage pixmap of a glyph, as used by TTF_RenderUTF8_Blended,
+   with its vertical offset from the top of the text. The buffer belongs to the
+   font glyph cache, and is only valid until the next call on this font.
+ */
+int TTF_GlyphPixmap(TTF_Font *font, uint16_t ch, const uint8_t **buffer,
+                    int *width, int *rows, int *pitch, int *yoffset);
+
 #define TTF_SetError(MSG)    std::cerr << MSG << std::endl;
 
 }
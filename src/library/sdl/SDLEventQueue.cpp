@@ -26,16 +26,6 @@ namespace libtas {
 
 SDLEventQueue sdlEventQueue;
 
-SDLEventQueue::~SDLEventQueue()
-{
-    for (auto ev: eventQueue) {
-        if (game_info.video & GameInfo::SDL1)
-            delete static_cast<SDL1::SDL_Event*>(ev);
-        if (game_info.video & GameInfo::SDL2)
-            delete static_cast<SDL_Event*>(ev);
-    }
-}
-
 void SDLEventQueue::init(void)
 {
     emptied = false;
@@ -64,7 +54,24 @@ bool SDLEventQueue::isEnabled(int type)
     return droppedEvents.find(type) == droppedEvents.end();
 }
 
-#define EVENTQUEUE_MAXLEN 1024
+bool SDLEventQueue::hasType(Uint32 minType, Uint32 maxType)
+{
+    Uint32 lastBucket = (maxType > 0xffff) ? 0xff : (maxType >> 8);
+    for (Uint32 bucket = (minType >> 8); bucket <= lastBucket; bucket++) {
+        if (typeCount[bucket] > 0)
+            return true;
+    }
+    return false;
+}
+
+bool SDLEventQueue::hasType(Uint32 mask)
+{
+    for (int type = 0; type < 32; type++) {
+        if ((typeCount[type] > 0) && (mask & SDL1_EVENTMASK(type)))
+            return true;
+    }
+    return false;
+}
 
 int SDLEventQueue::insert(SDL_Event* event)
 {
@@ -86,18 +93,14 @@ int SDLEventQueue::insert(SDL_Event* event)
         watch.first(watch.second, event);
     }
 
-    /* 4. Check the size of the queue */
-    if (eventQueue.size() > 1024) {
+    /* 4. Push the event at the end of the queue, if not full */
+    QueuedEvent ev;
+    ev.ev2 = *event;
+    if (!eventQueue.push(ev)) {
         debuglog(LCF_SDL | LCF_EVENTS, "We reached the limit of the event queue size!");
         return -1;
     }
-
-    /* Building a dynamically allocated event */
-    SDL_Event* ev = new SDL_Event;
-    memcpy(ev, event, sizeof(SDL_Event));
-
-    /* Push the event at the end of the queue */
-    eventQueue.push_back(ev);
+    typeCount[event->type >> 8]++;
 
     return 1;
 }
@@ -117,18 +120,14 @@ int SDLEventQueue::insert(SDL1::SDL_Event* event)
             return -1;
     }
 
-    /* 3. Check the size of the queue */
-    if (eventQueue.size() > 1024) {
+    /* 3. Push the event at the end of the queue, if not full */
+    QueuedEvent ev;
+    ev.ev1 = *event;
+    if (!eventQueue.push(ev)) {
         debuglog(LCF_SDL | LCF_EVENTS, "We reached the limit of the event queue size!");
         return -1;
     }
-
-    /* Building a dynamically allocated event */
-    SDL1::SDL_Event* ev = new SDL1::SDL_Event;
-    memcpy(ev, event, sizeof(SDL1::SDL_Event));
-
-    /* Push the event at the end of the queue */
-    eventQueue.push_back(ev);
+    typeCount[event->type]++;
 
     return 0;
 }
@@ -141,36 +140,33 @@ int SDLEventQueue::pop(SDL_Event* events, int num, Uint32 minType, Uint32 maxTyp
     if (num <= 0)
         return 0;
 
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL_Event* ev = static_cast<SDL_Event*>(*it);
-
-        /* Check if event match the filter */
-        if ((ev->type >= minType) && (ev->type <= maxType)) {
-
-            /* Copy the event in the array */
-            memcpy(&events[evi], ev, sizeof(SDL_Event));
-            evi++;
-
-            if (update) {
-                /* Deleting the object and removing it from the list */
-                delete ev;
-                it = eventQueue.erase(it);
-            }
-            else
-                ++it;
-
-            /* Check if we reached the limit on the number of events */
-            if (evi >= num)
-                return num;
+    /* Skip the search if no event can match */
+    if (hasType(minType, maxType)) {
+        if (update) {
+            /* Copy and remove the matching events */
+            eventQueue.removeIf([&](QueuedEvent& ev) {
+                if ((ev.ev2.type < minType) || (ev.ev2.type > maxType))
+                    return false;
+                events[evi++] = ev.ev2;
+                typeCount[ev.ev2.type >> 8]--;
+                return true;
+            }, num);
         }
         else {
-            ++it;
+            for (size_t i = 0; (i < eventQueue.size()) && (evi < num); i++) {
+                const SDL_Event& ev = eventQueue[i].ev2;
+                if ((ev.type >= minType) && (ev.type <= maxType))
+                    events[evi++] = ev;
+            }
         }
 
+        /* Check if we reached the limit on the number of events */
+        if (evi >= num)
+            return num;
     }
 
     emptied = true;
+    emptiedNotifier.notify();
     return evi;
 
 }
@@ -183,93 +179,73 @@ int SDLEventQueue::pop(SDL1::SDL_Event* events, int num, Uint32 mask, bool updat
     if (num <= 0)
         return 0;
 
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL1::SDL_Event* ev = static_cast<SDL1::SDL_Event*>(*it);
-
-        /* Check if event match the filter */
-        if (mask & SDL1_EVENTMASK(ev->type)) {
-
-            /* Copy the event in the array */
-            memcpy(&events[evi], ev, sizeof(SDL1::SDL_Event));
-            evi++;
-
-            if (update) {
-                /* Deleting the object and removing it from the list */
-                delete ev;
-                it = eventQueue.erase(it);
-            }
-            else
-                ++it;
-
-            /* Check if we reached the limit on the number of events */
-            if (evi >= num)
-                return num;
-
+    /* Skip the search if no event can match */
+    if (hasType(mask)) {
+        if (update) {
+            /* Copy and remove the matching events */
+            eventQueue.removeIf([&](QueuedEvent& ev) {
+                if (!(mask & SDL1_EVENTMASK(ev.ev1.type)))
+                    return false;
+                events[evi++] = ev.ev1;
+                typeCount[ev.ev1.type]--;
+                return true;
+            }, num);
         }
         else {
-            ++it;
+            for (size_t i = 0; (i < eventQueue.size()) && (evi < num); i++) {
+                const SDL1::SDL_Event& ev = eventQueue[i].ev1;
+                if (mask & SDL1_EVENTMASK(ev.type))
+                    events[evi++] = ev;
+            }
         }
+
+        /* Check if we reached the limit on the number of events */
+        if (evi >= num)
+            return num;
     }
 
     emptied = true;
+    emptiedNotifier.notify();
     return evi;
 
 }
 
 void SDLEventQueue::flush(Uint32 minType, Uint32 maxType)
 {
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL_Event* ev = static_cast<SDL_Event*>(*it);
-
-        /* Check if event match the filter */
-        if ((ev->type >= minType) && (ev->type <= maxType)) {
-            /* Deleting the object and removing it from the list */
-            delete ev;
-            it = eventQueue.erase(it);
-        }
-        else {
-            ++it;
-        }
-    }
+    if (!hasType(minType, maxType))
+        return;
+
+    eventQueue.removeIf([&](QueuedEvent& ev) {
+        if ((ev.ev2.type < minType) || (ev.ev2.type > maxType))
+            return false;
+        typeCount[ev.ev2.type >> 8]--;
+        return true;
+    });
 }
 
 void SDLEventQueue::flush(Uint32 mask)
 {
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL1::SDL_Event* ev = static_cast<SDL1::SDL_Event*>(*it);
-
-        /* Check if event match the filter */
-        if (mask & SDL1_EVENTMASK(ev->type)) {
-            /* Deleting the object and removing it from the list */
-            delete ev;
-            it = eventQueue.erase(it);
-        }
-        else {
-            ++it;
-        }
-    }
+    if (!hasType(mask))
+        return;
+
+    eventQueue.removeIf([&](QueuedEvent& ev) {
+        if (!(mask & SDL1_EVENTMASK(ev.ev1.type)))
+            return false;
+        typeCount[ev.ev1.type]--;
+        return true;
+    });
 }
 
 void SDLEventQueue::applyFilter(SDL_EventFilter filter, void* userdata)
 {
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL_Event* ev = static_cast<SDL_Event*>(*it);
-
+    eventQueue.removeIf([&](QueuedEvent& ev) {
         /* Run the filter function and check the result */
-        int isKept = filter(userdata, ev);
-        if (!isKept) {
-            /* Deleting the object and removing it from the list */
-            delete ev;
-            it = eventQueue.erase(it);
-        }
-        else {
-            ++it;
-        }
-    }
+        int isKept = filter(userdata, &ev.ev2);
+        if (isKept)
+            return false;
+        typeCount[ev.ev2.type >> 8]--;
+        return true;
+    });
 }
 
 void SDLEventQueue::setFilter(SDL_EventFilter filter, void* userdata)
@@ -311,15 +287,9 @@ void SDLEventQueue::delWatch(SDL_EventFilter filter, void* userdata)
 
 bool SDLEventQueue::waitForEmpty()
 {
-    int attempts = 0;
-
-    while (!emptied) {
-        if (++attempts > 10 * 100) {
-            debuglog(LCF_EVENTS | LCF_SDL | LCF_ERROR | LCF_ALERT, "SDL events sync took too long, were asynchronous events incorrectly enabled?");
-            return false;
-        }
-        struct timespec sleepTime = { 0, 10 * 1000 };
-        NATIVECALL(nanosleep(&sleepTime, NULL));
+    if (!emptiedNotifier.wait([this]{ return emptied; }, 50)) {
+        debuglog(LCF_EVENTS | LCF_SDL | LCF_ERROR | LCF_ALERT, "SDL events sync took too long, were asynchronous events incorrectly enabled?");
+        return false;
     }
     return true;
 }
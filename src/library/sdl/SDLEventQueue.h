@@ -20,12 +20,13 @@
 #ifndef LIBTAS_SDLEVENTQUEUE_H_INCLUDED
 #define LIBTAS_SDLEVENTQUEUE_H_INCLUDED
 
-#include <list>
 #include <set>
 #include <mutex>
 #include "../../external/SDL1.h"
 #include <SDL2/SDL.h>
 #include "sdlevents.h" // SDL_EventFilter
+#include "../SyncNotifier.h"
+#include "../EventRing.h"
 
 namespace libtas {
 /* This is a replacement of the SDL event queue.
@@ -38,8 +39,6 @@ namespace libtas {
 class SDLEventQueue
 {
     public:
-        ~SDLEventQueue();
-
         void init();
 
         /* Try to insert an event in the queue if conditions are met.
@@ -108,7 +107,22 @@ class SDLEventQueue
         std::mutex mutex;
 
     private:
-        std::list<void*> eventQueue;
+        /* Events are stored inline, as SDL1 or SDL2 events depending on
+         * the game */
+        union QueuedEvent {
+            SDL_Event ev2;
+            SDL1::SDL_Event ev1;
+        };
+        EventRing<QueuedEvent, 1024> eventQueue;
+
+        /* Number of queued events of each type, used to quickly know if an
+         * event type is present. SDL1 types are used directly, and SDL2
+         * types are grouped by category (type >> 8). */
+        int typeCount[256] = {};
+
+        /* Is there an event of type inside a range (SDL2) or a mask (SDL1) */
+        bool hasType(Uint32 minType, Uint32 maxType);
+        bool hasType(Uint32 mask);
         std::set<int> droppedEvents;
         std::set<std::pair<SDL_EventFilter,void*>> watches;
         SDL1::SDL_EventFilter filterFunc1 = nullptr;
@@ -117,6 +131,9 @@ class SDLEventQueue
 
         /* Was the queue emptied? Used for asynchronous events */
         bool emptied;
+
+        /* Notify that the queue was emptied */
+        SyncNotifier emptiedNotifier{"SDL events"};
 };
 
 extern SDLEventQueue sdlEventQueue;
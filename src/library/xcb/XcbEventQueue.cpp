@@ -24,6 +24,7 @@
 #include "../xlib/XlibEventQueueList.h"
 #include "../xlib/XlibEventQueue.h"
 #include "../xlib/xdisplay.h" // x11::gameDisplays
+#include <cstdlib>
 
 namespace libtas {
 
@@ -82,28 +83,25 @@ int XcbEventQueue::insert(xcb_generic_event_t *event)
     //         return 0;
     // }
 
-    /* Check the size of the queue */
-    if (eventQueue.size() > 1024) {
+    /* Push the event at the end of the queue, if not full */
+    if (!eventQueue.push(*event)) {
         debuglogstdio(LCF_EVENTS, "We reached the limit of the event queue size!");
         return -1;
     }
 
-    /* Push the event at the beginning of the queue */
-    eventQueue.push_front(*event);
-
     return 1;
 }
 
 xcb_generic_event_t* XcbEventQueue::pop()
 {
-    if (eventQueue.size() == 0)
+    if (eventQueue.empty())
         return nullptr;
 
-    xcb_generic_event_t* ev = new xcb_generic_event_t;
-    xcb_generic_event_t event = eventQueue.back();
-    eventQueue.pop_back();
+    /* Events returned by xcb are freed by the game using free() */
+    xcb_generic_event_t* ev = static_cast<xcb_generic_event_t*>(malloc(sizeof(xcb_generic_event_t)));
+    *ev = eventQueue[0];
+    eventQueue.pop();
 
-    memcpy(ev, &event, sizeof(xcb_generic_event_t));
     return ev;
 }
 
@@ -20,9 +20,9 @@
 #ifndef LIBTAS_XCBEVENTQUEUE_H_INCLUDED
 #define LIBTAS_XCBEVENTQUEUE_H_INCLUDED
 
-#include <list>
 #include <map>
 #include <xcb/xcb.h>
+#include "../EventRing.h"
 
 namespace libtas {
 /* This is a replacement of the xcb event queue. */
@@ -47,8 +47,8 @@ class XcbEventQueue
         xcb_connection_t *c;
 
     private:
-        /* Event queue */
-        std::list<xcb_generic_event_t> eventQueue;
+        /* Event queue, from the oldest event to the most recent */
+        EventRing<xcb_generic_event_t, 1024> eventQueue;
 
         /* Event mask for each Window */
         std::map<xcb_window_t, uint32_t> eventMasks;
@@ -29,6 +29,8 @@
 
 namespace libtas {
 
+SyncNotifier XlibEventQueue::emptiedNotifier("xevents");
+
 XlibEventQueue::XlibEventQueue(Display* d) : display(d), emptied(false) {}
 
 void XlibEventQueue::setMask(Window w, long event_mask)
@@ -83,17 +85,15 @@ int XlibEventQueue::insert(XEvent* event)
             return 0;
     }
 
-    /* Check the size of the queue */
-    if (eventQueue.size() > 1024) {
-        debuglogstdio(LCF_EVENTS, "We reached the limit of the event queue size!");
-        return -1;
-    }
-
     /* Specify the display */
     event->xany.display = display;
 
-    /* Push the event at the beginning of the queue */
-    eventQueue.push_front(*event);
+    /* Push the event at the end of the queue, if not full */
+    if (!eventQueue.push(*event)) {
+        debuglogstdio(LCF_EVENTS, "We reached the limit of the event queue size!");
+        return -1;
+    }
+    typeCount[event->type & 0x7f]++;
 
     return 1;
 }
@@ -102,85 +102,99 @@ bool XlibEventQueue::pop(XEvent* event, bool update)
 {
     std::lock_guard<std::mutex> lock(mutex);
 
-    if (eventQueue.size() == 0) {
+    if (eventQueue.empty()) {
         emptied = true;
+        emptiedNotifier.notify();
         return false;
     }
 
-    XEvent ev = eventQueue.back();
-    memcpy(event, &ev, sizeof(XEvent));
+    *event = eventQueue[0];
     if (update) {
-        eventQueue.pop_back();
+        typeCount[event->type & 0x7f]--;
+        eventQueue.pop();
     }
     return true;
 }
 
+template<typename Predicate>
+bool XlibEventQueue::popFirst(XEvent* event, Predicate match)
+{
+    int count = eventQueue.removeIf([&](XEvent& ev) {
+        if (!match(ev))
+            return false;
+
+        /* We found a match */
+        *event = ev;
+        typeCount[ev.type & 0x7f]--;
+        return true;
+    }, 1);
+
+    if (count > 0)
+        return true;
+
+    emptied = true;
+    emptiedNotifier.notify();
+    return false;
+}
+
 bool XlibEventQueue::pop(XEvent* event, Window w, long event_mask)
 {
     std::lock_guard<std::mutex> lock(mutex);
 
-    for (auto it = eventQueue.begin(); it != eventQueue.end(); ++it) {
-        XEvent ev = *it;
-        int type = ev.type;
+    /* Check first if an event type matching the mask is present */
+    bool present = false;
+    for (int type = 0; type < 128; type++) {
+        if ((typeCount[type] > 0) && isTypeOfMask(type, event_mask)) {
+            present = true;
+            break;
+        }
+    }
+    if (!present) {
+        emptied = true;
+        emptiedNotifier.notify();
+        return false;
+    }
 
+    return popFirst(event, [this, w, event_mask](const XEvent& ev) {
         /* Check window match */
         if ((w != 0) && (w != ev.xany.window))
-            continue;
+            return false;
 
         /* Check if event type match the mask */
-        if (!isTypeOfMask(type, event_mask))
-            continue;
-
-        /* We found a match */
-        memcpy(event, &ev, sizeof(XEvent));
-        eventQueue.erase(it);
-        return true;
-    }
-    emptied = true;
-    return false;
+        return isTypeOfMask(ev.type, event_mask);
+    });
 }
 
 bool XlibEventQueue::pop(XEvent* event, Window w, int event_type)
 {
     std::lock_guard<std::mutex> lock(mutex);
 
-    for (auto it = eventQueue.begin(); it != eventQueue.end(); ++it) {
-        XEvent ev = *it;
+    /* Check first if an event of this type is present */
+    if (typeCount[event_type & 0x7f] == 0) {
+        emptied = true;
+        emptiedNotifier.notify();
+        return false;
+    }
 
+    return popFirst(event, [w, event_type](const XEvent& ev) {
         /* Check window match */
         if ((w != 0) && (w != ev.xany.window))
-            continue;
+            return false;
 
         /* Check if event type match */
-        if (ev.type != event_type)
-            continue;
-
-        /* We found a match */
-        memcpy(event, &ev, sizeof(XEvent));
-        eventQueue.erase(it);
-        return true;
-    }
-    emptied = true;
-    return false;
+        return ev.type == event_type;
+    });
 }
 
 bool XlibEventQueue::pop(XEvent* event, Bool (*predicate)(Display *, XEvent *, XPointer), XPointer arg)
 {
     std::lock_guard<std::mutex> lock(mutex);
 
-    for (auto it = eventQueue.begin(); it != eventQueue.end(); ++it) {
-        XEvent ev = *it;
-
-        /* Check the predicate */
-        if (predicate(ev.xany.display, &ev, arg)) {
-            /* We found a match */
-            memcpy(event, &ev, sizeof(XEvent));
-            eventQueue.erase(it);
-            return true;
-        }
-    }
-    emptied = true;
-    return false;
+    return popFirst(event, [predicate, arg](const XEvent& ev) {
+        /* Check the predicate on a copy, because it may modify the event */
+        XEvent copy = ev;
+        return predicate(copy.xany.display, &copy, arg);
+    });
 }
 
 int XlibEventQueue::size()
@@ -188,8 +202,10 @@ int XlibEventQueue::size()
     std::lock_guard<std::mutex> lock(mutex);
 
     size_t s = eventQueue.size();
-    if (s == 0)
+    if (s == 0) {
         emptied = true;
+        emptiedNotifier.notify();
+    }
     return s;
 }
 
@@ -20,11 +20,12 @@
 #ifndef LIBTAS_XLIBEVENTQUEUE_H_INCLUDED
 #define LIBTAS_XLIBEVENTQUEUE_H_INCLUDED
 
-#include <list>
 #include <map>
 #include <mutex>
 #include <X11/X.h>
 #include <X11/Xlib.h>
+#include "../SyncNotifier.h"
+#include "../EventRing.h"
 
 namespace libtas {
 /* This is a replacement of the Xlib event queue. */
@@ -66,12 +67,23 @@ class XlibEventQueue
         /* Was the queue emptied? Used for asynchronous events */
         bool emptied;
 
+        /* Notify that one of the queues was emptied */
+        static SyncNotifier emptiedNotifier;
+
         /* Mutex for protecting empied and pop() */
         std::mutex mutex;
 
     private:
-        /* Event queue */
-        std::list<XEvent> eventQueue;
+        /* Event queue, from the oldest event to the most recent */
+        EventRing<XEvent, 1024> eventQueue;
+
+        /* Number of queued events of each type */
+        int typeCount[128] = {};
+
+        /* Remove the oldest event that matches, and copy it into `event`.
+         * Returns if an event was pulled. */
+        template<typename Predicate>
+        bool popFirst(XEvent* event, Predicate match);
 
         /* Event mask for each Window */
         std::map<Window, long> eventMasks;
@@ -68,22 +68,16 @@ void XlibEventQueueList::insert(XEvent* event)
 
 bool XlibEventQueueList::waitForEmpty()
 {
-    int attempts = 0;
-    bool allEmpty = false;
-
-    while (!allEmpty) {
-        allEmpty = true;
-        for (auto queue: eventQueueList) {
-            allEmpty &= queue->emptied;
-            if (!queue->emptied) {
-                if (++attempts > 10 * 100) {
-                    debuglogstdio(LCF_EVENTS | LCF_ERROR | LCF_ALERT, "xevents sync took too long, were asynchronous events incorrectly enabled?");
-                    return false;
-                }
-            }
-        }
-        struct timespec sleepTime = { 0, 10 * 1000 };
-        NATIVECALL(nanosleep(&sleepTime, NULL));
+    auto allEmpty = [this]{
+        for (auto queue: eventQueueList)
+            if (!queue->emptied)
+                return false;
+        return true;
+    };
+
+    if (!XlibEventQueue::emptiedNotifier.wait(allEmpty, 50)) {
+        debuglogstdio(LCF_EVENTS | LCF_ERROR | LCF_ALERT, "xevents sync took too long, were asynchronous events incorrectly enabled?");
+        return false;
     }
     return true;
 }
@@ -132,6 +132,8 @@ void Config::save(const std::string& gamepath) {
     settings.setValue("video_framerate", sc.video_framerate);
     settings.setValue("audio_codec", sc.audio_codec);
     settings.setValue("audio_bitrate", sc.audio_bitrate);
+    settings.setValue("video_pixfmt", sc.video_pixfmt);
+    settings.setValue("video_downscale", sc.video_downscale);
     settings.setValue("locale", sc.locale);
     settings.setValue("virtual_steam", sc.virtual_steam);
     settings.setValue("opengl_soft", sc.opengl_soft);
@@ -266,6 +268,8 @@ void Config::load(const std::string& gamepath) {
     sc.video_framerate = settings.value("video_framerate", sc.video_framerate).toInt();
     sc.audio_codec = settings.value("audio_codec", sc.audio_codec).toInt();
     sc.audio_bitrate = settings.value("audio_bitrate", sc.audio_bitrate).toInt();
+    sc.video_pixfmt = settings.value("video_pixfmt", sc.video_pixfmt).toInt();
+    sc.video_downscale = settings.value("video_downscale", sc.video_downscale).toInt();
     sc.savestate_settings = settings.value("savestate_settings", sc.savestate_settings).toInt();
     sc.opengl_soft = settings.value("opengl_soft", sc.opengl_soft).toBool();
     sc.opengl_performance = settings.value("opengl_performance", sc.opengl_performance).toBool();
@@ -24,8 +24,10 @@
 #include "AutoSave.h"
 #include "SaveState.h"
 #include "SaveStateList.h"
+#include "lua/Bot.h"
 #include "lua/Input.h"
 #include "lua/Main.h"
+#include "lua/Gui.h"
 
 #include "../shared/sockethelpers.h"
 #include "../shared/SharedConfig.h"
@@ -93,13 +95,18 @@ void GameLoop::start()
             }
 
             endInnerLoop = context->config.sc.running || ar_advance ||
-                hasFrameAdvanced || (context->status == Context::QUITTING);
+                hasFrameAdvanced || (context->status == Context::QUITTING) ||
+                Lua::Bot::isRunning();
 
             if (!endInnerLoop) {
                 sleepSendPreview();
             }
         } while (!endInnerLoop);
 
+        /* Let the lua bot play until it advances a frame */
+        if (bot_active || Lua::Bot::isRunning())
+            runBot();
+
         AllInputs ai;
         processInputs(ai);
         prev_ai = ai;
@@ -111,10 +118,10 @@ void GameLoop::start()
 
         bool shouldQuit = false;
 
-        /* Pause if needed */
-        if ((context->pause_frame == (context->framecount + 1)) ||
+        /* Pause if needed. A lua bot keeps playing after the movie */
+        if (!bot_active && ((context->pause_frame == (context->framecount + 1)) ||
             ((context->config.sc.recording != SharedConfig::NO_RECORDING) &&
-            ((context->config.sc.movie_framecount + context->pause_frame) == (context->framecount + 1)))) {
+            ((context->config.sc.movie_framecount + context->pause_frame) == (context->framecount + 1))))) {
 
             if (!context->interactive) {
                 /* Quit at the end of the movie if non-interactive */
@@ -446,14 +453,23 @@ bool GameLoop::startFrameMessages()
         case MSGB_DO_BACKTRACK_SAVESTATE:
             context->hotkey_pressed_queue.push(HOTKEY_SAVESTATE_BACKTRACK);
             break;
-        case MSGB_GETTIME_BACKTRACE:
+        case MSGB_GETTIME_TRACES:
         {
-            int type;
-            receiveData(&type, sizeof(int));
-            uint64_t hash;
-            receiveData(&hash, sizeof(uint64_t));
-            std::string trace = receiveString();
-            emit getTimeTrace(type, static_cast<unsigned long long>(hash), trace);
+            uint64_t frame;
+            receiveData(&frame, sizeof(uint64_t));
+            int size;
+            receiveData(&size, sizeof(int));
+            for (int i = 0; i < size; i++) {
+                int type;
+                receiveData(&type, sizeof(int));
+                uint64_t hash;
+                receiveData(&hash, sizeof(uint64_t));
+                uint32_t count;
+                receiveData(&count, sizeof(uint32_t));
+                std::string trace = receiveString();
+                emit getTimeTrace(type, static_cast<unsigned long long>(hash), count, trace);
+            }
+            emit timeTraceFrameEnded(static_cast<unsigned long long>(frame));
         }
         break;
         case MSGB_NONDRAW_FRAME:
@@ -497,6 +513,9 @@ bool GameLoop::startFrameMessages()
     /* Execute the lua callback onPaint here */
     Lua::Main::callLua(context, "onPaint");
 
+    /* Send all lua drawings at once */
+    Lua::Gui::sendDrawList();
+
     sendMessage(MSGN_START_FRAMEBOUNDARY);
 
     return false;
@@ -643,6 +662,138 @@ void GameLoop::notifyControllerEvent(xcb_keysym_t ks, bool pressed)
     }
 }
 
+bool GameLoop::saveState(int statei)
+{
+    /* Perform a savestate:
+     * - save the moviefile if we are recording
+     * - tell the game to save its state
+     */
+
+    /* Saving is not allowed if currently encoding */
+    if (context->config.sc.av_dumping) {
+        emit alertToShow(QString("Saving is not allowed when in the middle of video encoding"));
+        return false;
+    }
+
+    /* Perform savestate */
+    int message = SaveStateList::save(statei, context, movie);
+
+    /* Checking that saving succeeded */
+    if (message == MSGB_SAVING_SUCCEEDED) {
+        emit savestatePerformed(statei, context->framecount);
+        return true;
+    }
+
+    return false;
+}
+
+bool GameLoop::loadState(int statei, bool load_branch)
+{
+    /* Load a savestate:
+     * - check for an existing savestate in the slot
+     * - if in read-only move, we must check that the movie
+         associated with the savestate must be a prefix of the
+         current movie
+     * - tell the game to load its state
+     * - if loading succeeded:
+     * -- send the shared config
+     * -- increment the rerecord count
+     * -- receive the frame count and the current time
+     */
+
+    /* Loading is not allowed if currently encoding */
+    if (context->config.sc.av_dumping) {
+        emit alertToShow(QString("Loading is not allowed when in the middle of video encoding"));
+        return false;
+    }
+
+    /* Perform state loading */
+    int error = SaveStateList::load(statei, context, movie, load_branch);
+
+    /* Handle errors */
+    if (error == SaveState::ENOSTATEMOVIEPREFIX) {
+        /* A bot cannot answer the prompt, the failure is returned to it */
+        if (bot_active)
+            return false;
+
+        /* Ask the user if they want to load the movie, and get the answer.
+         * Prompting a alert window must be done by the UI thread, so we are
+         * using std::future/std::promise mechanism.
+         */
+        std::promise<bool> answer;
+        std::future<bool> future = answer.get_future();
+        emit askToShow(QString("There is a savestate in that slot from a previous game iteration. Do you want to load the associated movie?"), &answer);
+
+        if (! future.get()) {
+            /* User answered no */
+            return false;
+        }
+
+        /* Loading the movie */
+        emit inputsToBeChanged();
+        movie.loadSavestateMovie(SaveStateList::get(statei).getMoviePath());
+        emit inputsChanged();
+
+        /* Return if we already are on the correct frame */
+        if (context->framecount == movie.header->savestate_framecount)
+            return false;
+
+        /* Fast-forward to savestate frame */
+        context->config.sc.recording = SharedConfig::RECORDING_READ;
+        context->config.sc.movie_framecount = movie.inputs->nbFrames();
+        context->movie_time_sec = movie.header->length_sec;
+        context->movie_time_nsec = movie.header->length_nsec;
+        context->pause_frame = movie.header->savestate_framecount;
+        context->config.sc.running = true;
+        context->config.sc_modified = true;
+
+        emit sharedConfigChanged();
+
+        return false;
+    }
+
+    if (error == SaveState::ENOSTATE) {
+        if (!(context->config.sc.osd & SharedConfig::OSD_MESSAGES))
+            emit alertToShow(QString("There is no savestate to load in this slot"));
+        return false;
+    }
+
+    if (error == SaveState::ENOMOVIE) {
+        emit alertToShow(QString("Could not load the moviefile associated with the savestate"));
+        return false;                
+    }
+
+    if (error == SaveState::EINPUTMISMATCH) {
+        if (!(context->config.sc.osd & SharedConfig::OSD_MESSAGES)) {
+            emit alertToShow(QString("Trying to load a state in read-only but the inputs mismatch"));
+        }
+        return false;                
+    }
+
+    emit inputsToBeChanged();
+
+    /* Processing after state loading */
+    int message = SaveStateList::postLoad(statei, context, movie, load_branch);
+
+    /* Handle errors and return values */
+    if (message == SaveState::ENOLOAD) {
+        if (!context->config.sc.opengl_soft) {
+            emit alertToShow(QString("Crash after loading the savestate. Savestates are unstable unless you check Video>Force software rendering"));
+        }
+
+        return false;
+    }
+
+    bool success = (message == MSGB_LOADING_SUCCEEDED);
+    if (success) {
+        emit savestatePerformed(statei, 0);
+    }
+
+    emit inputsChanged();
+
+    return success;
+}
+
 bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
 {
     switch (type) {
@@ -699,31 +850,8 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
         case HOTKEY_SAVESTATE8:
         case HOTKEY_SAVESTATE9:
         case HOTKEY_SAVESTATE_BACKTRACK:
-        {
-            /* Perform a savestate:
-             * - save the moviefile if we are recording
-             * - tell the game to save its state
-             */
-
-            /* Saving is not allowed if currently encoding */
-            if (context->config.sc.av_dumping) {
-                emit alertToShow(QString("Saving is not allowed when in the middle of video encoding"));
-                return false;
-            }
-
-            /* Slot number */
-            int statei = hk.type - HOTKEY_SAVESTATE1 + 1;
-
-            /* Perform savestate */
-            int message = SaveStateList::save(statei, context, movie);
-
-            /* Checking that saving succeeded */
-            if (message == MSGB_SAVING_SUCCEEDED) {
-                emit savestatePerformed(statei, context->framecount);
-            }
-
+            saveState(hk.type - HOTKEY_SAVESTATE1 + 1);
             return false;
-        }
 
         case HOTKEY_LOADSTATE1:
         case HOTKEY_LOADSTATE2:
@@ -745,111 +873,14 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
         case HOTKEY_LOADBRANCH8:
         case HOTKEY_LOADBRANCH9:
         case HOTKEY_LOADBRANCH_BACKTRACK:
-
-            /* Load a savestate:
-             * - check for an existing savestate in the slot
-             * - if in read-only move, we must check that the movie
-                 associated with the savestate must be a prefix of the
-                 current movie
-             * - tell the game to load its state
-             * - if loading succeeded:
-             * -- send the shared config
-             * -- increment the rerecord count
-             * -- receive the frame count and the current time
-             */
         {
-
-            /* Loading is not allowed if currently encoding */
-            if (context->config.sc.av_dumping) {
-                emit alertToShow(QString("Loading is not allowed when in the middle of video encoding"));
-                return false;
-            }
-
             /* Loading branch? */
             bool load_branch = (hk.type >= HOTKEY_LOADBRANCH1) && (hk.type <= HOTKEY_LOADBRANCH_BACKTRACK);
 
             /* Slot number */
             int statei = hk.type - (load_branch?HOTKEY_LOADBRANCH1:HOTKEY_LOADSTATE1) + 1;
 
-            /* Perform state loading */
-            int error = SaveStateList::load(statei, context, movie, load_branch);
-
-            /* Handle errors */
-            if (error == SaveState::ENOSTATEMOVIEPREFIX) {
-                /* Ask the user if they want to load the movie, and get the answer.
-                 * Prompting a alert window must be done by the UI thread, so we are
-                 * using std::future/std::promise mechanism.
-                 */
-                std::promise<bool> answer;
-                std::future<bool> future = answer.get_future();
-                emit askToShow(QString("There is a savestate in that slot from a previous game iteration. Do you want to load the associated movie?"), &answer);
-
-                if (! future.get()) {
-                    /* User answered no */
-                    return false;
-                }
-
-                /* Loading the movie */
-                emit inputsToBeChanged();
-                movie.loadSavestateMovie(SaveStateList::get(statei).getMoviePath());
-                emit inputsChanged();
-
-                /* Return if we already are on the correct frame */
-                if (context->framecount == movie.header->savestate_framecount)
-                    return false;
-
-                /* Fast-forward to savestate frame */
-                context->config.sc.recording = SharedConfig::RECORDING_READ;
-                context->config.sc.movie_framecount = movie.inputs->nbFrames();
-                context->movie_time_sec = movie.header->length_sec;
-                context->movie_time_nsec = movie.header->length_nsec;
-                context->pause_frame = movie.header->savestate_framecount;
-                context->config.sc.running = true;
-                context->config.sc_modified = true;
-
-                emit sharedConfigChanged();
-
-                return false;
-            }
-
-            if (error == SaveState::ENOSTATE) {
-                if (!(context->config.sc.osd & SharedConfig::OSD_MESSAGES))
-                    emit alertToShow(QString("There is no savestate to load in this slot"));
-                return false;
-            }
-
-            if (error == SaveState::ENOMOVIE) {
-                emit alertToShow(QString("Could not load the moviefile associated with the savestate"));
-                return false;                
-            }
-
-            if (error == SaveState::EINPUTMISMATCH) {
-                if (!(context->config.sc.osd & SharedConfig::OSD_MESSAGES)) {
-                    emit alertToShow(QString("Trying to load a state in read-only but the inputs mismatch"));
-                }
-                return false;                
-            }
-
-            emit inputsToBeChanged();
-
-            /* Processing after state loading */
-            int message = SaveStateList::postLoad(statei, context, movie, load_branch);
-
-            /* Handle errors and return values */
-            if (message == SaveState::ENOLOAD) {
-                if (!context->config.sc.opengl_soft) {
-                    emit alertToShow(QString("Crash after loading the savestate. Savestates are unstable unless you check Video>Force software rendering"));
-                }
-
-                return false;
-            }
-
-            if (message == MSGB_LOADING_SUCCEEDED) {
-                emit savestatePerformed(statei, 0);
-            }
-
-            emit inputsChanged();
-
+            loadState(statei, load_branch);
             return false;
         }
 
@@ -1050,16 +1081,22 @@ void GameLoop::processInputs(AllInputs &ai)
         case SharedConfig::NO_RECORDING:
         case SharedConfig::RECORDING_WRITE:
 
-            /* Get inputs if we have input focus */
-            if (haveFocus()) {
-                /* Format the keyboard and mouse state and save it in the AllInputs struct */
-                context->config.km.buildAllInputs(ai, context->game_window, keysyms.get(), context->config.sc, context->config.mouse_warp);
-                ai.pointer_x += pointer_offset_x;
-                ai.pointer_y += pointer_offset_y;
+            if (bot_active) {
+                /* Inputs are set by the lua bot */
+                Lua::Bot::getInputs(ai);
+            }
+            else {
+                /* Get inputs if we have input focus */
+                if (haveFocus()) {
+                    /* Format the keyboard and mouse state and save it in the AllInputs struct */
+                    context->config.km.buildAllInputs(ai, context->game_window, keysyms.get(), context->config.sc, context->config.mouse_warp);
+                    ai.pointer_x += pointer_offset_x;
+                    ai.pointer_y += pointer_offset_y;
+                }
+
+                /* Fill controller inputs from the controller input window. */
+                emit fillControllerInputs(ai);
             }
-            
-            /* Fill controller inputs from the controller input window. */
-            emit fillControllerInputs(ai);
 
             /* Add framerate if necessary */
             if (context->config.sc.variable_framerate) {
@@ -1148,6 +1185,10 @@ void GameLoop::processInputs(AllInputs &ai)
                 }
             }
             else {
+                /* After the end of the movie, inputs are set by the lua bot */
+                if (bot_active)
+                    Lua::Bot::getInputs(ai);
+
                 /* ai is empty, fill the framerate values */
                 ai.framerate_num = context->config.sc.framerate_num;
                 ai.framerate_den = context->config.sc.framerate_den;
@@ -1225,6 +1266,49 @@ void GameLoop::endFrameMessages(AllInputs &ai)
 }
 
 
+void GameLoop::runBot()
+{
+    if (!bot_active) {
+        bot_active = true;
+        bot_sc = context->config.sc;
+
+        /* Run as fast as possible: no sleep, no rendering and no audio */
+        if (Lua::Bot::isHeadless()) {
+            context->config.sc.running = true;
+            context->config.sc.fastforward = true;
+            context->config.sc.fastforward_mode = SharedConfig::FF_SLEEP | SharedConfig::FF_MIXING | SharedConfig::FF_RENDERING;
+            context->config.sc.audio_mute = true;
+            context->config.sc_modified = true;
+            emit sharedConfigChanged();
+        }
+    }
+
+    int slot = 0;
+    Lua::Bot::Request request = Lua::Bot::resume(slot);
+    while ((request == Lua::Bot::REQUEST_SAVESTATE) || (request == Lua::Bot::REQUEST_LOADSTATE)) {
+        /* Perform the savestate like the corresponding hotkey, and return
+         * whether it succeeded to the bot */
+        bool success;
+        if (request == Lua::Bot::REQUEST_SAVESTATE)
+            success = saveState(slot);
+        else
+            success = loadState(slot, false);
+        request = Lua::Bot::resume(slot, success);
+    }
+
+    if (request == Lua::Bot::REQUEST_END) {
+        bot_active = false;
+
+        /* Restore the settings */
+        context->config.sc.running = bot_sc.running;
+        context->config.sc.fastforward = bot_sc.fastforward;
+        context->config.sc.fastforward_mode = bot_sc.fastforward_mode;
+        context->config.sc.audio_mute = bot_sc.audio_mute;
+        context->config.sc_modified = true;
+        emit sharedConfigChanged();
+    }
+}
+
 bool GameLoop::haveFocus()
 {
     xcb_window_t window;
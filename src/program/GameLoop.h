@@ -66,6 +66,11 @@ private:
     /* parent window of game window */
     xcb_window_t parent_game_window = 0;
 
+    /* Is a lua bot driving the game, and the shared config before it
+     * started, to restore the settings changed to run headless */
+    bool bot_active = false;
+    SharedConfig bot_sc;
+
     void init();
 
     void initProcessMessages();
@@ -76,6 +81,12 @@ private:
 
     void notifyControllerEvent(xcb_keysym_t ks, bool pressed);
 
+    /* Save a state in slot `statei`, and return if it succeeded */
+    bool saveState(int statei);
+
+    /* Load the state or branch of slot `statei`, and return if it succeeded */
+    bool loadState(int statei, bool load_branch);
+
     bool processEvent(uint8_t type, struct HotKey &hk);
 
     void sleepSendPreview();
@@ -84,6 +95,10 @@ private:
 
     void endFrameMessages(AllInputs &ai);
 
+    /* Resume the lua bot until it advances a frame, performing its
+     * savestate requests */
+    void runBot();
+
     /* Determine if we are allowed to send inputs to the game, based on which
      * window has focus and our settings.
      */
@@ -118,7 +133,10 @@ signals:
     /* register a savestate */
     void savestatePerformed(int slot, unsigned long long frame);
 
-    void getTimeTrace(int type, unsigned long long hash, std::string stacktrace);
+    /* Number of time calls of a call site during a frame, followed by the
+     * end of the frame when all call sites were sent */
+    void getTimeTrace(int type, unsigned long long hash, unsigned int count, std::string stacktrace);
+    void timeTraceFrameEnded(unsigned long long frame);
 };
 
 #endif
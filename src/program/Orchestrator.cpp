@@ -0,0 +1,228 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Orchestrator.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+struct Instance {
+    pid_t pid;
+    int fd;
+
+    /* Data received and not yet processed */
+    std::string received;
+
+    /* Index of the candidate being evaluated, or -1 */
+    int candidate = -1;
+};
+
+static bool sendLine(int fd, std::string line)
+{
+    line += '\n';
+    size_t sent = 0;
+    while (sent < line.size()) {
+        ssize_t ret = write(fd, line.data() + sent, line.size() - sent);
+        if (ret <= 0)
+            return false;
+        sent += ret;
+    }
+    return true;
+}
+
+/* Launch an instance of the program, connected to the orchestrator */
+static bool launchInstance(int index, const std::vector<std::string>& args, Instance& instance)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        std::cerr << "Could not create the connection to instance " << index << std::endl;
+        return false;
+    }
+
+    instance.pid = fork();
+    if (instance.pid == 0) {
+        /* Duplicating the fd removes the close-on-exec flag */
+        int fd = dup(fds[1]);
+        setenv("LIBTAS_SEARCH_FD", std::to_string(fd).c_str(), 1);
+        setenv("LIBTAS_SEARCH_WORKER", std::to_string(index).c_str(), 1);
+
+        /* Each program chooses its own socket file */
+        unsetenv("LIBTAS_SOCKET");
+
+        /* Keep the standard output for the results */
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>("libTAS"));
+        for (const std::string& arg : args)
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+
+        execv("/proc/self/exe", argv.data());
+        std::cerr << "Could not launch instance " << index << ": " << strerror(errno) << std::endl;
+        _exit(1);
+    }
+
+    close(fds[1]);
+    if (instance.pid < 0) {
+        close(fds[0]);
+        std::cerr << "Could not launch instance " << index << std::endl;
+        return false;
+    }
+
+    instance.fd = fds[0];
+    return true;
+}
+
+int Orchestrator::run(int jobs, const std::string& searchfile, const std::vector<std::string>& args)
+{
+    /* Read candidates */
+    std::ifstream file(searchfile);
+    if (!file) {
+        std::cerr << "Could not open the search file " << searchfile << std::endl;
+        return -1;
+    }
+
+    std::vector<std::string> candidates;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty())
+            candidates.push_back(line);
+    }
+
+    std::vector<double> fitness(candidates.size());
+    std::vector<bool> evaluated(candidates.size(), false);
+    size_t next_candidate = 0;
+    bool has_bound = false;
+    double bound = 0;
+
+    /* Don't get killed when writing to an instance that crashed */
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Instance> instances;
+    for (int i = 0; i < jobs; i++) {
+        Instance instance;
+        if (launchInstance(i, args, instance))
+            instances.push_back(instance);
+    }
+
+    while (!instances.empty()) {
+        std::vector<struct pollfd> pfds;
+        for (const Instance& instance : instances)
+            pfds.push_back({instance.fd, POLLIN, 0});
+
+        if (poll(pfds.data(), pfds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "poll() failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        /* Iterate backwards so that ended instances can be removed */
+        for (int i = pfds.size() - 1; i >= 0; i--) {
+            if (!pfds[i].revents)
+                continue;
+
+            Instance& instance = instances[i];
+            char buf[4096];
+            ssize_t ret = read(instance.fd, buf, sizeof(buf));
+
+            if (ret <= 0) {
+                /* The instance has ended */
+                if (instance.candidate >= 0)
+                    std::cerr << "Candidate " << candidates[instance.candidate] << " was not evaluated" << std::endl;
+                close(instance.fd);
+                waitpid(instance.pid, nullptr, 0);
+                instances.erase(instances.begin() + i);
+                continue;
+            }
+
+            instance.received.append(buf, ret);
+
+            size_t pos;
+            while ((pos = instance.received.find('\n')) != std::string::npos) {
+                std::string request = instance.received.substr(0, pos);
+                instance.received.erase(0, pos + 1);
+
+                if (request == "N") {
+                    if (next_candidate < candidates.size()) {
+                        instance.candidate = next_candidate++;
+                        sendLine(instance.fd, "C " + candidates[instance.candidate]);
+                    }
+                    else {
+                        instance.candidate = -1;
+                        sendLine(instance.fd, "E");
+                    }
+                }
+                else if (request == "B") {
+                    if (has_bound) {
+                        char value[64];
+                        snprintf(value, sizeof(value), "B %.17g", bound);
+                        sendLine(instance.fd, value);
+                    }
+                    else {
+                        sendLine(instance.fd, "B");
+                    }
+                }
+                else if ((request.compare(0, 2, "R ") == 0) && (instance.candidate >= 0)) {
+                    double value = strtod(request.c_str() + 2, nullptr);
+                    fitness[instance.candidate] = value;
+                    evaluated[instance.candidate] = true;
+                    instance.candidate = -1;
+                    if (!has_bound || (value > bound)) {
+                        has_bound = true;
+                        bound = value;
+                    }
+                }
+                else {
+                    std::cerr << "Unexpected request from instance: " << request << std::endl;
+                }
+            }
+        }
+    }
+
+    /* Merge the results from the highest fitness */
+    std::vector<size_t> order;
+    for (size_t c = 0; c < candidates.size(); c++) {
+        if (evaluated[c])
+            order.push_back(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&fitness](size_t a, size_t b) {
+        return fitness[a] > fitness[b];
+    });
+
+    std::cout.precision(15);
+    for (size_t c : order)
+        std::cout << fitness[c] << "\t" << candidates[c] << std::endl;
+
+    if (order.size() < candidates.size())
+        std::cerr << (candidates.size() - order.size()) << " candidates were not evaluated" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_ORCHESTRATOR_H_INCLUDED
+#define LIBTAS_ORCHESTRATOR_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+/* Parallel search over several instances of the game.
+ *
+ * The orchestrator launches `jobs` non-interactive instances of the program
+ * with the same arguments and lua script, each with its own socket and
+ * savestate directory, which are removed when the instance exits. Candidates are read from a file, one per line, and
+ * handed out to instances as they ask for them. The lua script of each
+ * instance gets candidates with search.next(), evaluates them (typically
+ * from a savestate, with a bot), and sends back their fitness with
+ * search.report(). The best fitness so far is shared with all instances
+ * through search.bound(), so that they can prune branches.
+ *
+ * Instances exchange text lines with the orchestrator:
+ *   "N"          -> "C <candidate>", or "E" when there is no candidate left
+ *   "B"          -> "B <best fitness>", or "B" if nothing was reported
+ *   "R <fitness>"   report the fitness of the current candidate
+ *
+ * When all instances have ended, candidates are printed on the standard
+ * output with their fitness, from the highest fitness to the lowest.
+ */
+namespace Orchestrator {
+
+    /* Run the search.
+     * @param jobs        number of instances
+     * @param searchfile  file of candidates
+     * @param args        arguments of each instance, without the executable
+     * @return the exit status of the program
+     */
+    int run(int jobs, const std::string& searchfile, const std::vector<std::string>& args);
+}
+
+#endif
@@ -0,0 +1,161 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Bot.h"
+#include "Input.h"
+
+#include <iostream>
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+}
+
+static Context* context;
+
+/* Coroutine of the bot, and its reference in the registry to keep it alive */
+static lua_State* bot_thread = nullptr;
+static int bot_ref = LUA_NOREF;
+static bool bot_headless = true;
+
+/* Last request of the bot */
+static Lua::Bot::Request bot_request;
+static int bot_slot;
+
+/* Inputs set by the bot for the current frame */
+static AllInputs bot_ai;
+
+/* List of functions to register */
+static const luaL_Reg bot_functions[] =
+{
+    { "run", Lua::Bot::run},
+    { "frameAdvance", Lua::Bot::frameAdvance},
+    { "saveState", Lua::Bot::saveState},
+    { "loadState", Lua::Bot::loadState},
+    { NULL, NULL }
+};
+
+void Lua::Bot::registerFunctions(Context* c)
+{
+    context = c;
+    reset();
+    luaL_newlib(context->lua_state, bot_functions);
+    lua_setglobal(context->lua_state, "bot");
+}
+
+void Lua::Bot::reset()
+{
+    bot_thread = nullptr;
+    bot_ref = LUA_NOREF;
+    bot_request = REQUEST_END;
+}
+
+bool Lua::Bot::isRunning()
+{
+    return bot_thread != nullptr;
+}
+
+bool Lua::Bot::isHeadless()
+{
+    return bot_headless;
+}
+
+Lua::Bot::Request Lua::Bot::resume(int& slot, bool success)
+{
+    if (!bot_thread)
+        return REQUEST_END;
+
+    /* Input functions modify the bot inputs */
+    Lua::Input::registerInputs(&bot_ai);
+
+    /* Savestate functions return the result of their request */
+    int nargs = 0;
+    if ((bot_request == REQUEST_SAVESTATE) || (bot_request == REQUEST_LOADSTATE)) {
+        lua_pushboolean(bot_thread, success);
+        nargs = 1;
+    }
+
+    int ret = lua_resume(bot_thread, context->lua_state, nargs);
+    if (ret == LUA_YIELD) {
+        slot = bot_slot;
+        return bot_request;
+    }
+
+    if (ret != LUA_OK) {
+        std::cerr << "error running bot: " << lua_tostring(bot_thread, -1) << std::endl;
+    }
+
+    /* Release the coroutine */
+    luaL_unref(context->lua_state, LUA_REGISTRYINDEX, bot_ref);
+    reset();
+    return REQUEST_END;
+}
+
+void Lua::Bot::getInputs(AllInputs& ai)
+{
+    ai = bot_ai;
+    bot_ai.emptyInputs();
+}
+
+/* Check that a bot function is called from the bot coroutine, and yield
+ * the request to the game loop */
+static int yieldRequest(lua_State *L, Lua::Bot::Request request, int slot)
+{
+    if (L != bot_thread)
+        return luaL_error(L, "bot functions can only be called from the bot");
+
+    bot_request = request;
+    bot_slot = slot;
+    return lua_yield(L, 0);
+}
+
+int Lua::Bot::run(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+    if (bot_thread)
+        return luaL_error(L, "a bot is already running");
+
+    bot_headless = lua_isnoneornil(L, 2) || lua_toboolean(L, 2);
+    bot_ai.emptyInputs();
+
+    /* Build the coroutine with the bot function on its stack */
+    bot_thread = lua_newthread(L);
+    lua_pushvalue(L, 1);
+    lua_xmove(L, bot_thread, 1);
+    bot_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    return 0;
+}
+
+int Lua::Bot::frameAdvance(lua_State *L)
+{
+    return yieldRequest(L, REQUEST_FRAME, 0);
+}
+
+int Lua::Bot::saveState(lua_State *L)
+{
+    int slot = static_cast<int>(luaL_checkinteger(L, 1));
+    luaL_argcheck(L, (slot >= 1) && (slot <= 9), 1, "slot must be between 1 and 9");
+    return yieldRequest(L, REQUEST_SAVESTATE, slot);
+}
+
+int Lua::Bot::loadState(lua_State *L)
+{
+    int slot = static_cast<int>(luaL_checkinteger(L, 1));
+    luaL_argcheck(L, (slot >= 1) && (slot <= 9), 1, "slot must be between 1 and 9");
+    return yieldRequest(L, REQUEST_LOADSTATE, slot);
+}
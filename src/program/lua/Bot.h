@@ -0,0 +1,87 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_LUABOT_H_INCLUDED
+#define LIBTAS_LUABOT_H_INCLUDED
+
+#include "../../shared/AllInputs.h"
+#include "../Context.h"
+extern "C" {
+#include <lua.h>
+}
+
+namespace Lua {
+
+/* A bot is a lua function running as a coroutine, which drives the game
+ * from the game loop thread. Each time the game reaches a frame boundary,
+ * the coroutine is resumed until it asks to advance to the next frame.
+ * Savestate requests are yielded to the game loop, which performs them and
+ * resumes the coroutine with the result, so that they all happen inside the
+ * same frame boundary.
+ */
+namespace Bot {
+
+    /* Requests yielded by the bot to the game loop */
+    enum Request {
+        REQUEST_FRAME, // Advance to the next frame
+        REQUEST_SAVESTATE, // Save a state in a slot
+        REQUEST_LOADSTATE, // Load a state from a slot
+        REQUEST_END, // The bot ended or there is no bot
+    };
+
+    /* Register all functions */
+    void registerFunctions(Context* context);
+
+    /* Forget the bot, when the lua VM is closed */
+    void reset();
+
+    /* Is a bot currently running */
+    bool isRunning();
+
+    /* Should the bot run as fast as possible, with no sleep, no rendering
+     * and no audio */
+    bool isHeadless();
+
+    /* Resume the bot until its next request.
+     * @param slot     savestate slot of the request, if any
+     * @param success  result of the previous savestate request, returned to
+     *                 the bot
+     * @return the request
+     */
+    Request resume(int& slot, bool success = false);
+
+    /* Get the inputs set by the bot for the current frame, and clear them */
+    void getInputs(AllInputs& ai);
+
+    /* Start a bot (function f, [bool headless = true]) */
+    int run(lua_State *L);
+
+    /* Advance to the next frame () */
+    int frameAdvance(lua_State *L);
+
+    /* Save a state (number slot), returns if it succeeded */
+    int saveState(lua_State *L);
+
+    /* Load a state (number slot), returns if it succeeded */
+    int loadState(lua_State *L);
+
+}
+}
+
+#endif
@@ -20,9 +20,12 @@
 #include "Gui.h"
 #include "../shared/sockethelpers.h"
 #include "../shared/messages.h"
+#include "../shared/LuaDrawList.h"
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <cstring>
 extern "C" {
 #include <lua.h>
 #include <lauxlib.h>
@@ -37,9 +40,23 @@ static const luaL_Reg gui_functions[] =
     { "text", Lua::Gui::text},
     { "pixel", Lua::Gui::pixel},
     { "rectangle", Lua::Gui::rectangle},
+    { "line", Lua::Gui::line},
+    { "polyline", Lua::Gui::polyline},
+    { "pixels", Lua::Gui::pixels},
     { NULL, NULL }
 };
 
+/* Drawings of the current frame, sent to the game in a single message */
+static std::vector<uint8_t> draw_list;
+
+template<typename T>
+static void appendDrawList(T value)
+{
+    size_t size = draw_list.size();
+    draw_list.resize(size + sizeof(T));
+    memcpy(&draw_list[size], &value, sizeof(T));
+}
+
 void Lua::Gui::registerFunctions(Context* c)
 {
     context = c;
@@ -70,17 +87,19 @@ int Lua::Gui::text(lua_State *L)
 {
     int x = static_cast<int>(lua_tointeger(L, 1));
     int y = static_cast<int>(lua_tointeger(L, 2));
-    std::string text = luaL_checklstring(L, 3, nullptr);
+    size_t len;
+    const char* text = luaL_checklstring(L, 3, &len);
     uint32_t fg_color = luaL_optnumber (L, 4, 0x00ffffff);
     uint32_t bg_color = luaL_optnumber (L, 5, 0x00000000);
-    
-    sendMessage(MSGN_LUA_TEXT);
-    sendData(&x, sizeof(int));
-    sendData(&y, sizeof(int));
-    sendString(text);
-    sendData(&fg_color, sizeof(uint32_t));
-    sendData(&bg_color, sizeof(uint32_t));
-    
+
+    appendDrawList(LuaDrawList::TEXT);
+    appendDrawList(x);
+    appendDrawList(y);
+    appendDrawList(fg_color);
+    appendDrawList(bg_color);
+    appendDrawList(static_cast<uint32_t>(len));
+    draw_list.insert(draw_list.end(), text, text + len);
+
     return 0;
 }
 
@@ -89,12 +108,12 @@ int Lua::Gui::pixel(lua_State *L)
     int x = static_cast<int>(lua_tointeger(L, 1));
     int y = static_cast<int>(lua_tointeger(L, 2));
     uint32_t color = luaL_optnumber (L, 3, 0x00ffffff);
-    
-    sendMessage(MSGN_LUA_PIXEL);
-    sendData(&x, sizeof(int));
-    sendData(&y, sizeof(int));
-    sendData(&color, sizeof(uint32_t));
-    
+
+    appendDrawList(LuaDrawList::PIXEL);
+    appendDrawList(x);
+    appendDrawList(y);
+    appendDrawList(color);
+
     return 0;
 }
 
@@ -107,15 +126,90 @@ int Lua::Gui::rectangle(lua_State *L)
     int thickness = luaL_optnumber (L, 5, 1);
     uint32_t outline_color = luaL_optnumber (L, 6, 0x00ffffff);
     uint32_t fill_color = luaL_optnumber (L, 7, 0xffffffff);
-    
-    sendMessage(MSGN_LUA_RECT);
-    sendData(&x, sizeof(int));
-    sendData(&y, sizeof(int));
-    sendData(&w, sizeof(int));
-    sendData(&h, sizeof(int));
-    sendData(&thickness, sizeof(int));
-    sendData(&outline_color, sizeof(uint32_t));
-    sendData(&fill_color, sizeof(uint32_t));
-    
+
+    appendDrawList(LuaDrawList::RECT);
+    appendDrawList(x);
+    appendDrawList(y);
+    appendDrawList(w);
+    appendDrawList(h);
+    appendDrawList(thickness);
+    appendDrawList(outline_color);
+    appendDrawList(fill_color);
+
+    return 0;
+}
+
+int Lua::Gui::line(lua_State *L)
+{
+    int x0 = static_cast<int>(lua_tointeger(L, 1));
+    int y0 = static_cast<int>(lua_tointeger(L, 2));
+    int x1 = static_cast<int>(lua_tointeger(L, 3));
+    int y1 = static_cast<int>(lua_tointeger(L, 4));
+    uint32_t color = luaL_optnumber (L, 5, 0x00ffffff);
+
+    appendDrawList(LuaDrawList::LINE);
+    appendDrawList(x0);
+    appendDrawList(y0);
+    appendDrawList(x1);
+    appendDrawList(y1);
+    appendDrawList(color);
+
     return 0;
 }
+
+int Lua::Gui::polyline(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    uint32_t color = luaL_optnumber (L, 2, 0x00ffffff);
+    uint32_t n = luaL_len(L, 1) / 2;
+
+    appendDrawList(LuaDrawList::POLYLINE);
+    appendDrawList(color);
+    appendDrawList(n);
+    for (uint32_t i = 1; i <= 2*n; i++) {
+        lua_rawgeti(L, 1, i);
+        appendDrawList(static_cast<int>(lua_tointeger(L, -1)));
+        lua_pop(L, 1);
+    }
+
+    return 0;
+}
+
+int Lua::Gui::pixels(lua_State *L)
+{
+    int x = static_cast<int>(lua_tointeger(L, 1));
+    int y = static_cast<int>(lua_tointeger(L, 2));
+    int w = static_cast<int>(luaL_checkinteger(L, 3));
+    luaL_checktype(L, 4, LUA_TTABLE);
+    luaL_argcheck(L, w > 0, 3, "width must be positive");
+
+    /* Only complete rows are drawn */
+    int h = luaL_len(L, 4) / w;
+    if (h == 0)
+        return 0;
+
+    appendDrawList(LuaDrawList::PIXELS);
+    appendDrawList(x);
+    appendDrawList(y);
+    appendDrawList(w);
+    appendDrawList(h);
+    for (int i = 1; i <= w*h; i++) {
+        lua_rawgeti(L, 4, i);
+        appendDrawList(static_cast<uint32_t>(lua_tonumber(L, -1)));
+        lua_pop(L, 1);
+    }
+
+    return 0;
+}
+
+void Lua::Gui::sendDrawList()
+{
+    if (draw_list.empty())
+        return;
+
+    sendMessage(MSGN_LUA_DRAWLIST);
+    uint32_t size = draw_list.size();
+    sendData(&size, sizeof(uint32_t));
+    sendData(draw_list.data(), size);
+    draw_list.clear();
+}
@@ -45,6 +45,18 @@ namespace Gui {
     /* Draw rectangle */
     int rectangle(lua_State *L);
 
+    /* Draw line */
+    int line(lua_State *L);
+
+    /* Draw connected lines from a table of coordinates */
+    int polyline(lua_State *L);
+
+    /* Draw an array of pixels from a table of colors */
+    int pixels(lua_State *L);
+
+    /* Send all drawings of this frame to the game */
+    void sendDrawList();
+
 }
 }
 
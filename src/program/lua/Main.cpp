@@ -18,10 +18,12 @@
  */
 
 #include "Main.h"
+#include "Bot.h"
 #include "Gui.h"
 #include "Input.h"
 #include "Movie.h"
 #include "Memory.h"
+#include "Search.h"
 #include <iostream>
 extern "C" {
 #include <lua.h>
@@ -38,10 +40,12 @@ void Lua::Main::init(Context* context)
     luaL_openlibs(context->lua_state);
     
     /* Register our functions */
+    Lua::Bot::registerFunctions(context);
     Lua::Gui::registerFunctions(context);
     Lua::Input::registerFunctions(context);
     Lua::Memory::registerFunctions(context);
     Lua::Movie::registerFunctions(context);
+    Lua::Search::registerFunctions(context);
 }
 
 void Lua::Main::exit(Context* context)
@@ -49,6 +53,7 @@ void Lua::Main::exit(Context* context)
     if (context->lua_state)
         lua_close(context->lua_state);
     context->lua_state = nullptr;
+    Lua::Bot::reset();
 }
 
 void Lua::Main::run(Context* context, std::string filename)
@@ -20,6 +20,10 @@
 #include "Memory.h"
 
 #include <iostream>
+#include <vector>
+#include <cstring>
+#include <climits> // IOV_MAX
+#include <sys/uio.h> // process_vm_readv
 extern "C" {
 #include <lua.h>
 #include <lauxlib.h>
@@ -40,6 +44,11 @@ static const luaL_Reg memory_functions[] =
     { "reads64", Lua::Memory::reads64},
     { "readf", Lua::Memory::readf},
     { "readd", Lua::Memory::readd},
+    { "readbytes", Lua::Memory::readbytes},
+    { "readarray", Lua::Memory::readarray},
+    { "readstruct", Lua::Memory::readstruct},
+    { "readstructarray", Lua::Memory::readstructarray},
+    { "readbatch", Lua::Memory::readbatch},
     { "write8", Lua::Memory::write8},
     { "write16", Lua::Memory::write16},
     { "write32", Lua::Memory::write32},
@@ -106,6 +115,312 @@ int Lua::Memory::read##NAME(lua_State *L) \
 READFUNCNUMBER(f, float)
 READFUNCNUMBER(d, double)
 
+/* Types of values that can be read in bulk, named like the scalar read
+ * functions */
+enum ValueType {
+    TYPE_U8, TYPE_U16, TYPE_U32, TYPE_U64,
+    TYPE_S8, TYPE_S16, TYPE_S32, TYPE_S64,
+    TYPE_F, TYPE_D,
+};
+
+static const struct {
+    const char* name;
+    int size;
+} value_types[] = {
+    {"u8", 1}, {"u16", 2}, {"u32", 4}, {"u64", 8},
+    {"s8", 1}, {"s16", 2}, {"s32", 4}, {"s64", 8},
+    {"f", 4}, {"d", 8},
+};
+
+/* Get the type from its name at the given stack index, or raise an error */
+static ValueType checkType(lua_State *L, int index)
+{
+    const char* name = luaL_checkstring(L, index);
+    for (int t = TYPE_U8; t <= TYPE_D; t++)
+        if (strcmp(name, value_types[t].name) == 0)
+            return static_cast<ValueType>(t);
+
+    luaL_error(L, "unknown type %s", name);
+    return TYPE_U8;
+}
+
+/* Push a value of the given type, decoded from a buffer */
+static void pushValue(lua_State *L, ValueType type, const uint8_t* data)
+{
+    switch (type) {
+#define PUSHINT(TYPE) \
+        { TYPE value; memcpy(&value, data, sizeof(TYPE)); lua_pushinteger(L, static_cast<lua_Integer>(value)); break; }
+        case TYPE_U8: PUSHINT(uint8_t)
+        case TYPE_U16: PUSHINT(uint16_t)
+        case TYPE_U32: PUSHINT(uint32_t)
+        case TYPE_U64: PUSHINT(uint64_t)
+        case TYPE_S8: PUSHINT(int8_t)
+        case TYPE_S16: PUSHINT(int16_t)
+        case TYPE_S32: PUSHINT(int32_t)
+        case TYPE_S64: PUSHINT(int64_t)
+#undef PUSHINT
+        case TYPE_F: { float value; memcpy(&value, data, sizeof(float)); lua_pushnumber(L, value); break; }
+        case TYPE_D: { double value; memcpy(&value, data, sizeof(double)); lua_pushnumber(L, value); break; }
+    }
+}
+
+void Lua::Memory::readMany(const struct iovec* locals, const struct iovec* remotes, size_t count)
+{
+    /* Each remote buffer is read into the local buffer of the same index.
+     * Reading stops at the first remote buffer that cannot be read, so we
+     * fill it with zeros and continue with the next one. */
+    size_t i = 0;
+    while (i < count) {
+        size_t n = count - i;
+        if (n > IOV_MAX)
+            n = IOV_MAX;
+
+        ssize_t ret = process_vm_readv(context->game_pid, &locals[i], n, &remotes[i], n, 0);
+        if (ret < 0) {
+            memset(locals[i].iov_base, 0, locals[i].iov_len);
+            i++;
+            continue;
+        }
+
+        size_t bytes = ret;
+        size_t j = i;
+        for (; (j < i + n) && (bytes >= remotes[j].iov_len); j++)
+            bytes -= remotes[j].iov_len;
+
+        /* Skip the buffer that failed, which may be partially read */
+        if (j < i + n) {
+            memset(locals[j].iov_base, 0, locals[j].iov_len);
+            j++;
+        }
+        i = j;
+    }
+}
+
+/* Lua errors jump out of the function without calling C++ destructors, so
+ * all arguments are checked before allocating anything, and the buffers that
+ * are alive while calling the Lua API are allocated as userdata. The userdata
+ * is pushed on the stack, and is collected after the function returns. */
+static void* newBuffer(lua_State *L, size_t size)
+{
+    void* buffer = lua_newuserdata(L, size);
+    memset(buffer, 0, size);
+    return buffer;
+}
+
+/* Read `count` elements of size `size` separated by `stride` bytes into a
+ * contiguous buffer. Elements that cannot be read are filled with zeros. */
+static void readElements(uintptr_t addr, int size, int count, lua_Integer stride, uint8_t* buffer)
+{
+    if (count == 0)
+        return;
+
+    /* Read the whole range at once if elements are close enough, and if
+     * the range fits in a single read */
+    size_t buffer_size = static_cast<size_t>(size) * count;
+    lua_Integer span = -1;
+    if ((stride >= size) && (stride <= INT_MAX))
+        span = stride * (count - 1) + size;
+    if ((span > 0) && (span <= INT_MAX) && (span <= 4 * static_cast<lua_Integer>(buffer_size))) {
+        std::vector<uint8_t> range(span, 0);
+        if (Lua::Memory::read(addr, range.data(), span)) {
+            for (int i = 0; i < count; i++)
+                memcpy(&buffer[static_cast<size_t>(i) * size], &range[i * stride], size);
+            return;
+        }
+    }
+
+    /* Otherwise, use one remote buffer per element, so that elements that
+     * cannot be read do not prevent reading the others */
+    std::vector<struct iovec> locals(count), remotes(count);
+    for (int i = 0; i < count; i++) {
+        locals[i].iov_base = &buffer[static_cast<size_t>(i) * size];
+        locals[i].iov_len = size;
+        remotes[i].iov_base = reinterpret_cast<void*>(addr + static_cast<uintptr_t>(i) * static_cast<uintptr_t>(stride));
+        remotes[i].iov_len = size;
+    }
+    Lua::Memory::readMany(locals.data(), remotes.data(), count);
+}
+
+int Lua::Memory::readbytes(lua_State *L)
+{
+    uintptr_t addr = static_cast<uintptr_t>(lua_tointeger(L, 1));
+    lua_Integer size = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, size >= 0, 2, "size must be positive");
+    luaL_argcheck(L, size <= INT_MAX, 2, "size is too large");
+
+    luaL_Buffer b;
+    char* buffer = luaL_buffinitsize(L, &b, size);
+    if (read(addr, buffer, size))
+        luaL_pushresultsize(&b, size);
+    else
+        lua_pushnil(L);
+    return 1;
+}
+
+int Lua::Memory::readarray(lua_State *L)
+{
+    uintptr_t addr = static_cast<uintptr_t>(lua_tointeger(L, 1));
+    ValueType type = checkType(L, 2);
+    int size = value_types[type].size;
+    lua_Integer count = luaL_checkinteger(L, 3);
+    luaL_argcheck(L, count >= 0, 3, "count must be positive");
+    luaL_argcheck(L, count <= INT_MAX / size, 3, "count is too large");
+    lua_Integer stride = luaL_optinteger(L, 4, size);
+
+    uint8_t* buffer = static_cast<uint8_t*>(newBuffer(L, static_cast<size_t>(size) * count));
+    readElements(addr, size, count, stride, buffer);
+
+    lua_createtable(L, count, 0);
+    for (int i = 0; i < count; i++) {
+        pushValue(L, type, &buffer[static_cast<size_t>(i) * size]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+/* Field of a struct layout */
+struct Field {
+    int key_ref; // index of the field name on the Lua stack
+    lua_Integer offset;
+    ValueType type;
+};
+
+/* Parse the struct layout at the given stack index. Each field is described
+ * by `name = {offset, type}`. The layout is checked in a first pass, then
+ * the array of fields is pushed on the stack, followed by the field names.
+ * Returns the array of fields, with its length in `count` and the size of
+ * the struct in `struct_size` */
+static Field* parseLayout(lua_State *L, int index, int& count, int& struct_size)
+{
+    luaL_checktype(L, index, LUA_TTABLE);
+
+    lua_Integer size = 0;
+    count = 0;
+    lua_pushnil(L);
+    while (lua_next(L, index) != 0) {
+        luaL_argcheck(L, lua_istable(L, -1), index, "each field must be a table {offset, type}");
+        lua_rawgeti(L, -1, 1);
+        lua_Integer offset = lua_tointeger(L, -1);
+        lua_rawgeti(L, -2, 2);
+        ValueType type = checkType(L, -1);
+        lua_pop(L, 3);
+        luaL_argcheck(L, offset >= 0, index, "field offset must be positive");
+        luaL_argcheck(L, offset <= INT_MAX - 8, index, "field offset is too large");
+
+        if (offset + value_types[type].size > size)
+            size = offset + value_types[type].size;
+        count++;
+    }
+    struct_size = size;
+    luaL_checkstack(L, count + 4, "too many fields");
+
+    Field* fields = static_cast<Field*>(newBuffer(L, count * sizeof(Field)));
+    int i = 0;
+    lua_pushnil(L);
+    while (lua_next(L, index) != 0) {
+        Field& field = fields[i++];
+        lua_rawgeti(L, -1, 1);
+        field.offset = lua_tointeger(L, -1);
+        lua_rawgeti(L, -2, 2);
+        field.type = checkType(L, -1);
+        lua_pop(L, 3);
+
+        /* Keep a copy of the key, the original key is used by lua_next */
+        lua_pushvalue(L, -1);
+        lua_insert(L, -2);
+        field.key_ref = lua_gettop(L) - 1;
+    }
+    return fields;
+}
+
+/* Push a table with all fields of a struct decoded from a buffer */
+static void pushStruct(lua_State *L, const Field* fields, int count, const uint8_t* data)
+{
+    lua_createtable(L, 0, count);
+    for (int i = 0; i < count; i++) {
+        lua_pushvalue(L, fields[i].key_ref);
+        pushValue(L, fields[i].type, data + fields[i].offset);
+        lua_rawset(L, -3);
+    }
+}
+
+int Lua::Memory::readstruct(lua_State *L)
+{
+    uintptr_t addr = static_cast<uintptr_t>(lua_tointeger(L, 1));
+    int nb_fields, struct_size;
+    Field* fields = parseLayout(L, 2, nb_fields, struct_size);
+
+    uint8_t* buffer = static_cast<uint8_t*>(newBuffer(L, struct_size));
+    read(addr, buffer, struct_size);
+
+    pushStruct(L, fields, nb_fields, buffer);
+    return 1;
+}
+
+int Lua::Memory::readstructarray(lua_State *L)
+{
+    uintptr_t addr = static_cast<uintptr_t>(lua_tointeger(L, 1));
+    lua_Integer count = luaL_checkinteger(L, 3);
+    luaL_argcheck(L, count >= 0, 3, "count must be positive");
+    int nb_fields, struct_size;
+    Field* fields = parseLayout(L, 2, nb_fields, struct_size);
+    luaL_argcheck(L, (struct_size == 0) || (count <= INT_MAX / struct_size), 3, "count is too large");
+    lua_Integer stride = luaL_optinteger(L, 4, struct_size);
+
+    uint8_t* buffer = static_cast<uint8_t*>(newBuffer(L, static_cast<size_t>(struct_size) * count));
+    readElements(addr, struct_size, count, stride, buffer);
+
+    lua_createtable(L, count, 0);
+    for (int i = 0; i < count; i++) {
+        pushStruct(L, fields, nb_fields, &buffer[static_cast<size_t>(i) * struct_size]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+int Lua::Memory::readbatch(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_Integer count = luaL_len(L, 1);
+    luaL_argcheck(L, count <= INT_MAX / 8, 1, "too many values");
+
+    /* Check all values first */
+    for (int i = 0; i < count; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        luaL_argcheck(L, lua_istable(L, -1), 1, "each value must be a table {address, type}");
+        lua_rawgeti(L, -1, 2);
+        checkType(L, -1);
+        lua_pop(L, 2);
+    }
+
+    /* Get the address and type of each value */
+    ValueType* types = static_cast<ValueType*>(newBuffer(L, count * sizeof(ValueType)));
+    struct iovec* locals = static_cast<struct iovec*>(newBuffer(L, count * sizeof(struct iovec)));
+    struct iovec* remotes = static_cast<struct iovec*>(newBuffer(L, count * sizeof(struct iovec)));
+    uint8_t* buffer = static_cast<uint8_t*>(newBuffer(L, static_cast<size_t>(count) * 8));
+    for (int i = 0; i < count; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        lua_rawgeti(L, -1, 1);
+        remotes[i].iov_base = reinterpret_cast<void*>(static_cast<uintptr_t>(lua_tointeger(L, -1)));
+        lua_rawgeti(L, -2, 2);
+        types[i] = checkType(L, -1);
+        lua_pop(L, 3);
+
+        remotes[i].iov_len = value_types[types[i]].size;
+        locals[i].iov_base = &buffer[static_cast<size_t>(i) * 8];
+        locals[i].iov_len = value_types[types[i]].size;
+    }
+
+    readMany(locals, remotes, count);
+
+    lua_createtable(L, count, 0);
+    for (int i = 0; i < count; i++) {
+        pushValue(L, types[i], &buffer[static_cast<size_t>(i) * 8]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
 void Lua::Memory::write(uintptr_t addr, void* value, int size)
 {
     /* Write value into the game process address */
@@ -22,6 +22,7 @@
 
 #include "../Context.h"
 #include <stdint.h>
+#include <sys/uio.h> // struct iovec
 extern "C" {
 #include <lua.h>
 }
@@ -66,6 +67,25 @@ namespace Memory {
     /* Read a double */
     int readd(lua_State *L);
 
+    /* Helper function for reading many buffers with a single call. Buffers
+     * that cannot be read are filled with zeros */
+    void readMany(const struct iovec* locals, const struct iovec* remotes, size_t count);
+
+    /* Read a number of bytes into a string */
+    int readbytes(lua_State *L);
+
+    /* Read an array of values of the same type */
+    int readarray(lua_State *L);
+
+    /* Read many fields of a struct, described by a layout */
+    int readstruct(lua_State *L);
+
+    /* Read an array of structs */
+    int readstructarray(lua_State *L);
+
+    /* Read values at many addresses with a single call */
+    int readbatch(lua_State *L);
+
     /* Helper function for reading an integer */
     void write(uintptr_t addr, void* value, int size);
 
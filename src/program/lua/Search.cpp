@@ -0,0 +1,141 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Search.h"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+}
+
+static Context* context;
+
+/* Connection to the orchestrator, or -1 if not an instance of a search */
+static int search_fd = -1;
+
+/* Data received from the orchestrator and not yet processed */
+static std::string received;
+
+/* List of functions to register */
+static const luaL_Reg search_functions[] =
+{
+    { "next", Lua::Search::next},
+    { "report", Lua::Search::report},
+    { "bound", Lua::Search::bound},
+    { NULL, NULL }
+};
+
+void Lua::Search::registerFunctions(Context* c)
+{
+    context = c;
+
+    /* The orchestrator passes the connection when it launches the instance.
+     * Don't let the game inherit it. */
+    if (search_fd < 0) {
+        char* fd_str = getenv("LIBTAS_SEARCH_FD");
+        if (fd_str) {
+            search_fd = atoi(fd_str);
+            fcntl(search_fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    luaL_newlib(context->lua_state, search_functions);
+    lua_setglobal(context->lua_state, "search");
+}
+
+static bool sendLine(std::string line)
+{
+    line += '\n';
+    size_t sent = 0;
+    while (sent < line.size()) {
+        ssize_t ret = write(search_fd, line.data() + sent, line.size() - sent);
+        if (ret <= 0)
+            return false;
+        sent += ret;
+    }
+    return true;
+}
+
+static bool receiveLine(std::string& line)
+{
+    size_t pos;
+    while ((pos = received.find('\n')) == std::string::npos) {
+        char buf[4096];
+        ssize_t ret = read(search_fd, buf, sizeof(buf));
+        if (ret <= 0)
+            return false;
+        received.append(buf, ret);
+    }
+    line = received.substr(0, pos);
+    received.erase(0, pos + 1);
+    return true;
+}
+
+static void checkSearch(lua_State *L)
+{
+    if (search_fd < 0)
+        luaL_error(L, "not running as an instance of a search");
+}
+
+int Lua::Search::next(lua_State *L)
+{
+    checkSearch(L);
+
+    std::string line;
+    if (sendLine("N") && receiveLine(line) && (line.compare(0, 2, "C ") == 0)) {
+        lua_pushlstring(L, line.data() + 2, line.size() - 2);
+        return 1;
+    }
+
+    /* The search is over, close the game */
+    context->status = Context::QUITTING;
+    lua_pushnil(L);
+    return 1;
+}
+
+int Lua::Search::report(lua_State *L)
+{
+    checkSearch(L);
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "R %.17g", static_cast<double>(luaL_checknumber(L, 1)));
+    if (!sendLine(buf))
+        std::cerr << "Could not report fitness to the orchestrator" << std::endl;
+    return 0;
+}
+
+int Lua::Search::bound(lua_State *L)
+{
+    checkSearch(L);
+
+    std::string line;
+    if (sendLine("B") && receiveLine(line) && (line.compare(0, 2, "B ") == 0)) {
+        lua_pushnumber(L, strtod(line.c_str() + 2, nullptr));
+        return 1;
+    }
+
+    lua_pushnil(L);
+    return 1;
+}
@@ -0,0 +1,51 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_LUASEARCH_H_INCLUDED
+#define LIBTAS_LUASEARCH_H_INCLUDED
+
+#include "../Context.h"
+extern "C" {
+#include <lua.h>
+}
+
+namespace Lua {
+
+/* Functions of an instance of a parallel search, to get candidates from
+ * the orchestrator and report their fitness. See Orchestrator.h */
+namespace Search {
+
+    /* Register all functions */
+    void registerFunctions(Context* context);
+
+    /* Get the next candidate () -> string candidate, or nil when the
+     * search is over */
+    int next(lua_State *L);
+
+    /* Report the fitness of the current candidate (number fitness) */
+    int report(lua_State *L);
+
+    /* Get the best fitness reported by all instances () -> number fitness,
+     * or nil if none */
+    int bound(lua_State *L);
+
+}
+}
+
+#endif
@@ -22,8 +22,10 @@
 
 #include "ui/MainWindow.h"
 #include "Context.h"
-#include "utils.h" // create_dir
+#include "utils.h" // create_dir, remove_dir
 #include "lua/Main.h"
+#include "Orchestrator.h"
+#include "../shared/sockethelpers.h" // removeSocket
 
 #include <limits.h> // PATH_MAX
 #include <libgen.h> // dirname
@@ -52,6 +54,9 @@ static void print_usage(void)
     std::cout << "  -r, --read MOVIE        Play game inputs from MOVIE file" << std::endl;
     std::cout << "  -w, --write MOVIE       Record game inputs into the specified MOVIE file" << std::endl;
     std::cout << "  -n, --non-interactive   Don't offer any interactive choice, so that it can run headless" << std::endl;
+    std::cout << "  -l, --lua SCRIPT        Run the lua SCRIPT at startup" << std::endl;
+    std::cout << "  -j, --jobs N            Run a parallel search over N non-interactive instances" << std::endl;
+    std::cout << "  -s, --search FILE       Read the candidates of the parallel search from FILE, one per line" << std::endl;
     std::cout << "  -h, --help              Show this message" << std::endl;
 }
 
@@ -75,6 +80,9 @@ int main(int argc, char **argv)
     std::ofstream o;
     std::string moviefile;
     std::string dumpfile;
+    std::string luafile;
+    std::string searchfile;
+    int jobs = 0;
     int recordingmode = SharedConfig::RECORDING_WRITE;
 
     static struct option long_options[] =
@@ -83,13 +91,16 @@ int main(int argc, char **argv)
         {"write", required_argument, nullptr, 'w'},
         {"dump", required_argument, nullptr, 'd'},
         {"non-interactive", no_argument, nullptr, 'n'},
+        {"lua", required_argument, nullptr, 'l'},
+        {"jobs", required_argument, nullptr, 'j'},
+        {"search", required_argument, nullptr, 's'},
         {"help", no_argument, nullptr, 'h'},
         {nullptr, 0, nullptr, 0}
     };
     int option_index = 0;
 
     // std::string libname;
-    while ((c = getopt_long (argc, argv, "+r:w:d:nh", long_options, &option_index)) != -1) {
+    while ((c = getopt_long (argc, argv, "+r:w:d:nl:j:s:h", long_options, &option_index)) != -1) {
         switch (c) {
             case 'r':
             case 'w':
@@ -110,6 +121,22 @@ int main(int argc, char **argv)
             case 'n':
                 context.interactive = false;
                 break;
+            case 'l':
+                /* Lua script to run at startup */
+                abspath = realpath_nonexist(optarg);
+                if (!abspath.empty()) {
+                    luafile = abspath;
+                }
+                break;
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+            case 's':
+                abspath = realpath_nonexist(optarg);
+                if (!abspath.empty()) {
+                    searchfile = abspath;
+                }
+                break;
             case '?':
                 std::cout << "Unknown option character" << std::endl;
                 break;
@@ -139,6 +166,39 @@ int main(int argc, char **argv)
         gameargsoverride += argv[i];
     }
 
+    /* Parallel search: launch the instances and wait for the results */
+    if (jobs > 0) {
+        if (searchfile.empty() || luafile.empty() || context.gamepath.empty()) {
+            std::cerr << "A parallel search needs a game, a lua script and a search file" << std::endl;
+            return -1;
+        }
+
+        /* Instances share the movie, so they can only read it */
+        if (!moviefile.empty() && (recordingmode != SharedConfig::RECORDING_READ)) {
+            std::cerr << "Instances of a parallel search can only read a movie" << std::endl;
+            return -1;
+        }
+
+        std::vector<std::string> args = {"-n", "-l", luafile};
+        if (!moviefile.empty()) {
+            args.push_back("-r");
+            args.push_back(moviefile);
+        }
+        for (int i = optind; i < argc; i++)
+            args.push_back(argv[i]);
+
+        return Orchestrator::run(jobs, searchfile, args);
+    }
+
+    /* Use a socket file for this instance, so that several instances can
+     * run at the same time. The game inherits the variable. */
+    if (!getenv("LIBTAS_SOCKET")) {
+        std::string socketpath = "/tmp/libTAS-";
+        socketpath += std::to_string(getpid());
+        socketpath += ".socket";
+        setenv("LIBTAS_SOCKET", socketpath.c_str(), 1);
+    }
+
     /* Open connection with the server */
     // XInitThreads();
     context.conn = xcb_connect(NULL,NULL);
@@ -276,6 +336,20 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    /* Instances of a parallel search have their own savestates and
+     * temporary movies, and must not overwrite the config */
+    char* search_worker = getenv("LIBTAS_SEARCH_WORKER");
+    if (search_worker) {
+        context.config.savestatedir += "/worker";
+        context.config.savestatedir += search_worker;
+        context.config.tempmoviedir += "/worker";
+        context.config.tempmoviedir += search_worker;
+        if ((create_dir(context.config.savestatedir) < 0) || (create_dir(context.config.tempmoviedir) < 0)) {
+            std::cerr << "Cannot create the dirs of search instance " << search_worker << std::endl;
+            return -1;
+        }
+    }
+
     /* Store current content of LD_PRELOAD */
 
     char* old_preload = getenv("LD_PRELOAD");
@@ -298,6 +372,11 @@ int main(int argc, char **argv)
     /* Start the lua VM */
     Lua::Main::init(&context);
 
+    /* Run the lua script from the commandline */
+    if (!luafile.empty()) {
+        Lua::Main::run(&context, luafile);
+    }
+
     /* Starts the user interface */
     QApplication app(argc, argv);
 
@@ -309,7 +388,8 @@ int main(int argc, char **argv)
 
     app.exec();
 
-    context.config.save(context.gamepath);
+    if (!search_worker)
+        context.config.save(context.gamepath);
 
     /* Stop the lua VM */
     Lua::Main::exit(&context);
@@ -342,5 +422,15 @@ int main(int argc, char **argv)
     xcb_cursor_context_free(ctx);
 
     xcb_disconnect(context.conn);
+
+    /* Remove the socket file of this instance */
+    removeSocket();
+
+    /* Instances of a parallel search remove their own dirs */
+    if (search_worker) {
+        remove_dir(context.config.savestatedir);
+        remove_dir(context.config.tempmoviedir);
+    }
+
     return 0;
 }
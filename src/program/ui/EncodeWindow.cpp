@@ -76,6 +76,16 @@ EncodeWindow::EncodeWindow(Context* c, QWidget *parent) : QDialog(parent), conte
 
     ffmpegOptions = new QLineEdit();
 
+    videoPixfmt = new QComboBox();
+    videoPixfmt->addItem("Native", SharedConfig::VIDEO_PIXFMT_NATIVE);
+    videoPixfmt->addItem("YUV 4:2:0 planar (I420)", SharedConfig::VIDEO_PIXFMT_I420);
+    videoPixfmt->addItem("YUV 4:2:0 semi-planar (NV12)", SharedConfig::VIDEO_PIXFMT_NV12);
+
+    videoDownscale = new QComboBox();
+    videoDownscale->addItem("None", 1);
+    videoDownscale->addItem("1/2", 2);
+    videoDownscale->addItem("1/4", 4);
+
     QGroupBox *codecGroupBox = new QGroupBox(tr("Encode codec settings"));
     QGridLayout *encodeCodecLayout = new QGridLayout;
     encodeCodecLayout->addWidget(new QLabel(tr("Video codec:")), 0, 0);
@@ -94,6 +104,11 @@ EncodeWindow::EncodeWindow(Context* c, QWidget *parent) : QDialog(parent), conte
     encodeCodecLayout->addWidget(new QLabel(tr("Video framerate:")), 3, 0);
     encodeCodecLayout->addWidget(videoFramerate, 3, 1, 1, 4);
 
+    encodeCodecLayout->addWidget(new QLabel(tr("Pixel format:")), 4, 0);
+    encodeCodecLayout->addWidget(videoPixfmt, 4, 1);
+    encodeCodecLayout->addWidget(new QLabel(tr("Downscale:")), 4, 3);
+    encodeCodecLayout->addWidget(videoDownscale, 4, 4);
+
     encodeCodecLayout->setColumnMinimumWidth(2, 50);
     encodeCodecLayout->setColumnStretch(2, 1);
     codecGroupBox->setLayout(encodeCodecLayout);
@@ -139,6 +154,15 @@ void EncodeWindow::update_config()
     /* Set video framerate */
     videoFramerate->setValue(context->config.sc.video_framerate);
 
+    /* Set pixel format and downscale factor */
+    int index = videoPixfmt->findData(context->config.sc.video_pixfmt);
+    if (index >= 0)
+        videoPixfmt->setCurrentIndex(index);
+
+    index = videoDownscale->findData(context->config.sc.video_downscale);
+    if (index >= 0)
+        videoDownscale->setCurrentIndex(index);
+
     if (context->config.ffmpegoptions.empty()) {
         slotUpdate();
     }
@@ -167,6 +191,9 @@ void EncodeWindow::slotOk()
 
     context->config.sc.video_framerate = videoFramerate->value();
 
+    context->config.sc.video_pixfmt = videoPixfmt->currentData().toInt();
+    context->config.sc.video_downscale = videoDownscale->currentData().toInt();
+
     context->config.sc_modified = true;
 
     /* Close window */
@@ -48,6 +48,8 @@ private:
     QSpinBox *audioBitrate;
     QLineEdit *ffmpegOptions;
     QSpinBox *videoFramerate;
+    QComboBox *videoPixfmt;
+    QComboBox *videoDownscale;
 
 private slots:
     void slotBrowseEncodePath();
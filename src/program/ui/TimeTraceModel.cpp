@@ -23,6 +23,7 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <algorithm>
 #include <QtGui/QColor>
 #include <QtGui/QPalette>
 #include <QtGui/QBrush>
@@ -30,8 +31,20 @@
 
 TimeTraceModel::TimeTraceModel(Context* c, QObject *parent) : QAbstractTableModel(parent), context(c) {}
 
-void TimeTraceModel::addCall(int type, unsigned long long hash, std::string stacktrace)
+void TimeTraceModel::addCall(int type, unsigned long long hash, unsigned int count, std::string stacktrace)
 {
+    /* Get the stack trace of a hash that was already received */
+    if (stacktrace.empty()) {
+        auto st = stacktraces.find(hash);
+        if (st != stacktraces.end())
+            stacktrace = st->second;
+    }
+    else {
+        stacktraces[hash] = stacktrace;
+    }
+
+    current_frame.counts.emplace_back(hash, count);
+
     auto it = time_calls_map.find(hash);
     if (it != time_calls_map.end()) {
         if ((!stacktrace.empty()) && stacktrace.compare(it->second.stacktrace) != 0) {
@@ -41,17 +54,61 @@ void TimeTraceModel::addCall(int type, unsigned long long hash, std::string stac
             std::cerr << "New trace:" << std::endl;
             std::cerr << stacktrace << std::endl;
         }
-        it->second.count++;
-        /* TODO: Get the row index? */
-        emit dataChanged(createIndex(0,1), createIndex(rowCount(),1));
+        it->second.count += count;
     }
     else {
-        beginInsertRows(QModelIndex(), time_calls_map.size(), time_calls_map.size());
-        time_calls_map[hash] = {type, 1, stacktrace};
+        it = time_calls_map.lower_bound(hash);
+        int row = std::distance(time_calls_map.begin(), it);
+        beginInsertRows(QModelIndex(), row, row);
+        time_calls_map.emplace_hint(it, hash, TimeCall{type, count, stacktrace, 0});
         endInsertRows();
     }
 }
 
+void TimeTraceModel::endFrame(unsigned long long frame)
+{
+    std::sort(current_frame.counts.begin(), current_frame.counts.end());
+    current_frame.frame = frame;
+    current_frame.valid = true;
+
+    if (frames.empty())
+        frames.resize(frame_history);
+
+    /* Compare with the previous run of the same frame, and count the call
+     * sites whose number of calls has changed, which can cause desyncs */
+    TimeTraceFrame& previous = frames[frame % frame_history];
+    if (previous.valid && (previous.frame == frame)) {
+        auto cur = current_frame.counts.begin();
+        auto prev = previous.counts.begin();
+        while ((cur != current_frame.counts.end()) || (prev != previous.counts.end())) {
+            uint64_t hash;
+            if ((prev == previous.counts.end()) || ((cur != current_frame.counts.end()) && (cur->first < prev->first))) {
+                hash = (cur++)->first;
+            }
+            else if ((cur == current_frame.counts.end()) || (prev->first < cur->first)) {
+                hash = (prev++)->first;
+            }
+            else {
+                hash = cur->first;
+                bool same = (cur++)->second == (prev++)->second;
+                if (same)
+                    continue;
+            }
+
+            auto it = time_calls_map.find(hash);
+            if (it != time_calls_map.end())
+                it->second.mismatch++;
+        }
+    }
+
+    std::swap(previous, current_frame);
+    current_frame.counts.clear();
+    current_frame.valid = false;
+
+    if (!time_calls_map.empty())
+        emit dataChanged(createIndex(0,2), createIndex(rowCount()-1,3));
+}
+
 int TimeTraceModel::rowCount(const QModelIndex & /*parent*/) const
 {
     return time_calls_map.size();
@@ -59,7 +116,7 @@ int TimeTraceModel::rowCount(const QModelIndex & /*parent*/) const
 
 int TimeTraceModel::columnCount(const QModelIndex & /*parent*/) const
 {
-    return 3;
+    return 4;
 }
 
 QVariant TimeTraceModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -72,7 +129,10 @@ QVariant TimeTraceModel::headerData(int section, Qt::Orientation orientation, in
             else if (section == 1) {
                 return QString("Hash");
             }
-            return QString("Count");
+            else if (section == 2) {
+                return QString("Count");
+            }
+            return QString("Mismatch");
         }
     }
     return QVariant();
@@ -131,9 +191,12 @@ QVariant TimeTraceModel::data(const QModelIndex &index, int role) const
         else if (index.column() == 1) {
             return QString("%1").arg(it->first, 0, 16);
         }
-        else {
+        else if (index.column() == 2) {
             return it->second.count;
         }
+        else {
+            return it->second.mismatch;
+        }
     }
     return QVariant();
 }
@@ -152,5 +215,6 @@ void TimeTraceModel::clearData()
 {
     beginResetModel();
     time_calls_map.clear();
+    frames.clear();
     endResetModel();
 }
@@ -35,6 +35,15 @@ struct TimeCall {
     int type;
     unsigned int count;
     std::string stacktrace;
+    unsigned int mismatch; // number of frames where the count differed from
+                           // a previous run of the same frame
+};
+
+/* Number of time calls of each call site during a frame, sorted by hash */
+struct TimeTraceFrame {
+    unsigned long long frame = 0;
+    bool valid = false;
+    std::vector<std::pair<uint64_t, unsigned int>> counts;
 };
 
 class TimeTraceModel : public QAbstractTableModel {
@@ -46,6 +55,10 @@ public:
     /* Map of pointers (key) and addresses (value) */
     std::map<uint64_t,TimeCall> time_calls_map;
 
+    /* Stack traces of all hashes received. The game only sends the stack
+     * trace the first time, so this is not cleared with the table */
+    std::map<uint64_t,std::string> stacktraces;
+
     /* Get the full stack trace of a given table index */
     std::string getStacktrace(int index);
 
@@ -53,11 +66,23 @@ public:
     void clearData();
 
 public slots:
-    void addCall(int type, unsigned long long hash, std::string stacktrace);
+    /* Add the time calls of a call site during the current frame */
+    void addCall(int type, unsigned long long hash, unsigned int count, std::string stacktrace);
+
+    /* All call sites of a frame were received. Compare them with the
+     * previous run of the same frame, if any */
+    void endFrame(unsigned long long frame);
 
 private:
     Context *context;
 
+    /* Histograms of the last frames, indexed by frame modulo the size */
+    static const int frame_history = 4096;
+    std::vector<TimeTraceFrame> frames;
+
+    /* Histogram of the frame being received */
+    TimeTraceFrame current_frame;
+
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -23,6 +23,7 @@
 #include <cstring> // strerror
 #include <iostream>
 #include <unistd.h> // unlink
+#include <ftw.h> // nftw
 
 std::string fileFromPath(const std::string& path)
 {
@@ -125,6 +126,17 @@ void remove_savestates(Context* context)
     }
 }
 
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+int remove_dir(const std::string& path)
+{
+    /* Visit the content of each directory before the directory itself */
+    return nftw(path.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
 int extractBinaryType(std::string path)
 {
     std::string cmd = "file -b \"";
@@ -35,6 +35,9 @@ int create_dir(const std::string& path);
 /* Remove savestate files */
 void remove_savestates(Context* context);
 
+/* Remove a directory and all its content */
+int remove_dir(const std::string& path);
+
 /* List of error codes */
 enum BinaryType {
     BT_UNKNOWN,
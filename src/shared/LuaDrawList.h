@@ -0,0 +1,57 @@
+/*
+    Copyright 2015-2020 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_LUADRAWLIST_H_INCLUDED
+#define LIBTAS_LUADRAWLIST_H_INCLUDED
+
+#include <stdint.h>
+
+/*
+ * Commands of the display list built by the gui functions of lua scripts,
+ * which is sent to the game in a single message each frame.
+ *
+ * Each command is a uint8_t identifier followed by its arguments, in native
+ * byte order and without padding. Colors are in the lua format `0xaarrggbb`.
+ */
+struct LuaDrawList {
+    enum Command : uint8_t {
+        /* Argument: int x, int y, uint32_t fg, uint32_t bg,
+         *           uint32_t len, char text[len] */
+        TEXT,
+
+        /* Argument: int x, int y, uint32_t color */
+        PIXEL,
+
+        /* Argument: int x, int y, int w, int h, int thickness,
+         *           uint32_t outline, uint32_t fill */
+        RECT,
+
+        /* Argument: int x0, int y0, int x1, int y1, uint32_t color */
+        LINE,
+
+        /* Argument: uint32_t color, uint32_t n, then n times int x, int y */
+        POLYLINE,
+
+        /* Argument: int x, int y, int w, int h, then w*h uint32_t colors,
+         *           row by row */
+        PIXELS,
+    };
+};
+
+#endif
@@ -118,6 +118,17 @@ struct __attribute__((packed, aligned(8))) SharedConfig {
     int audio_codec = 0;
     int audio_bitrate = 128;
 
+    /* Pixel format of the video frames sent to ffmpeg */
+    enum VideoPixelFormat {
+        VIDEO_PIXFMT_NATIVE = 0, // format of the screen, no conversion
+        VIDEO_PIXFMT_I420 = 1,
+        VIDEO_PIXFMT_NV12 = 2,
+    };
+    int video_pixfmt = VIDEO_PIXFMT_NATIVE;
+
+    /* Downscale factor of the video frames sent to ffmpeg (1, 2 or 4) */
+    int video_downscale = 1;
+
     /* An enum indicating which time-getting function query the time */
     enum TimeCallType
     {
@@ -246,10 +246,13 @@ enum {
     MSGB_GIT_COMMIT,
 
     /*
-     * Send the hash and backtrace of a gettime function.
-     * Argument: uint64_t then size_t (string length) then char[len]
+     * Send the number of gettime calls of each call site during a frame.
+     * The backtrace is empty if it was already sent for the same hash.
+     * Argument: uint64_t (frame) then int (number of call sites) then for each
+     *           call site: int (type) then uint64_t (hash) then uint32_t
+     *           (count) then size_t (string length) then char[len]
      */
-    MSGB_GETTIME_BACKTRACE,
+    MSGB_GETTIME_TRACES,
 
     /*
      * Indicate that the current frame is a non-draw frame.
@@ -258,22 +261,11 @@ enum {
     MSGB_NONDRAW_FRAME,
 
     /*
-     * Send to the game a text to be displayed from a lua script.
-     * Argument: int x, int y, string text, uint32_t fg, uint32_t bg
+     * Send to the game all drawings of lua scripts for this frame, encoded
+     * as described in LuaDrawList.h.
+     * Argument: uint32_t size then char[size]
      */
-    MSGN_LUA_TEXT,
-
-    /*
-     * Send to the game a pixel to be displayed from a lua script.
-     * Argument: int x, int y, uint32_t color
-     */
-    MSGN_LUA_PIXEL,
-
-    /*
-     * Send to the game a rectangle to be displayed from a lua script.
-     * Argument: int x, int y, int w, int h, int thickness, uint32_t outline, uint32_t fill
-     */
-    MSGN_LUA_RECT,
+    MSGN_LUA_DRAWLIST,
 
     /*
      * Ask the game to send the screen resolution.
@@ -27,13 +27,17 @@
 #include <vector>
 #include <mutex>
 
+#include <cstring>
+
 #ifdef SOCKET_LOG
 #include "lcf.h"
 #include "../library/logging.h"
+#include "../library/GlobalState.h"
 #else
 #include <iostream>
 #endif
 
+/* Default socket file, used if the program did not set one */
 #define SOCKET_FILENAME "/tmp/libTAS.socket"
 
 /* Socket to communicate between the program and the game */
@@ -41,13 +45,38 @@ static int socket_fd = 0;
 
 static std::mutex mutex;
 
+/* Get the address of the socket file. The program sets a different file for
+ * each instance in LIBTAS_SOCKET, which the game inherits, so that several
+ * games can run at the same time */
+static struct sockaddr_un socketAddress(void)
+{
+    const char* path;
+#ifdef SOCKET_LOG
+    {
+        libtas::GlobalNative gn;
+        path = getenv("LIBTAS_SOCKET");
+    }
+#else
+    path = getenv("LIBTAS_SOCKET");
+#endif
+    if (!path)
+        path = SOCKET_FILENAME;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
 void removeSocket(void){
-    unlink(SOCKET_FILENAME);
+    const struct sockaddr_un addr = socketAddress();
+    unlink(addr.sun_path);
 }
 
 bool initSocketProgram(void)
 {
-    const struct sockaddr_un addr = { AF_UNIX, SOCKET_FILENAME };
+    const struct sockaddr_un addr = socketAddress();
     socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
 
     struct timespec tim = {0, 500L*1000L*1000L};
@@ -77,12 +106,12 @@ bool initSocketGame(void)
      * the link is already done in another process of the game.
      * In this case, we just return immediately.
      */
+    const struct sockaddr_un addr = socketAddress();
     struct stat st;
-    int result = stat(SOCKET_FILENAME, &st);
+    int result = stat(addr.sun_path, &st);
     if (result == 0)
         return false;
 
-    const struct sockaddr_un addr = { AF_UNIX, SOCKET_FILENAME };
     const int tmp_fd = socket(AF_UNIX, SOCK_STREAM, 0);
     if (bind(tmp_fd, reinterpret_cast<const struct sockaddr*>(&addr), sizeof(struct sockaddr_un)))
     {
@@ -124,7 +153,7 @@ void unlockSocket(void)
 int sendData(const void* elem, unsigned int size)
 {
 #ifdef SOCKET_LOG
-    libtas::debuglogstdio(LCF_SOCKET, "Send socket data of size %u", size);
+    debuglogstdio(LCF_SOCKET, "Send socket data of size %u", size);
 #endif
 
     ssize_t ret = 0;
@@ -134,14 +163,14 @@ int sendData(const void* elem, unsigned int size)
 
     if (ret == -1) {
 #ifdef SOCKET_LOG
-        libtas::debuglogstdio(LCF_SOCKET | LCF_ERROR, "send() returns -1 with error %s", strerror(errno));
+        debuglogstdio(LCF_SOCKET | LCF_ERROR, "send() returns -1 with error %s", strerror(errno));
 #else
         std::cerr << "send() returns -1 with error " << strerror(errno) << std::endl;
 #endif
     }
     else if (ret != static_cast<ssize_t>(size)) {
 #ifdef SOCKET_LOG
-        libtas::debuglogstdio(LCF_SOCKET | LCF_ERROR, "send() %u bytes instead of %u", ret, size);
+        debuglogstdio(LCF_SOCKET | LCF_ERROR, "send() %u bytes instead of %u", ret, size);
 #else
         std::cerr << "send() " << ret << " bytes instead of " << size << std::endl;
 #endif
@@ -153,7 +182,7 @@ int sendData(const void* elem, unsigned int size)
 int sendMessage(int message)
 {
 #ifdef SOCKET_LOG
-    libtas::debuglogstdio(LCF_SOCKET, "Send socket message %d", message);
+    debuglogstdio(LCF_SOCKET, "Send socket message %d", message);
 #endif
     return sendData(&message, sizeof(int));
 }
@@ -161,7 +190,7 @@ int sendMessage(int message)
 void sendString(const std::string& str)
 {
 #ifdef SOCKET_LOG
-    libtas::debuglog(LCF_SOCKET, "Send socket string ", str);
+    debuglog(LCF_SOCKET, "Send socket string ", str);
 #endif
     unsigned int str_size = str.size();
     sendData(&str_size, sizeof(unsigned int));
@@ -171,7 +200,7 @@ void sendString(const std::string& str)
 int receiveData(void* elem, unsigned int size)
 {
 #ifdef SOCKET_LOG
-    libtas::debuglogstdio(LCF_SOCKET, "Receive socket data of size %u", size);
+    debuglogstdio(LCF_SOCKET, "Receive socket data of size %u", size);
 #endif
 
     ssize_t ret = 0;
@@ -181,21 +210,21 @@ int receiveData(void* elem, unsigned int size)
 
     if (ret == -1) {
 #ifdef SOCKET_LOG
-        libtas::debuglogstdio(LCF_SOCKET | LCF_ERROR, "recv() returns -1 with error %s", strerror(errno));
+        debuglogstdio(LCF_SOCKET | LCF_ERROR, "recv() returns -1 with error %s", strerror(errno));
 #else
         std::cerr << "recv() returns -1 with error " << strerror(errno) << std::endl;
 #endif
     }
     else if (ret == 0) { // socket has been closed
 #ifdef SOCKET_LOG
-        libtas::debuglogstdio(LCF_SOCKET | LCF_WARNING, "recv() returns 0 -> socket closed");
+        debuglogstdio(LCF_SOCKET | LCF_WARNING, "recv() returns 0 -> socket closed");
 #else
         std::cerr << "recv() returns 0 -> socket closed" << std::endl;
 #endif
     }
     else if (ret != static_cast<ssize_t>(size)) {
 #ifdef SOCKET_LOG
-        libtas::debuglogstdio(LCF_SOCKET | LCF_ERROR, "recv() %u bytes instead of %u", ret, size);
+        debuglogstdio(LCF_SOCKET | LCF_ERROR, "recv() %u bytes instead of %u", ret, size);
 #else
         std::cerr << "recv() " << ret << " bytes instead of " << size << std::endl;
 #endif
@@ -208,7 +237,7 @@ int receiveMessage()
     int msg;
     int ret = receiveData(&msg, sizeof(int));
 #ifdef SOCKET_LOG
-    libtas::debuglogstdio(LCF_SOCKET, "Receive socket message %d", msg);
+    debuglogstdio(LCF_SOCKET, "Receive socket message %d", msg);
 #endif
     /* Handle special case for closed socket */
     if (ret == 0)
@@ -226,7 +255,7 @@ int receiveMessageNonBlocking()
     if (ret < 0)
         return ret;
 #ifdef SOCKET_LOG
-    libtas::debuglogstdio(LCF_SOCKET, "Receive non-blocking socket message %d", msg);
+    debuglogstdio(LCF_SOCKET, "Receive non-blocking socket message %d", msg);
 #endif
 
     /* Handle special case for closed socket */
@@ -247,7 +276,7 @@ std::string receiveString()
 
     std::string str(buf.data(), str_size);
 #ifdef SOCKET_LOG
-    libtas::debuglog(LCF_SOCKET, "Receive socket string ", str);
+    debuglog(LCF_SOCKET, "Receive socket string ", str);
 #endif
     return str;
 }
@@ -259,6 +288,6 @@ void receiveCString(char* str)
     receiveData(str, str_size);
     str[str_size] = '\0';
 #ifdef SOCKET_LOG
-    libtas::debuglogstdio(LCF_SOCKET, "Receive socket C string %s", str);
+    debuglogstdio(LCF_SOCKET, "Receive socket C string %s", str);
 #endif
 }
@@ -0,0 +1,132 @@
+#!/bin/sh
+
+# Measure the overhead of libTAS at each frame boundary, by running one of
+# the sample games under libTAS for a number of frames in non-interactive
+# mode. The library writes the time spent in each phase of the frame
+# boundary into the output file (CSV, one line per frame, in nanoseconds),
+# and the average of each phase is printed at the end.
+#
+# The sample games need SDL2 (and OpenGL for the gl game), and libTAS needs
+# an X server, for example Xvfb.
+
+set -e
+
+usage()
+{
+    echo "Usage: benchmark.sh [options]"
+    echo "Options are:"
+    echo "  -g GAME       Sample game to run: sdl (simplestgame.c) or gl (simplestGLgame.c), default sdl"
+    echo "  -n FRAMES     Number of frames to run, default 1000"
+    echo "  -o FILE       Write the timings into FILE, default benchmark.csv"
+    echo "  -l LIBTAS     Path to the libTAS executable, default libTAS"
+    echo "  -O OSD        OSD flags (SharedConfig::osd), default 0"
+    echo "  -a ASYNC      Async event flags (SharedConfig::async_events), default 0"
+    echo "  -S SETTINGS   Savestate settings (SharedConfig::savestate_settings), default 2 (RAM)"
+    echo "  -s PERIOD     Save a state every PERIOD frames, default 0 (never)"
+    echo "  -d FILE       Encode audio and video into FILE"
+    echo "  -h            Show this message"
+}
+
+game=sdl
+frames=1000
+output=benchmark.csv
+libtas=libTAS
+osd=0
+async=0
+savestate_settings=2
+savestate_period=0
+dumpfile=
+
+while getopts "g:n:o:l:O:a:S:s:d:h" opt; do
+    case $opt in
+        g) game=$OPTARG ;;
+        n) frames=$OPTARG ;;
+        o) output=$OPTARG ;;
+        l) libtas=$OPTARG ;;
+        O) osd=$OPTARG ;;
+        a) async=$OPTARG ;;
+        S) savestate_settings=$OPTARG ;;
+        s) savestate_period=$OPTARG ;;
+        d) dumpfile=$OPTARG ;;
+        h) usage; exit 0 ;;
+        *) usage; exit 1 ;;
+    esac
+done
+
+utilsdir=$(cd "$(dirname "$0")" && pwd)
+output=$(realpath "$output")
+
+case $game in
+    sdl) gamename=simplestgame; libs="-lSDL2" ;;
+    gl) gamename=simplestGLgame; libs="-lSDL2 -lGL" ;;
+    *) usage; exit 1 ;;
+esac
+
+workdir=$(mktemp -d)
+trap 'rm -rf "$workdir"' EXIT
+
+# Build the sample game
+gcc -O2 "$utilsdir/$gamename.c" $libs -o "$workdir/$gamename"
+
+# Use a separate config, so that the settings of the user are untouched.
+# Sleeps are skipped, but the game and libTAS still do all their work.
+export XDG_CONFIG_HOME="$workdir/config"
+export XDG_DATA_HOME="$workdir/data"
+mkdir -p "$XDG_CONFIG_HOME/libTAS"
+cat > "$XDG_CONFIG_HOME/libTAS/$gamename.ini" <<EOF
+[shared]
+osd=$osd
+async_events=$async
+savestate_settings=$savestate_settings
+fastforward_mode=1
+EOF
+
+# Build a movie of blank frames, so that libTAS quits at the end
+mkdir -p "$workdir/movie"
+cat > "$workdir/movie/config.ini" <<EOF
+[General]
+game_name=$gamename
+frame_count=$frames
+mouse_support=false
+nb_controllers=0
+initial_time_sec=1
+initial_time_nsec=0
+framerate_num=60
+framerate_den=1
+EOF
+i=0
+while [ $i -lt "$frames" ]; do
+    echo "|"
+    i=$((i + 1))
+done > "$workdir/movie/inputs"
+tar -czf "$workdir/benchmark.ltm" -C "$workdir/movie" config.ini inputs
+
+set -- -n -r "$workdir/benchmark.ltm"
+
+# Savestates are performed by a lua bot, which stops before the end of the
+# movie so that libTAS quits there
+if [ "$savestate_period" -gt 0 ]; then
+    cat > "$workdir/benchmark.lua" <<EOF
+bot.run(function()
+    for f = 1, $frames - 2 do
+        if f % $savestate_period == 0 then
+            bot.saveState(1)
+        end
+        bot.frameAdvance()
+    end
+end, false)
+EOF
+    set -- "$@" -l "$workdir/benchmark.lua"
+fi
+
+if [ -n "$dumpfile" ]; then
+    set -- "$@" -d "$dumpfile"
+fi
+
+LIBTAS_PROFILE_FILE="$output" "$libtas" "$@" "$workdir/$gamename"
+
+# Average time of each phase, in microseconds
+awk -F, 'NR == 1 { for (i = 2; i <= NF; i++) name[i] = $i; next }
+         { for (i = 2; i <= NF; i++) sum[i] += $i; n++ }
+         END { if (n == 0) exit 1;
+               for (i = 2; i <= NF; i++) printf "%-10s %10.1f us\n", name[i], sum[i] / n / 1000 }' "$output"